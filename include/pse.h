@@ -8,15 +8,33 @@
  * Author: Santiago Nunez-Corrales
  */
 
-#define PSE_MAX_VARIABLES 	2000
+#ifndef PSE_H
+#define PSE_H
+
+#include <rnglib.h>
+#include <ranlib_r8.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PSE_INITIAL_VARIABLES	16
 #define PSE_VARNAME_SIZE 	50
 #define PSE_MAX_STRLEN 		1000
 #define PSE_MAX_DIST_PARAMS	5
+#define PSE_BINOMIAL_CACHE	8
 #define PSE_TRUE 			1
 #define PSE_FALSE			0
 #define PSE_HEADS 			1
 #define PSE_TAILS			0
 
+/*
+ * Moduli of the two L'Ecuyer generator components. Seeds must lie in
+ * [1, m - 1].
+ */
+#define PSE_RNG_M1			2147483563
+#define PSE_RNG_M2			2147483399
+
 /*
  * Fixed strings
  */
@@ -43,6 +61,9 @@ typedef enum pse_model_type {
  * Distributions come in two flavors:
  * - Those that do not use the current value as input
  * - Those that do (SELF).
+ *
+ * Tabulated distributions (see psetable.h) come last, so that the other
+ * distributions keep their values in checkpoints and snapshots.
  */
 
 typedef enum pse_distribution_type {
@@ -69,7 +90,9 @@ typedef enum pse_distribution_type {
 	PSE_DIST_BETA,
 	PSE_DIST_FOKKER_PLANCK,
 	PSE_DIST_CUSTOM,
-	PSE_DIST_NONE
+	PSE_DIST_NONE,
+	PSE_DIST_TABLE_INT,
+	PSE_DIST_TABLE_DOUBLE
 } pse_distribution_type;
 
 /*
@@ -103,12 +126,6 @@ typedef int pse_depid;
  * dependency is indicated.
  */
 
-typedef struct pse_dependency {
-	unsigned int count;
-	pse_depid conditionals[PSE_MAX_VARIABLES];
-	double (*priors)(unsigned int, unsigned int *);
-} pse_dependency;
-
 
 /*
  * At present the time representation within Charm++/ROSS is equivalent to a double.
@@ -133,6 +150,108 @@ typedef union pse_content {
 	char **cstring_a;
 } pse_content;
 
+/*
+ * FOKKER_PLANCK variables follow the stochastic differential equation
+ *
+ *   dX = a(X) dt + b(X) dW
+ *
+ * and each observation advances them by one Euler-Maruyama step:
+ *
+ *   X' = X + a(X) dt + b(X) sqrt(dt) Z,  Z ~ N(0, 1).
+ *
+ * By default drift and diffusion are affine in X and taken from the point
+ * parameters: a(X) = pars[0] + pars[1] X, b(X) = pars[2] + pars[3] X, which
+ * covers Brownian motion with drift, Ornstein-Uhlenbeck and geometric
+ * Brownian motion. The step is pars[4]. A model callback replaces the affine
+ * coefficients: it receives count values and the point parameters, and fills
+ * count drifts and count diffusions, so that whole arrays and population
+ * columns are evaluated in one call. A clock replaces the step: it points to
+ * the time variable (or, in populations, the time column) holding dt.
+ * Non-positive steps leave the value unchanged.
+ */
+typedef void (*pse_sde_model)(unsigned int, double *, double *, double *, double *);
+
+typedef struct pse_sde_setup {
+	pse_sde_model model;
+	pse_varid clock;
+	pse_time *step;
+} pse_sde_setup;
+
+/*
+ * CUSTOM variables draw with a sampler supplied by the model. One call fills
+ * count outputs: out[i] is drawn given the point parameters and values[i], the
+ * current value it replaces (values may be out). The generator of the stub or
+ * population is bound to the calling thread and positioned, and is passed as
+ * the handle; samplers draw from it through rnglib and ranlib. Integer
+ * variables are passed as doubles and rounded back.
+ */
+typedef void (*pse_custom_sampler)(rng_state *, double *, double *, double *, unsigned int);
+
+/*
+ * Sampler constants derived from the point parameters of a variable. They are
+ * computed when the variable is registered and again only when the parameters
+ * they were derived from change, so variables with different parameters never
+ * evict each other's setup.
+ *
+ * BINOMIAL_SELF variables draw with a different number of trials each time.
+ * They keep PSE_BINOMIAL_CACHE setups indexed by the number of trials, which
+ * are allocated at registration and released with the variable. FOKKER_PLANCK
+ * variables keep their model and clock instead (see psesde.h), CUSTOM
+ * variables their sampler (see psecustom.h) and tabulated variables a
+ * reference to their table (see psetable.h); these start cleared.
+ */
+struct pse_table;
+
+typedef union pse_sampler_cache {
+	poisson_r8_setup poisson;
+	binomial_r8_setup binomial;
+	binomial_r8_setup *binomial_by_n;
+	pse_sde_setup sde;
+	pse_custom_sampler custom;
+	struct pse_table *table;
+} pse_sampler_cache;
+
+/*
+ * Conditionals are stored in compressed form: the identifiers of all
+ * conditionals of a stub live in one pool, and each dependency records where
+ * its own run starts (offset) and how long it is (count).
+ *
+ * The prior receives the number of conditionals and their values (the
+ * evidence) as unsigned integers, and returns the conditioned parameter of the
+ * point distribution: the probability of BERNOULLI, BINOMIAL and the negative
+ * binomials, and the first point parameter otherwise (e.g. the mean of
+ * POISSON, NORMAL or EXPONENTIAL). The other parameters are kept.
+ *
+ * Evaluations are memoized: the evidence of the last evaluation is kept in a
+ * pool parallel to the conditionals, and the prior is only called again when
+ * the evidence differs. The conditioned parameters and their sampler constants
+ * are kept with the dependency. A dependency is marked dirty when one of its
+ * conditionals is written to; until then, observations at the location of the
+ * last evaluation do not even gather the evidence.
+ *
+ * Priors are not stored in checkpoints. prior_pending marks a dependency
+ * restored from one whose prior must be supplied again; until then its
+ * observations fail with PSE_ERROR_PRIOR_MISSING.
+ */
+typedef struct pse_dependency {
+	unsigned int count;
+	unsigned int offset;
+	double (*priors)(unsigned int, unsigned int *);
+	unsigned int prior_pending;
+	unsigned int evaluated;
+	unsigned int dirty;
+	unsigned int location;
+	double parameters[PSE_MAX_DIST_PARAMS];
+	pse_sampler_cache cache;
+} pse_dependency;
+
+/*
+ * Specialized sampling routines. Each takes the current value, the point
+ * parameters and the sampler cache of a variable.
+ */
+typedef int (*pse_int_sampler)(int, double *, pse_sampler_cache *);
+typedef double (*pse_double_sampler)(double, double *, pse_sampler_cache *);
+
 /*
  * Definition of variables
  *
@@ -144,6 +263,18 @@ typedef union pse_content {
  * An interesting flag is read_and_alter. This is a destructive operation in
  * the sense in which measurements modify the content of a variable. If active,
  * each observe call replaces the value with the most recent stochastic one.
+ *
+ * The step counts how many times the variable has been sampled. It is the
+ * stream position used by the counter-based generator.
+ *
+ * The sampling routines for the point distribution are resolved when the
+ * variable is registered (and when the sampler of the stub changes), so that
+ * an observation does not dispatch on the distribution again.
+ *
+ * SDE models and custom samplers are not stored in checkpoints.
+ * sampler_pending marks a variable restored from one that had a model or a
+ * sampler, which must be supplied again; until then its observations fail
+ * with PSE_ERROR_SAMPLER_MISSING.
  */
 typedef struct pse_variable {
 	pse_storage_type storage;
@@ -151,6 +282,10 @@ typedef struct pse_variable {
 	pse_locality_type locality;
 	pse_distribution_type point_distribution;
 	double point_parameters[PSE_MAX_DIST_PARAMS];
+	pse_sampler_cache point_cache;
+	pse_int_sampler sample_int;
+	pse_double_sampler sample_double;
+	unsigned int sampler_pending;
 	unsigned int has_dependencies;
 	unsigned int read_and_alter;
 	char name[PSE_VARNAME_SIZE];
@@ -159,8 +294,37 @@ typedef struct pse_variable {
 	unsigned int size;
 	pse_distribution_type array_distribution;
 	double array_parameters[PSE_MAX_DIST_PARAMS];
+	unsigned long long step;
 } pse_variable;
 
+/*
+ * Random number generator backends. The L'Ecuyer generator is sequential and
+ * keeps its tables in the stub. The Philox generator is counter-based: every
+ * draw is a function of (seed, agent id, variable id, step), so any draw can
+ * be computed on any thread, in any order, with identical results.
+ */
+typedef enum pse_rng_type {
+	PSE_RNG_LECUYER,
+	PSE_RNG_PHILOX
+} pse_rng_type;
+
+/*
+ * Samplers for normal and exponential distributions. PSE_SAMPLER_ZIGGURAT
+ * uses the table-driven Ziggurat method (Marsaglia and Tsang), which needs a
+ * single generator draw and no transcendental call for almost every sample.
+ * PSE_SAMPLER_CLASSIC keeps the polar and inversion methods of ranlib_r8.
+ * The default may be changed at build time by defining PSE_DEFAULT_SAMPLER,
+ * and per stub with pse_set_sampler() before pse_start().
+ */
+typedef enum pse_sampler_type {
+	PSE_SAMPLER_ZIGGURAT,
+	PSE_SAMPLER_CLASSIC
+} pse_sampler_type;
+
+#ifndef PSE_DEFAULT_SAMPLER
+#define PSE_DEFAULT_SAMPLER	PSE_SAMPLER_ZIGGURAT
+#endif
+
 typedef enum pse_state {
 	CREATED,
 	INITIALIZED,
@@ -170,14 +334,57 @@ typedef enum pse_state {
 
 /*
  * Var count and var limit differ in terms of what has been used in the array
- * and how many variables are used.
+ * and how many variables are used. Both the variable and the dependency arrays
+ * hold var_capacity elements and grow on registration, so stubs are sized to
+ * the agent rather than to a global maximum. The dependency of a variable is
+ * meaningful only if the variable has_dependencies; its conditionals are a run
+ * of the shared pool, and its last evidence the same run of the evidence pool.
+ *
+ * pse_start() turns the dependencies into a graph. The dependents of each
+ * variable are stored in compressed form like the conditionals (a run of
+ * dependents starting at dependent_offsets[varid]), and order lists the
+ * variables with dependencies so that each follows all of its conditionals.
+ * The order is grouped in levels (runs starting at level_offsets[level]):
+ * the conditionals of a variable all lie in earlier levels, so the variables
+ * of one level are independent of each other given the levels before.
+ *
+ * Each stub owns its random number generator state. It is seeded in
+ * pse_start() and bound to the calling thread only while the stub samples,
+ * so stubs never perturb each other's streams and distinct stubs may be
+ * stepped from distinct threads.
+ *
+ * When a recorder is attached (see pserec.h), every numeric observation is
+ * recorded under the agent identifier given on attachment.
+ *
+ * Block priors, if supplied (see psegibbs.h), evaluate the priors of a whole
+ * level of the graph at once during Gibbs sweeps. Like the priors of
+ * dependencies, a restored block prior is pending until supplied again.
  */
+struct pse_prior_block;
+
 typedef struct pse_agent_stub {
 	pse_state state;
 	unsigned int var_count;
 	unsigned int var_limit;
-	pse_variable *variables[PSE_MAX_VARIABLES];
-	pse_dependency *dependencies[PSE_MAX_VARIABLES];
+	unsigned int var_capacity;
+	pse_variable **variables;
+	pse_dependency *dependencies;
+	unsigned int cond_count;
+	unsigned int cond_capacity;
+	pse_depid *conditionals;
+	unsigned int *evidence;
+	unsigned int *dependent_offsets;
+	pse_varid *dependents;
+	pse_varid *order;
+	unsigned int order_count;
+	unsigned int *level_offsets;
+	unsigned int level_count;
+	void (*block_priors)(struct pse_prior_block *);
+	unsigned int block_prior_pending;
+	rng_state rng;
+	pse_sampler_type sampler;
+	struct pse_recorder *recorder;
+	unsigned int agent;
 } pse_agent_stub;
 
 
@@ -197,7 +404,14 @@ typedef enum pse_error {
 	PSE_ERROR_TYPE_UNKNOWN					= -17,
 	PSE_ERROR_TYPE_MISMATCH					= -19,
 	PSE_ERROR_ARRAY_OUTOFBOUNDS				= -21,
-	PSE_ERROR_VARIABLE_IS_IMMUTABLE			= -23
+	PSE_ERROR_VARIABLE_IS_IMMUTABLE			= -23,
+	PSE_ERROR_IO							= -25,
+	PSE_ERROR_CHECKPOINT_INVALID			= -27,
+	PSE_ERROR_DEPENDENCY_CYCLE				= -29,
+	PSE_ERROR_TABLE_INVALID					= -31,
+	PSE_ERROR_PRIOR_MISSING					= -33,
+	PSE_ERROR_SAMPLER_MISSING				= -35,
+	PSE_ERROR_NAME_TOO_LONG					= -37
 } pse_error;
 
 /*
@@ -214,6 +428,8 @@ typedef enum pse_error {
 
 pse_error pse_init(pse_agent_stub *);
 pse_error pse_start(pse_agent_stub *, int, int);
+pse_error pse_start_rng(pse_agent_stub *, pse_rng_type, int, int);
+pse_error pse_set_sampler(pse_agent_stub *, pse_sampler_type);
 pse_error pse_finalize(pse_agent_stub *);
 
 pse_varid pse_register(pse_agent_stub *, pse_storage_type, pse_model_type,
@@ -230,15 +446,43 @@ pse_error pse_supply_prior(pse_agent_stub *, pse_varid,
 
 
 pse_variable * pse_template(pse_variable *, pse_variable *);
+pse_error pse_template_bind(pse_variable *, pse_variable *);
 void pse_scratch(pse_variable *);
 
 void pse_prepare(pse_agent_stub *, pse_varid, pse_content, unsigned int,
 						pse_storage_type,pse_error *);
 void pse_observe(pse_agent_stub *, pse_varid, unsigned int, pse_variable *, pse_error *);
 
+/*
+ * A batch fills out with count observations, chained under read_and_alter.
+ * It equals count calls to pse_observe() except for uniform doubles,
+ * PSE_SAMPLER_CLASSIC normal, exponential and FOKKER_PLANCK doubles, and
+ * CUSTOM variables without read_and_alter, which match them in distribution
+ * only.
+ */
+void pse_observe_batch(pse_agent_stub *, pse_varid, unsigned int, pse_content,
+						unsigned int, pse_storage_type, pse_error *);
+int pse_observe_int(pse_agent_stub *, pse_varid, unsigned int, pse_error *);
+double pse_observe_double(pse_agent_stub *, pse_varid, unsigned int, pse_error *);
+pse_time pse_observe_time(pse_agent_stub *, pse_varid, unsigned int, pse_error *);
+
+/*
+ * Steps of an observation, for wrappers that call the resolved samplers of a
+ * variable themselves (see pse.hpp): position the stream of the next draw,
+ * and mark the dependents of a variable whose stored value has been written.
+ */
+void pse_rng_position(pse_agent_stub *, pse_varid);
+void pse_touch(pse_agent_stub *, pse_varid);
+
 void pse_error_log(pse_error, char *, char *);
 
 int pse_read_int(pse_agent_stub *, pse_varid);
 double pse_read_double(pse_agent_stub *, pse_varid);
 char * pse_read_string(pse_agent_stub *, pse_varid);
 pse_time pse_read_time(pse_agent_stub *, pse_varid);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,503 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#ifndef PSE_HPP
+#define PSE_HPP
+
+#include <initializer_list>
+#include <type_traits>
+
+#include <pse.h>
+#include <psedraw.h>
+#include <pserec.h>
+
+/*
+ * C++17 facade over agent stubs
+ *
+ * pse::Variable<T, Dist> is a typed handle on a variable of an existing
+ * pse_agent_stub. The storage type follows from T (int or double) and the
+ * distribution is a template parameter, checked against the storage at
+ * compile time, so observing and preparing need no content unions and no
+ * storage tags. Draws call the sampler of the distribution directly, the
+ * same routine pse_register() resolved for the variable and pse_observe()
+ * calls through it.
+ *
+ * Handles and the C API may be mixed freely on the same stub. Both draw from
+ * the generator of the stub at the same stream positions and with the same
+ * samplers, so a value observed through a handle is the value pse_observe()
+ * would have returned.
+ *
+ * Like the C API, handles never throw. Construction, observation and
+ * preparation each record a pse_error, and error() returns that of the last
+ * of them. Observation and preparation assume a started
+ * stub and a location inside the variable; they skip the checks that
+ * pse_observe() repeats on every call. Variables with dependencies are drawn
+ * from their conditioned parameters, which only the C API knows about, so
+ * their handles call it. So do handles of restored variables whose model or
+ * sampler is pending (see pse_variable in pse.h), which the C API refuses to
+ * draw.
+ */
+namespace pse {
+
+/*
+ * Storage type of a C++ type
+ */
+template <typename T> struct storage;
+
+template <> struct storage<int> {
+	static constexpr pse_storage_type value = PSE_VAR_INT;
+};
+
+template <> struct storage<double> {
+	static constexpr pse_storage_type value = PSE_VAR_DOUBLE;
+};
+
+/*
+ * Storage type a distribution samples into; void means that it accepts both
+ * (e.g. distributions whose behavior is supplied at run time). Typed
+ * distributions also name their sampler (see psedraw.h), which handles call
+ * directly rather than through the pointer resolved at registration.
+ */
+template <pse_distribution_type Dist> struct sampled {
+	typedef void type;
+};
+
+template <> struct sampled<PSE_DIST_UNIFORM_INT_SELF> {
+	typedef int type;
+
+	static int draw(int value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_uniform_int_self(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_UNIFORM_INT_BOUNDED> {
+	typedef int type;
+
+	static int draw(int value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_uniform_int_bounded(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_BERNOULLI> {
+	typedef int type;
+
+	static int draw(int value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_bernoulli(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_BINOMIAL> {
+	typedef int type;
+
+	static int draw(int value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_binomial(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_BINOMIAL_SELF> {
+	typedef int type;
+
+	static int draw(int value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_binomial_self(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_NEG_BINOMIAL> {
+	typedef int type;
+
+	static int draw(int value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_neg_binomial(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_NEG_BINOMIAL_SELF> {
+	typedef int type;
+
+	static int draw(int value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_neg_binomial_self(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_POISSON> {
+	typedef int type;
+
+	static int draw(int value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_poisson(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_POISSON_SELF> {
+	typedef int type;
+
+	static int draw(int value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_poisson_self(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_UNIFORM_DOUBLE_SELF> {
+	typedef double type;
+
+	static double draw(double value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_uniform_double_self(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_UNIFORM_DOUBLE_BOUNDED> {
+	typedef double type;
+
+	static double draw(double value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_uniform_double_bounded(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_NORMAL> {
+	typedef double type;
+
+	static double draw(double value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type sampler) {
+		return sampler == PSE_SAMPLER_CLASSIC ? pse_draw_normal_classic(value, pars, cache) :
+					pse_draw_normal(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_NORMAL_SELF> {
+	typedef double type;
+
+	static double draw(double value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type sampler) {
+		return sampler == PSE_SAMPLER_CLASSIC ? pse_draw_normal_self_classic(value, pars, cache) :
+					pse_draw_normal_self(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_EXPONENTIAL> {
+	typedef double type;
+
+	static double draw(double value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type sampler) {
+		return sampler == PSE_SAMPLER_CLASSIC ? pse_draw_exponential_classic(value, pars, cache) :
+					pse_draw_exponential(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_EXPONENTIAL_SELF> {
+	typedef double type;
+
+	static double draw(double value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type sampler) {
+		return sampler == PSE_SAMPLER_CLASSIC ? pse_draw_exponential_self_classic(value, pars, cache) :
+					pse_draw_exponential_self(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_GAMMA> {
+	typedef double type;
+
+	static double draw(double value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_gamma(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_GAMMA_SELF> {
+	typedef double type;
+
+	static double draw(double value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_gamma_self(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_CHISQ> {
+	typedef double type;
+
+	static double draw(double value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_chisq(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_CHISQ_SELF> {
+	typedef double type;
+
+	static double draw(double value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_chisq_self(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_F> {
+	typedef double type;
+
+	static double draw(double value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_f(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_BETA> {
+	typedef double type;
+
+	static double draw(double value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_beta(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_FOKKER_PLANCK> {
+	typedef double type;
+
+	static double draw(double value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type sampler) {
+		return sampler == PSE_SAMPLER_CLASSIC ? pse_draw_fokker_planck_classic(value, pars, cache) :
+					pse_draw_fokker_planck(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_TABLE_INT> {
+	typedef int type;
+
+	static int draw(int value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_table_int(value, pars, cache);
+	}
+};
+
+template <> struct sampled<PSE_DIST_TABLE_DOUBLE> {
+	typedef double type;
+
+	static double draw(double value, double *pars, pse_sampler_cache *cache,
+				pse_sampler_type) {
+		return pse_draw_table_double(value, pars, cache);
+	}
+};
+
+/*
+ * Typed variable handle
+ */
+template <typename T, pse_distribution_type Dist>
+class Variable {
+	static_assert(std::is_same<T, int>::value || std::is_same<T, double>::value,
+					"pse::Variable holds int or double contents");
+	static_assert(std::is_void<typename sampled<Dist>::type>::value ||
+					std::is_same<typename sampled<Dist>::type, T>::value,
+					"the distribution does not sample this storage type");
+
+public:
+	/*
+	 * Register a new stochastic agent variable in an initialized stub. A size
+	 * above one registers an array whose locations are observed independently.
+	 */
+	Variable(pse_agent_stub &stub, const char *name,
+				std::initializer_list<double> parameters,
+				bool read_and_alter = false, unsigned int size = 1)
+		: stub_(&stub), varid_(-1), var_(NULL), error_(PSE_ERROR_OK) {
+		double point[PSE_MAX_DIST_PARAMS] = {0};
+		double array[PSE_MAX_DIST_PARAMS] = {0};
+		unsigned int i = 0;
+
+		for (double parameter : parameters) {
+			if (i < PSE_MAX_DIST_PARAMS)
+				point[i++] = parameter;
+		}
+
+		varid_ = pse_register(stub_, storage<T>::value, PSE_VAR_STOCHASTIC,
+					PSE_AGENT, Dist, point, size > 1 ? PSE_ARRAY : PSE_SCALAR,
+					size, read_and_alter ? PSE_TRUE : PSE_FALSE, PSE_DIST_NONE,
+					array, const_cast<char *>(name));
+
+		if (varid_ < 0)
+			error_ = (pse_error) varid_;
+		else
+			var_ = stub_->variables[varid_];
+	}
+
+	/*
+	 * Bind to a variable already registered through the C API. Fails with
+	 * PSE_ERROR_TYPE_MISMATCH unless storage and distribution agree with T
+	 * and Dist. Double handles also bind to time variables.
+	 */
+	Variable(pse_agent_stub &stub, pse_varid varid)
+		: stub_(&stub), varid_(varid), var_(NULL), error_(PSE_ERROR_OK) {
+		pse_variable *var;
+
+		if (varid < 0 || (unsigned int) varid >= stub.var_limit ||
+				stub.variables[varid] == NULL) {
+			error_ = PSE_ERROR_VARIABLE_UNKNOWN;
+			return;
+		}
+
+		var = stub.variables[varid];
+
+		if ((var->storage != storage<T>::value &&
+				!(var->storage == PSE_VAR_TIME && std::is_same<T, double>::value)) ||
+				var->point_distribution != Dist) {
+			error_ = PSE_ERROR_TYPE_MISMATCH;
+			return;
+		}
+
+		var_ = var;
+	}
+
+	pse_error error() const {
+		return error_;
+	}
+
+	pse_varid id() const {
+		return varid_;
+	}
+
+	/*
+	 * Equivalent of pse_observe_int() and pse_observe_double()
+	 */
+	T observe(unsigned int location = 0) {
+		T *slot = content(location);
+		rng_state *previous;
+		T value;
+
+		if (var_->model == PSE_VAR_STOCHASTIC && (var_->has_dependencies == PSE_TRUE ||
+				var_->sampler_pending == PSE_TRUE)) {
+			if (std::is_same<T, int>::value)
+				return pse_observe_int(stub_, varid_, location, &error_);
+			else if (var_->storage == PSE_VAR_TIME)
+				return pse_observe_time(stub_, varid_, location, &error_);
+			else
+				return pse_observe_double(stub_, varid_, location, &error_);
+		}
+
+		error_ = PSE_ERROR_OK;
+
+		if (var_->model == PSE_VAR_DETERMINISTIC) {
+			value = *slot;
+		} else {
+			previous = rng_state_bind(&stub_->rng);
+			pse_rng_position(stub_, varid_);
+			value = draw(*slot);
+			rng_state_bind(previous);
+
+			if (var_->read_and_alter == PSE_TRUE) {
+				*slot = value;
+				pse_touch(stub_, varid_);
+			}
+		}
+
+		if (stub_->recorder != NULL)
+			pse_rec_append(stub_->recorder, stub_->agent, varid_, location, value);
+
+		return value;
+	}
+
+	/*
+	 * Equivalent of pse_prepare(): store value and, for stochastic
+	 * read_and_alter array variables, replace it at once with a draw from it.
+	 * Scalars are stored as given.
+	 */
+	void prepare(T value, unsigned int location = 0) {
+		T *slot = content(location);
+		rng_state *previous;
+		pse_content stored;
+
+		if (var_->array == PSE_ARRAY && var_->model == PSE_VAR_STOCHASTIC &&
+				(var_->has_dependencies == PSE_TRUE || var_->sampler_pending == PSE_TRUE)) {
+			if (std::is_same<T, int>::value)
+				stored.cint = static_cast<int>(value);
+			else
+				stored.cdouble = static_cast<double>(value);
+
+			pse_prepare(stub_, varid_, stored, location, var_->storage, &error_);
+			return;
+		}
+
+		error_ = PSE_ERROR_OK;
+		*slot = value;
+		pse_touch(stub_, varid_);
+
+		if (var_->array == PSE_SCALAR || var_->model != PSE_VAR_STOCHASTIC)
+			return;
+
+		previous = rng_state_bind(&stub_->rng);
+		pse_rng_position(stub_, varid_);
+
+		if (var_->read_and_alter == PSE_TRUE)
+			*slot = draw(*slot);
+
+		rng_state_bind(previous);
+	}
+
+	/*
+	 * Equivalent of pse_observe_batch(), which it calls
+	 */
+	pse_error observe(T *out, unsigned int count, unsigned int location = 0) {
+		pse_content buffer;
+
+		if (std::is_same<T, int>::value)
+			buffer.cint_a = reinterpret_cast<int *>(out);
+		else
+			buffer.cdouble_a = reinterpret_cast<double *>(out);
+
+		pse_observe_batch(stub_, varid_, location, buffer, count,
+							var_->storage, &error_);
+
+		return error_;
+	}
+
+	/*
+	 * Stored value, for instrumentation only (as pse_read_int() and friends)
+	 */
+	T read(unsigned int location = 0) const {
+		return *content(location);
+	}
+
+private:
+	pse_agent_stub *stub_;
+	pse_varid varid_;
+	pse_variable *var_;
+	pse_error error_;
+
+	T * content(unsigned int location) const {
+		if (std::is_same<T, int>::value)
+			return reinterpret_cast<T *>(var_->array == PSE_SCALAR ?
+						&var_->content.cint : &var_->content.cint_a[location]);
+		else
+			return reinterpret_cast<T *>(var_->array == PSE_SCALAR ?
+						&var_->content.cdouble : &var_->content.cdouble_a[location]);
+	}
+
+	/*
+	 * Draw with the sampler of the distribution, or with the one
+	 * pse_register() resolved for the variable when Dist accepts both types
+	 */
+	T draw(T value) const {
+		if constexpr (!std::is_void<typename sampled<Dist>::type>::value)
+			return sampled<Dist>::draw(value, var_->point_parameters,
+						&var_->point_cache, stub_->sampler);
+		else if (std::is_same<T, int>::value)
+			return static_cast<T>(var_->sample_int(static_cast<int>(value),
+						var_->point_parameters, &var_->point_cache));
+		else
+			return static_cast<T>(var_->sample_double(static_cast<double>(value),
+						var_->point_parameters, &var_->point_cache));
+	}
+};
+
+}
+
+#endif
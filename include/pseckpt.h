@@ -0,0 +1,81 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#ifndef PSECKPT_H
+#define PSECKPT_H
+
+#include <pse.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Checkpoints of agent stubs
+ *
+ * A checkpoint holds a set of stubs in one contiguous image: a header, then
+ * for each stub its counters and generator state, its variables (each one
+ * followed by its dependency and its array or string contents) and its pool
+ * of conditionals. The image is built in memory and written at once; a
+ * restore reads it at once and rebuilds the heap objects of each stub from it.
+ *
+ * Variables and dependencies are stored in the layout of the running build, so
+ * a checkpoint can only be restored by a build with the same layout (which is
+ * checked). Prior, block prior, SDE model and custom sampler functions are
+ * addresses in the writing process and are not stored: they must be supplied
+ * again after a restore, and priors are evaluated afresh on the first
+ * observation. Restored stubs, even started ones, take their priors and block
+ * prior again through pse_supply_prior() and pse_supply_block_prior(); until
+ * then, observations of the dependencies and Gibbs sweeps fail with
+ * PSE_ERROR_PRIOR_MISSING. Likewise, restored FOKKER_PLANCK variables that
+ * had a model and CUSTOM variables that had a sampler fail with
+ * PSE_ERROR_SAMPLER_MISSING until pse_supply_sde() or pse_supply_sampler()
+ * is called for them again.
+ * Tables are stored as their source data and built again on restore, shared
+ * with equal tables already in use. Restored stubs have no recorder attached.
+ */
+#define PSE_CKPT_MAGIC		"PSECKPT"
+#define PSE_CKPT_VERSION	7
+
+typedef struct pse_ckpt_header {
+	char magic[8];
+	unsigned int version;
+	unsigned int stubs;
+	unsigned int variable_size;
+	unsigned int rng_size;
+	unsigned int dependency_size;
+	unsigned long long bytes;
+} pse_ckpt_header;
+
+typedef struct pse_ckpt_stub {
+	pse_state state;
+	pse_sampler_type sampler;
+	unsigned int var_count;
+	unsigned int var_limit;
+	unsigned int var_capacity;
+	unsigned int cond_count;
+	unsigned int agent;
+	unsigned int block_prior;
+	rng_state rng;
+} pse_ckpt_stub;
+
+/**
+ * Write count stubs (initialized or started) to a file, and read them back
+ * into count stubs in the CREATED state. A restored stub resumes in the state
+ * it was saved in and draws exactly what the original would have drawn.
+ */
+pse_error pse_checkpoint(pse_agent_stub *, unsigned int, char *);
+pse_error pse_restore(pse_agent_stub *, unsigned int, char *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
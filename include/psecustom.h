@@ -0,0 +1,49 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#ifndef PSECUSTOM_H
+#define PSECUSTOM_H
+
+#include <pse.h>
+#include <psepop.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Custom samplers
+ *
+ * Variables and columns registered with PSE_DIST_CUSTOM draw with a sampler
+ * supplied by the model (see pse_custom_sampler in pse.h); until one is
+ * supplied they keep their value. The sampler fills a whole buffer per call:
+ *
+ * - single observations call it with one value, at the stream position of the
+ *   observation, so they are reproducible like any other distribution;
+ * - batch observations call it once for the whole batch and reserve the
+ *   steps of the batch, like the vector kernels of psesimd.h (self-updating
+ *   batches still call it once per draw, each draw depending on the last);
+ * - populations call it once per block of PSE_SIMD_BLOCK agents, with the
+ *   generator positioned at the first agent of the block.
+ *
+ * Population steps call samplers from several threads at once, each with its
+ * own generator. Like priors, samplers are not stored in checkpoints or
+ * snapshots. A variable or column restored from one that had a sampler fails
+ * to be observed or stepped with PSE_ERROR_SAMPLER_MISSING until a sampler
+ * is supplied again.
+ */
+pse_error pse_supply_sampler(pse_agent_stub *, pse_varid, pse_custom_sampler);
+pse_error pse_pop_supply_sampler(pse_population *, pse_varid, pse_custom_sampler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
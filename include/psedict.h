@@ -8,22 +8,60 @@
  * Author: Santiago Nunez-Corrales
  */
 
+#ifndef PSEDICT_H
+#define PSEDICT_H
+
 #include <pse.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
- * Structures for a PSE dictionary, to be handled as a singly-linked list.
+ * Structures for a PSE dictionary, to be handled as an open-addressing hash
+ * table. Entries are kept in a dense array that never moves an entry to
+ * another index; the table itself only stores entry indices, so it can be
+ * rehashed without invalidating handles. Entries of removed names are chained
+ * through next_free and given to the names added next; the generation of an
+ * entry counts its removals, so that handles on an earlier name are told
+ * apart from handles on the name that took the entry.
  */
+#define PSE_DICT_INITIAL_SLOTS	16
+#define PSE_DICT_EMPTY			-1
+#define PSE_DICT_DELETED		-2
+
 typedef struct pse_entry {
 	char varname[PSE_VARNAME_SIZE];
 	pse_varid assigned;
-	struct pse_entry *next;
+	unsigned int hash;
+	unsigned int live;
+	unsigned int generation;
+	int next_free;
 } pse_entry;
 
 typedef struct pse_dictionary {
 	int length;
-	pse_entry *head;
+	int entry_count;
+	int entry_limit;
+	int slot_count;
+	int slot_used;
+	int free_entry;
+	int *slots;
+	pse_entry *entries;
 } pse_dictionary;
 
+/**
+ * A handle designates one name of a dictionary. It is obtained once through
+ * pse_dict_resolve and stays valid until the name is removed. It holds the
+ * index of the entry and, above PSE_DICT_GENERATION_SHIFT, its generation:
+ * once the name is removed, the handle no longer designates anything, even
+ * after its entry is given to a name added later.
+ */
+#define PSE_DICT_GENERATION_SHIFT	32
+#define PSE_DICT_GENERATION_MASK	0x7fffffffu
+
+typedef long long pse_dict_handle;
+
 /**
  * Functions to search inside the PSE dictionary. This provides a symbolic
  * link between PSE registration return values and variable names. This handle
@@ -35,3 +73,18 @@ void pse_dict_finalize(pse_dictionary *);
 int pse_dict_add(pse_dictionary *, char *, pse_varid);
 int pse_dict_remove(pse_dictionary *, char *);
 int pse_dict_search(pse_dictionary *, char *);
+
+/**
+ * Hashed access. Names can be hashed ahead of time (e.g. at code generation)
+ * and resolved into handles, so that repeated lookups cost one array access.
+ */
+unsigned int pse_dict_hash(char *);
+int pse_dict_search_hashed(pse_dictionary *, char *, unsigned int);
+pse_dict_handle pse_dict_resolve(pse_dictionary *, char *);
+pse_varid pse_dict_get(pse_dictionary *, pse_dict_handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#ifndef PSEDRAW_H
+#define PSEDRAW_H
+
+#include <pse.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Samplers
+ *
+ * One routine per distribution, the ones pse_register() resolves into the
+ * sample_int and sample_double fields of a variable. Each draws one value
+ * from the bound generator, the stream being positioned by the caller (see
+ * pse_rng_position), with the point parameters and sampler cache of the
+ * variable. NORMAL, EXPONENTIAL and FOKKER_PLANCK come in two versions: the
+ * default one for PSE_SAMPLER_ZIGGURAT and a _classic one for
+ * PSE_SAMPLER_CLASSIC.
+ *
+ * They are exposed for code that knows the distribution of a variable at
+ * compile time, such as the C++ facade, and may then call them directly
+ * instead of through the resolved pointers. Applications otherwise use
+ * pse_observe() and its variants.
+ */
+int pse_draw_uniform_int_self(int, double *, pse_sampler_cache *);
+int pse_draw_uniform_int_bounded(int, double *, pse_sampler_cache *);
+int pse_draw_bernoulli(int, double *, pse_sampler_cache *);
+int pse_draw_binomial(int, double *, pse_sampler_cache *);
+int pse_draw_binomial_self(int, double *, pse_sampler_cache *);
+int pse_draw_neg_binomial(int, double *, pse_sampler_cache *);
+int pse_draw_neg_binomial_self(int, double *, pse_sampler_cache *);
+int pse_draw_poisson(int, double *, pse_sampler_cache *);
+int pse_draw_poisson_self(int, double *, pse_sampler_cache *);
+int pse_draw_int_custom(int, double *, pse_sampler_cache *);
+int pse_draw_table_int(int, double *, pse_sampler_cache *);
+int pse_draw_int_none(int, double *, pse_sampler_cache *);
+int pse_draw_int_zero(int, double *, pse_sampler_cache *);
+double pse_draw_uniform_double_self(double, double *, pse_sampler_cache *);
+double pse_draw_uniform_double_bounded(double, double *, pse_sampler_cache *);
+double pse_draw_normal(double, double *, pse_sampler_cache *);
+double pse_draw_normal_classic(double, double *, pse_sampler_cache *);
+double pse_draw_normal_self(double, double *, pse_sampler_cache *);
+double pse_draw_normal_self_classic(double, double *, pse_sampler_cache *);
+double pse_draw_exponential(double, double *, pse_sampler_cache *);
+double pse_draw_exponential_classic(double, double *, pse_sampler_cache *);
+double pse_draw_exponential_self(double, double *, pse_sampler_cache *);
+double pse_draw_exponential_self_classic(double, double *, pse_sampler_cache *);
+double pse_draw_gamma(double, double *, pse_sampler_cache *);
+double pse_draw_gamma_self(double, double *, pse_sampler_cache *);
+double pse_draw_f(double, double *, pse_sampler_cache *);
+double pse_draw_beta(double, double *, pse_sampler_cache *);
+double pse_draw_chisq(double, double *, pse_sampler_cache *);
+double pse_draw_chisq_self(double, double *, pse_sampler_cache *);
+double pse_draw_fokker_planck(double, double *, pse_sampler_cache *);
+double pse_draw_fokker_planck_classic(double, double *, pse_sampler_cache *);
+double pse_draw_custom(double, double *, pse_sampler_cache *);
+double pse_draw_table_double(double, double *, pse_sampler_cache *);
+double pse_draw_double_none(double, double *, pse_sampler_cache *);
+double pse_draw_double_zero(double, double *, pse_sampler_cache *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#ifndef PSEGIBBS_H
+#define PSEGIBBS_H
+
+#include <pse.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Gibbs sampling over the dependency graph
+ *
+ * A sweep draws every location of every stochastic variable with dependencies
+ * from its distribution conditioned on the current values of its conditionals,
+ * and stores the draw in place, as a self-updating observation would. Sweeps
+ * visit the graph built by pse_start() level by level: the variables of a
+ * level only condition on earlier levels, so each level is drawn as one block.
+ * Draws take the stream positions of single observations, so a sweep is
+ * reproducible and equals observing each location in turn.
+ *
+ * The first burn_in sweeps only move the network away from its prepared
+ * values. When a recorder is attached, the draws of the sweeps that follow are
+ * recorded.
+ *
+ * By default priors are evaluated one dependency at a time, with the
+ * memoization of observations. A block prior is called once per level instead
+ * and receives all of its locations: item i is variable varids[i] at
+ * locations[i], its evidence runs from evidence[offsets[i]] up to (excluding)
+ * evidence[offsets[i + 1]], and its conditioned parameter is written to
+ * priors[i].
+ */
+typedef struct pse_prior_block {
+	unsigned int items;
+	pse_varid *varids;
+	unsigned int *locations;
+	unsigned int *offsets;
+	unsigned int *evidence;
+	double *priors;
+} pse_prior_block;
+
+pse_error pse_supply_block_prior(pse_agent_stub *, void (*)(pse_prior_block *));
+pse_error pse_gibbs(pse_agent_stub *, unsigned int, unsigned int);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
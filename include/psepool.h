@@ -0,0 +1,67 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#ifndef PSEPOOL_H
+#define PSEPOOL_H
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A fixed-size pool of worker threads running batches of independent tasks.
+ * Tasks are numbered 0..count-1 and dealt to workers in contiguous ranges.
+ * Each worker consumes its own range from the front; a worker whose range is
+ * exhausted steals from the back of another worker's range, so uneven tasks
+ * still keep every worker busy.
+ *
+ * The thread calling pse_pool_run() takes part as worker 0, hence a pool of
+ * size n starts n - 1 threads. The task function receives the index of the
+ * worker running it, which callers use to select per-worker state.
+ */
+typedef void (*pse_pool_task)(void *, unsigned int, unsigned int);
+
+typedef struct pse_pool_deque {
+	pthread_mutex_t lock;
+	unsigned int head;
+	unsigned int tail;
+} pse_pool_deque;
+
+typedef struct pse_pool_worker {
+	struct pse_pool *pool;
+	unsigned int id;
+} pse_pool_worker;
+
+typedef struct pse_pool {
+	unsigned int size;
+	pthread_t *threads;
+	pse_pool_worker *workers;
+	pse_pool_deque *deques;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+	unsigned int generation;
+	unsigned int running;
+	unsigned int shutdown;
+	pse_pool_task task;
+	void *arg;
+} pse_pool;
+
+pse_pool * pse_pool_create(unsigned int);
+void pse_pool_destroy(pse_pool *);
+void pse_pool_run(pse_pool *, pse_pool_task, void *, unsigned int);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#ifndef PSEPOP_H
+#define PSEPOP_H
+
+#include <pse.h>
+#include <psepool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Populations are the structure-of-arrays counterpart of agent stubs. All
+ * agents in a population share one schema: variables (columns) are registered
+ * once with their storage, distribution and parameters, and the value of
+ * every agent lives in one contiguous typed array per column. Observing a
+ * column is then a streaming pass over that array.
+ *
+ * Columns hold numeric scalars only (PSE_VAR_INT, PSE_VAR_DOUBLE and
+ * PSE_VAR_TIME). Per-agent strings and arrays remain the domain of stubs.
+ * Names that do not fit in PSE_VARNAME_SIZE are refused with
+ * PSE_ERROR_NAME_TOO_LONG.
+ */
+typedef struct pse_column {
+	pse_storage_type storage;
+	pse_model_type model;
+	pse_distribution_type point_distribution;
+	double point_parameters[PSE_MAX_DIST_PARAMS];
+	pse_sampler_cache point_cache;
+	pse_int_sampler sample_int;
+	pse_double_sampler sample_double;
+	unsigned int sampler_pending;
+	unsigned int read_and_alter;
+	char name[PSE_VARNAME_SIZE];
+	pse_content values;
+	unsigned long long step;
+} pse_column;
+
+/*
+ * With PSE_RNG_PHILOX, agent i of a population draws exactly what a stub
+ * started with pse_start_rng(stub, PSE_RNG_PHILOX, seed, i) would draw for the
+ * same variable identifier and step and the same sampler. Uniform double
+ * columns are the exception, and so are normal and exponential double columns
+ * under PSE_SAMPLER_CLASSIC: they are transformed by the vector kernels of
+ * psesimd.h and agree with stubs in distribution only. So do CUSTOM columns,
+ * whose sampler draws a block of agents from one stream (see psecustom.h).
+ *
+ * The pool and the worker generators are created by the first parallel step
+ * and kept until the population is finalized.
+ *
+ * A population mapped from a snapshot (see psesnap.h) keeps the mapping,
+ * which holds the values of the columns it was saved with. As in stubs,
+ * sampler_pending marks a mapped column whose SDE model or custom sampler
+ * must be supplied again; until then observations and steps fail with
+ * PSE_ERROR_SAMPLER_MISSING.
+ */
+#define PSE_POP_INITIAL_COLUMNS	16
+
+typedef struct pse_population {
+	pse_state state;
+	unsigned int agent_count;
+	unsigned int column_count;
+	unsigned int column_limit;
+	unsigned int seed;
+	pse_sampler_type sampler;
+	pse_column *columns;
+	rng_state rng;
+	pse_pool *pool;
+	rng_state *worker_rng;
+	void *mapping;
+	unsigned long long mapping_size;
+} pse_population;
+
+pse_error pse_pop_init(pse_population *, unsigned int);
+pse_error pse_pop_start(pse_population *, pse_rng_type, int, int);
+pse_error pse_pop_set_sampler(pse_population *, pse_sampler_type);
+pse_error pse_pop_finalize(pse_population *);
+
+pse_varid pse_pop_register(pse_population *, pse_storage_type, pse_model_type,
+						pse_distribution_type, double *, unsigned int, char *);
+
+void pse_pop_prepare(pse_population *, pse_varid, unsigned int, pse_content,
+						pse_storage_type, pse_error *);
+void pse_pop_observe(pse_population *, pse_varid, pse_content,
+						pse_storage_type, pse_error *);
+
+/*
+ * A step observes every stochastic read_and_alter column for every agent,
+ * updating the columns in place. Agents are processed in chunks of
+ * PSE_POP_CHUNK by up to RNG_G_MAX threads. FOKKER_PLANCK columns with a
+ * clock column are stepped last, after their clocks.
+ */
+#define PSE_POP_CHUNK	1024
+
+void pse_pop_step(pse_population *, unsigned int, pse_error *);
+
+pse_content pse_pop_column(pse_population *, pse_varid);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
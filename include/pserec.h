@@ -0,0 +1,128 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#ifndef PSEREC_H
+#define PSEREC_H
+
+#include <pthread.h>
+#include <stdio.h>
+#include <pse.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Observation recorder
+ *
+ * A recorder attached to a stub receives one entry per numeric observation:
+ * (tick, agent, variable, location, value). Each simulation thread appends to
+ * its own ring of PSE_REC_RING entries, without locks or formatting. A
+ * background thread drains the rings every PSE_REC_INTERVAL milliseconds (or
+ * as soon as a ring is half full) and writes them as columnar blocks:
+ *
+ *   header | block | block | ...
+ *   block = count, ring | ticks[count] | agents[count] | varids[count] |
+ *           locations[count] | values[count]
+ *
+ * Numbers are in the byte order of the writer, which is recorded in the
+ * header. Entries of one thread appear in the order they were recorded;
+ * blocks of different threads are interleaved. A thread that fills its ring
+ * waits for the writer; threads beyond the first PSE_REC_RINGS are not
+ * recorded (see dropped).
+ *
+ * Stubs without a recorder only pay for testing one pointer per observation.
+ */
+#define PSE_REC_RING		4096
+#define PSE_REC_RINGS		RNG_G_MAX
+#define PSE_REC_INTERVAL	10
+#define PSE_REC_MAGIC		"PSEREC"
+#define PSE_REC_VERSION		1
+#define PSE_REC_BYTE_ORDER	0x01020304
+
+typedef struct pse_rec_entry {
+	unsigned long long tick;
+	unsigned int agent;
+	pse_varid varid;
+	unsigned int location;
+	double value;
+} pse_rec_entry;
+
+/*
+ * The producer only writes head and the writer only writes tail; they are
+ * kept on separate cache lines.
+ */
+typedef struct pse_rec_ring {
+	unsigned long long head;
+	char head_line[56];
+	unsigned long long tail;
+	char tail_line[56];
+	pthread_t owner;
+	unsigned long long stalls;
+	pse_rec_entry entries[PSE_REC_RING];
+} pse_rec_ring;
+
+typedef struct pse_recorder {
+	FILE *fp;
+	unsigned int serial;
+	unsigned int ring_count;
+	pse_rec_ring *rings[PSE_REC_RINGS];
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_t writer;
+	unsigned int shutdown;
+	unsigned long long tick;
+	unsigned long long stalls;
+	unsigned long long dropped;
+	pse_error error;
+	unsigned long long *ticks;
+	unsigned int *agents;
+	pse_varid *varids;
+	unsigned int *locations;
+	double *values;
+} pse_recorder;
+
+typedef struct pse_rec_header {
+	char magic[8];
+	unsigned int version;
+	unsigned int byte_order;
+} pse_rec_header;
+
+typedef struct pse_rec_block {
+	unsigned int count;
+	unsigned int ring;
+} pse_rec_block;
+
+/**
+ * Open a recorder writing to a file and start its writer thread; close it
+ * once no thread records any more. Closing drains every ring and reports
+ * PSE_ERROR_IO if any block could not be written.
+ */
+pse_error pse_rec_open(pse_recorder *, char *);
+pse_error pse_rec_close(pse_recorder *);
+
+/**
+ * Set the tick stamped on the entries that follow
+ */
+void pse_rec_tick(pse_recorder *, unsigned long long);
+
+/**
+ * Attach a recorder to a stub, recording under the given agent identifier.
+ * A NULL recorder detaches.
+ */
+pse_error pse_rec_attach(pse_agent_stub *, pse_recorder *, unsigned int);
+
+void pse_rec_append(pse_recorder *, unsigned int, pse_varid, unsigned int, double);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
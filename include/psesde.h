@@ -0,0 +1,64 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#ifndef PSESDE_H
+#define PSESDE_H
+
+#include <pse.h>
+#include <psepop.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Stochastic differential equations
+ *
+ * Variables and columns registered with PSE_DIST_FOKKER_PLANCK are advanced by
+ * one Euler-Maruyama step per observation (see pse_sde_setup in pse.h). By
+ * default drift, diffusion and step are taken from the point parameters.
+ *
+ * A model replaces the affine drift and diffusion. It is called with a block
+ * of values at a time and must not keep the pointers it receives; population
+ * steps may call it from several threads at once. A clock replaces the step:
+ * for a stub it is a scalar PSE_VAR_TIME variable of the same stub, for a
+ * population a PSE_VAR_TIME column, each agent stepping by its own value.
+ * PSE_SDE_NO_CLOCK keeps the step of the parameters. Population steps advance
+ * clocked columns after all the others, so the clock of a column may not be
+ * a clocked column itself (PSE_ERROR_TYPE_MISMATCH).
+ *
+ * Models are addresses in the running process. Like priors, they are not
+ * stored in checkpoints or snapshots: a variable or column restored from one
+ * that had a model fails to be observed, advanced or stepped with
+ * PSE_ERROR_SAMPLER_MISSING until a model is supplied again (supplying NULL
+ * returns it to the affine coefficients). Clocks survive both checkpoints
+ * and snapshots.
+ */
+#define PSE_SDE_NO_CLOCK	-1
+
+pse_error pse_supply_sde(pse_agent_stub *, pse_varid, pse_sde_model, pse_varid);
+pse_error pse_pop_supply_sde(pse_population *, pse_varid, pse_sde_model, pse_varid);
+
+/**
+ * Advance every location of a FOKKER_PLANCK variable (double or time,
+ * stochastic and read_and_alter) by one step, in place. Locations draw in
+ * order with the stream positions of single observations, so advancing equals
+ * observing each location in turn, but the model is evaluated once per block
+ * of locations. A variable with dependencies is conditioned location by
+ * location, and fails with PSE_ERROR_PRIOR_MISSING while a restored prior
+ * is pending.
+ */
+void pse_sde_advance(pse_agent_stub *, pse_varid, pse_error *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
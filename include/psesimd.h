@@ -0,0 +1,74 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#ifndef PSESIMD_H
+#define PSESIMD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Vectorized kernels for the most frequent continuous distributions. With the
+ * counter-based generator, uniform variates are computed a Philox block per
+ * vector lane, and equal those drawn one at a time; the L'Ecuyer generators
+ * are a sequential recurrence and still draw them one at a time. Their
+ * transformation into normal, exponential and bounded uniform variates runs
+ * in double precision on SIMD registers.
+ *
+ * The instruction set is detected at runtime. AVX-512F and AVX2 (with FMA) are
+ * used when available, SSE2 otherwise on x86-64, and portable C elsewhere. All
+ * levels evaluate the same polynomials, so they agree to within rounding.
+ */
+#define PSE_SIMD_BLOCK		256
+
+typedef enum pse_simd_level {
+	PSE_SIMD_NONE,
+	PSE_SIMD_SSE2,
+	PSE_SIMD_AVX2,
+	PSE_SIMD_AVX512
+} pse_simd_level;
+
+/*
+ * The level in effect is detected on first use, once per process. It can be
+ * lowered with pse_simd_select before any sampling starts.
+ */
+pse_simd_level pse_simd_detect(void);
+pse_simd_level pse_simd_select(pse_simd_level);
+
+/*
+ * Transformations of uniform variates in (0, 1]. Outputs may alias inputs.
+ */
+void pse_simd_affine(const double *, double *, unsigned int, double, double);
+void pse_simd_exponential_transform(const double *, double *, unsigned int);
+void pse_simd_normal_transform(const double *, const double *, double *, double *,
+						unsigned int);
+
+/*
+ * Uniform variates: n draws of the generator bound to the calling thread, and
+ * the first two draws of n agent streams of the counter-based generator (key
+ * (k0, first + i), counter (0, c1, c2, c3)).
+ */
+void pse_simd_uniform_01(double *, unsigned int);
+void pse_simd_uniform_pairs(unsigned int, unsigned int, unsigned int, unsigned int,
+						unsigned int, double *, double *, unsigned int);
+
+/*
+ * Complete samplers drawing from the generator bound to the calling thread.
+ */
+void pse_simd_uniform(double *, unsigned int, double, double);
+void pse_simd_normal(double *, unsigned int, double, double);
+void pse_simd_exponential(double *, unsigned int, double);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
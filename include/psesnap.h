@@ -0,0 +1,92 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#ifndef PSESNAP_H
+#define PSESNAP_H
+
+#include <psepop.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Snapshots of populations
+ *
+ * A snapshot is laid out so that it can be mapped and used in place:
+ *
+ *   header | column records | string pool | column values ...
+ *
+ * The header and the column records have a fixed layout. Column names live in
+ * the string pool, referenced by offset. The values of each column are the
+ * typed array of the column, one element per agent, starting on a
+ * PSE_SNAP_ALIGN boundary. All offsets are in bytes from the start of the
+ * file and all numbers are in the byte order of the writer, which is checked.
+ *
+ * Mapping a snapshot costs one pass over the column records: the values of
+ * every column point straight into the mapping. The mapping is private, so
+ * reads (e.g. deterministic columns through pse_pop_observe() or
+ * pse_pop_column()) are served from the shared page cache, and only the
+ * pages a population writes to are copied. Several processes mapping the same
+ * snapshot therefore share its memory.
+ *
+ * Column records keep the clock column of FOKKER_PLANCK columns, and whether
+ * they had a model or a custom sampler. Neither is stored: mapped columns
+ * that had one fail with PSE_ERROR_SAMPLER_MISSING until it is supplied
+ * again (see psesde.h and psecustom.h).
+ */
+#define PSE_SNAP_MAGIC		"PSESNAP"
+#define PSE_SNAP_VERSION	2
+#define PSE_SNAP_ALIGN		64
+#define PSE_SNAP_BYTE_ORDER	0x01020304
+
+typedef struct pse_snap_header {
+	char magic[8];
+	unsigned int version;
+	unsigned int byte_order;
+	unsigned int rng_size;
+	pse_state state;
+	pse_sampler_type sampler;
+	unsigned int seed;
+	unsigned int agent_count;
+	unsigned int column_count;
+	unsigned long long names_offset;
+	unsigned long long names_size;
+	unsigned long long bytes;
+	rng_state rng;
+} pse_snap_header;
+
+typedef struct pse_snap_column {
+	pse_storage_type storage;
+	pse_model_type model;
+	pse_distribution_type point_distribution;
+	unsigned int read_and_alter;
+	int clock;
+	unsigned int sampler_pending;
+	double point_parameters[PSE_MAX_DIST_PARAMS];
+	unsigned long long step;
+	unsigned long long name_offset;
+	unsigned long long values_offset;
+} pse_snap_column;
+
+/**
+ * Write a population (initialized or started) as a snapshot, and map a
+ * snapshot into a population in the CREATED state. The mapped population
+ * resumes in the state it was saved in, and is released by
+ * pse_pop_finalize() as usual.
+ */
+pse_error pse_pop_snapshot(pse_population *, char *);
+pse_error pse_pop_map(pse_population *, char *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
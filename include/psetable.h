@@ -0,0 +1,79 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#ifndef PSETABLE_H
+#define PSETABLE_H
+
+#include <pse.h>
+#include <psepop.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Tabulated distributions
+ *
+ * Empirical distributions that do not fit in the point parameters are given
+ * as tables. PSE_DIST_TABLE_INT variables draw from a probability table:
+ * outcome values[i] with probability proportional to weights[i], through a
+ * Walker alias table. PSE_DIST_TABLE_DOUBLE variables draw from a histogram:
+ * bin i spans [edges[i], edges[i + 1]) with probability proportional to
+ * weights[i], through a piecewise-linear inverse of its distribution function
+ * and a guide table. Both take a single uniform and constant expected time
+ * per draw, whatever the size of the table.
+ *
+ * Tables are immutable and shared. Building a table equal to one that exists
+ * returns the existing table, so agents that each build the distribution from
+ * the same data hold a single copy. Tables count their references: the
+ * constructors return one reference to the caller, supplying a table to a
+ * variable or column takes another, and each is given back with
+ * pse_table_release() or when the variable is deregistered or finalized.
+ * Tables may be built, supplied and released from any thread.
+ *
+ * Until a table is supplied, a tabulated variable keeps its value. Tables of
+ * stubs are stored in checkpoints; those of populations are not stored in
+ * snapshots and must be supplied again.
+ */
+typedef struct pse_table {
+	pse_distribution_type distribution;
+	unsigned int count;
+	double *weights;
+	int *values;
+	double *edges;
+	double *probability;
+	unsigned int *alias;
+	double *cdf;
+	unsigned int *guide;
+	unsigned long long hash;
+	unsigned int references;
+	struct pse_table *next;
+} pse_table;
+
+/**
+ * Build a table. values may be NULL for outcomes 0 to count - 1. Weights must
+ * be non-negative with a positive sum, and edges increasing; otherwise NULL is
+ * returned with PSE_ERROR_TABLE_INVALID.
+ */
+pse_table * pse_table_int(double *, int *, unsigned int, pse_error *);
+pse_table * pse_table_double(double *, double *, unsigned int, pse_error *);
+void pse_table_release(pse_table *);
+
+pse_error pse_supply_table(pse_agent_stub *, pse_varid, pse_table *);
+pse_error pse_pop_supply_table(pse_population *, pse_varid, pse_table *);
+
+int pse_table_draw_int(pse_table *);
+double pse_table_draw_double(pse_table *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,3 +1,7 @@
+# ifdef __cplusplus
+extern "C" {
+# endif
+
 char ch_cap ( char ch );
 float genbet ( float aa, float bb );
 float genchi ( float df );
@@ -36,3 +40,6 @@ int spofa ( float a[], int lda, int n );
 void stats ( float x[], int n, float *av, float *var, float *xmin, float *xmax );
 void trstat ( char *pdf, float parin[], float *av, float *var );
 
+# ifdef __cplusplus
+}
+# endif
@@ -0,0 +1,77 @@
+#ifndef RANLIB_R8_H
+# define RANLIB_R8_H
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+/*
+  Constants of the binomial sampler for one N and PP, see IGNBIN_SETUP_R8.
+*/
+typedef struct
+{
+  int n;
+  double pp;
+  double p;
+  double q;
+  double xnp;
+  double qn;
+  double r;
+  double g;
+  int m;
+  double fm;
+  double xnpq;
+  double p1;
+  double xm;
+  double xl;
+  double xr;
+  double c;
+  double xll;
+  double xlr;
+  double p2;
+  double p3;
+  double p4;
+} binomial_r8_setup;
+
+/*
+  Constants of the Poisson sampler for one mean, see IGNPOI_SETUP_R8.
+*/
+typedef struct
+{
+  double mu;
+  double emu;
+  double smu;
+  double lmu;
+  double a;
+  double b;
+  double invalpha;
+  double vr;
+} poisson_r8_setup;
+
+double genbet_r8 ( double aa, double bb );
+double genchi_r8 ( double df );
+double genexp_r8 ( double av );
+double genf_r8 ( double dfn, double dfd );
+double gengam_r8 ( double a, double r );
+double gennor_r8 ( double av, double sd );
+double genunf_r8 ( double low, double high );
+int ignbin_draw_r8 ( binomial_r8_setup *setup );
+int ignbin_r8 ( int n, double pp );
+void ignbin_setup_r8 ( int n, double pp, binomial_r8_setup *setup );
+int ignnbn_r8 ( int n, double p );
+int ignpoi_draw_r8 ( poisson_r8_setup *setup );
+int ignpoi_r8 ( double mu );
+void ignpoi_setup_r8 ( double mu, poisson_r8_setup *setup );
+double r8_factorial_log ( int k );
+double r8_uni_53 ( );
+double sexpo_r8 ( );
+double sexpo_zig_r8 ( );
+double sgamma_r8 ( double a );
+double snorm_r8 ( );
+double snorm_zig_r8 ( );
+
+# ifdef __cplusplus
+}
+# endif
+
+#endif
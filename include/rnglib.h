@@ -1,3 +1,38 @@
+# ifndef RNGLIB_H
+# define RNGLIB_H
+
+# define RNG_G_MAX 32
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+# define RNG_BACKEND_LECUYER 0
+# define RNG_BACKEND_PHILOX 1
+
+/*
+  Complete state of the 32 L'Ecuyer generators: the current generator index,
+  the antithetic flags and the initial, last and current seeds of each one.
+  When the counter-based backend is selected, only the key, the counter and
+  the cached output block are used.
+*/
+typedef struct rng_state {
+  int backend;
+  int initialized;
+  int g;
+  int a[RNG_G_MAX];
+  int cg1[RNG_G_MAX];
+  int cg2[RNG_G_MAX];
+  int ig1[RNG_G_MAX];
+  int ig2[RNG_G_MAX];
+  int lg1[RNG_G_MAX];
+  int lg2[RNG_G_MAX];
+  unsigned int key[2];
+  unsigned int ctr[4];
+  unsigned int block[4];
+  unsigned int draw;
+} rng_state;
+
 void advance_state ( int k );
 int antithetic_get ( );
 void antithetic_memory ( int i, int *value );
@@ -22,9 +57,19 @@ void lg_get ( int g, int *lg1, int *lg2 );
 void lg_memory ( int i, int g, int *lg1, int *lg2 );
 void lg_set ( int g, int lg1, int lg2 );
 int multmod ( int a, int s, int m );
+void philox4x32 ( unsigned int ctr[4], unsigned int key[2], unsigned int out[4] );
 float r4_uni_01 ( );
 double r8_uni_01 ( );
+void rng_philox_set_counter ( unsigned int c1, unsigned int c2, unsigned int c3 );
+void rng_philox_set_key ( unsigned int k0, unsigned int k1 );
+rng_state *rng_state_bind ( rng_state *state );
+rng_state *rng_state_get ( );
 void set_initial_seed ( int ig1, int ig2 );
 void set_seed ( int cg1, int cg2 );
 void timestamp ( );
 
+# ifdef __cplusplus
+}
+# endif
+
+# endif
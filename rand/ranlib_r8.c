@@ -0,0 +1,1356 @@
+# include <stdlib.h>
+# include <stdio.h>
+# include <math.h>
+
+# include "ranlib_r8.h"
+# include "rnglib.h"
+
+/*
+  Ziggurat layer boundaries (Marsaglia, Tsang; in the form of Doornik).
+
+  ZIG_NOR_X holds the 128 layers of the normal density exp(-x*x/2), with
+  R = 3.442619855899 and layer area V = 9.91256303526217E-03.  ZIG_EXP_X
+  holds the 256 layers of the exponential density exp(-x), with
+  R = 7.69711747013104972 and V = 3.949659822581572E-03.  Entry 0 is V / f(R),
+  the width of the base layer; entry 1 is R; the last entry is 0.
+*/
+static const double zig_nor_x[129] =
+{
+  3.7130862467425505, 3.4426198558990002, 3.2230849845811416,
+  3.0832288582168683, 2.9786962526477803, 2.8943440070215289,
+  2.8231253505489105, 2.7611693723871769, 2.7061135731218195,
+  2.6564064112613597, 2.6109722484318474, 2.5690336259249378,
+  2.5300096723888275, 2.4934545220953721, 2.4590181774118305,
+  2.4264206455337498, 2.3954342780110625, 2.3658713701176386,
+  2.3375752413392368, 2.310413683698763, 2.2842740596774718,
+  2.2590595738691985, 2.2346863955909795, 2.2110814088787034,
+  2.1881804320760492, 2.1659267937489219, 2.1442701823603953,
+  2.1231657086739766, 2.1025731351892385, 2.0824562379920168,
+  2.0627822745083084, 2.0435215366550676, 2.0246469733773855,
+  2.0061338699634721, 1.9879595741276199, 1.9701032608543265,
+  1.9525457295535567, 1.9352692282966228, 1.9182573008645099,
+  1.9014946531051511, 1.884967035707759, 1.8686611409944887,
+  1.8525645117280911, 1.836665460258446, 1.8209529965961255,
+  1.8054167642192285, 1.7900469825998586, 1.7748343955860695,
+  1.7597702248995934, 1.7448461281138004, 1.7300541605637305,
+  1.7153867407136676, 1.7008366185699169, 1.6863968467791681,
+  1.6720607540976009, 1.6578219209540241, 1.6436741568628686,
+  1.6296114794706347, 1.615628095043161, 1.6017183802213781,
+  1.5878768648905761, 1.5740982160230008, 1.5603772223661689,
+  1.5467087798599104, 1.5330878776740433, 1.5195095847659401,
+  1.5059690368632033, 1.492461423781354, 1.4789819769899242,
+  1.4655259573427108, 1.4520886428892246, 1.4386653166845635,
+  1.4252512545140601, 1.4118417124470577, 1.3984319141310053,
+  1.3850170377326518, 1.3715922024273426, 1.3581524543301435,
+  1.344692751753547, 1.3312079496656273, 1.3176927832094141,
+  1.3041418501286168, 1.2905495919261964, 1.2769102735601556,
+  1.2632179614546211, 1.2494664995730682, 1.2356494832633627,
+  1.2217602305399964, 1.2077917504159497, 1.1937367078331287,
+  1.1795873846639882, 1.1653356361647524, 1.1509728421488674,
+  1.1364898520131608, 1.1218769225825422, 1.107123647534036,
+  1.0922188769072774, 1.0771506248928957, 1.0619059636948243,
+  1.0464709007640454, 1.0308302360681956, 1.0149673952513305,
+  0.99886423349298359, 0.98250080351542901, 0.9658550794011499,
+  0.94890262551130644, 0.93161619661515083, 0.91396525102303228,
+  0.89591535258093769, 0.87742742911292337, 0.85845684319381321,
+  0.83895221429757738, 0.81885390670035729, 0.79809206064405691,
+  0.77658398789475991, 0.75423066445405562, 0.73091191064248884,
+  0.70647961133543646, 0.68074791866915463, 0.65347863873997525,
+  0.6243585973360507, 0.59296294247144832, 0.55869217840818519,
+  0.52065603876206057, 0.47743783729668982, 0.42654798635542351,
+  0.36287143109703196, 0.27232086481396467, 0.0
+};
+
+static const double zig_exp_x[257] =
+{
+  8.6971174701310847, 7.6971174701310501, 6.9410336293772108,
+  6.478378493832567, 6.14416466577247, 5.8821443157953963,
+  5.6664101674540301, 5.4828906275260589, 5.3230905057543945,
+  5.1814872813014965, 5.0542884899813005, 4.938777085901247,
+  4.8329397410251076, 4.7352429966017366, 4.6444918854200807,
+  4.5597370617073469, 4.4802117465284175, 4.4052876934735679,
+  4.3344436803172677, 4.2672424802773614, 4.2033137137351799,
+  4.142340865664047, 4.0840513104082934, 4.0282085446479323,
+  3.9746060666737844, 3.9230625001354853, 3.8734176703995047,
+  3.8255294185223323, 3.7792709924116634, 3.7345288940397929,
+  3.6912010902374144, 3.6491955157608493, 3.6084288131289051,
+  3.568825265648333, 3.5303158891293394, 3.4928376547740556,
+  3.4563328211327562, 3.4207483572511159, 3.386035442460297,
+  3.3521490309001054, 3.319047470970744, 3.2866921715990647,
+  3.2550473085704459, 3.2240795652862602, 3.1937579032122363,
+  3.1640533580259689, 3.134938858084436, 3.10638906233982,
+  3.0783802152540858, 3.0508900166154507, 3.0238975044556722,
+  2.9973829495161262, 2.9713277599210852, 2.9457143948950413,
+  2.9205262865127364, 2.8957477686001374, 2.8713640120155319,
+  2.8473609656351844, 2.8237253024500308, 2.8004443702507333,
+  2.7775061464397521, 2.7548991965623402, 2.7326126361946956,
+  2.7106360958679243, 2.6889596887417988, 2.6675739807732617,
+  2.6464699631518038, 2.6256390267977832, 2.6050729387408302,
+  2.5847638202141354, 2.5647041263168999, 2.5448866271118646,
+  2.5253043900378223, 2.5059507635285883, 2.4868193617402041,
+  2.4679040502973595, 2.4491989329782444, 2.4306983392644144,
+  2.4123968126888653, 2.3942890999214526, 2.3763701405361353,
+  2.358635057409332, 2.3410791477030291, 2.3236978743901906,
+  2.306486858283574, 2.2894418705322637, 2.272558825553149,
+  2.2558337743672134, 2.2392628983129033, 2.222842503111031,
+  2.2065690132576581, 2.1904389667232143, 2.1744490099377689,
+  2.1585958930438802, 2.1428764653998362, 2.1272876713173625,
+  2.1118265460190364, 2.0964902118017092, 2.0812758743932194,
+  2.0661808194905702, 2.0512024094685795, 2.0363380802487643,
+  2.0215853383189208, 2.0069417578945128, 1.9924049782135711,
+  1.9779727009573547, 1.9636426877895423, 1.9494127580071789,
+  1.9352807862970454, 1.9212447005915219, 1.9073024800183813,
+  1.8934521529393018, 1.879691795072205, 1.8660195276928215,
+  1.8524335159111693, 1.8389319670188735, 1.8255131289035134,
+  1.8121752885263842, 1.7989167704602844, 1.7857359354841194,
+  1.7726311792312988, 1.7596009308890681, 1.7466436519460677,
+  1.7337578349855649, 1.7209420025219289, 1.7081947058780513,
+  1.6955145241015315, 1.6829000629175475, 1.6703499537164457,
+  1.6578628525741663, 1.6454374393037172, 1.6330724165359849,
+  1.6207665088282515, 1.6085184617988519, 1.596327041286477,
+  1.5841910325326825, 1.5721092393862233, 1.5600804835278816,
+  1.5481036037145068, 1.5361774550410254, 1.5243009082192196,
+  1.5124728488721104, 1.5006921768428103, 1.4889578055167394,
+  1.4772686611561272, 1.4656236822457387, 1.454021818848787,
+  1.4424620319720061, 1.4309432929388732, 1.4194645827699766,
+  1.408024891569529, 1.3966232179170355, 1.3852585682631156,
+  1.3739299563284839, 1.3626364025050801, 1.3513769332583287,
+  1.3401505805294984, 1.3289563811371101, 1.3177933761763183,
+  1.3066606104151677, 1.2955571316865944, 1.284481990275006,
+  1.2734342382962345, 1.2624129290696087, 1.2514171164808459,
+  1.2404458543343997, 1.2294981956938424, 1.2185731922087835,
+  1.2076698934267542, 1.196787346088396, 1.1859245934041951,
+  1.1750806743109043, 1.1642546227056716, 1.1534454666557674,
+  1.1426522275816655, 1.1318739194110714, 1.1211095477013233,
+  1.1103581087274039, 1.0996185885325902, 1.0888899619385397,
+  1.0781711915113652, 1.0674612264799606, 1.0567590016025443,
+  1.0460634359770369, 1.0353734317905212, 1.0246878730026101,
+  1.0140056239570894, 1.0033255279156894, 0.99264640550726846,
+  0.98196705308505516, 0.97128624098389593, 0.96060271166865907,
+  0.94991517776406853, 0.93922231995525485, 0.92852278474720296,
+  0.91781518207003676, 0.90709808271568271, 0.89637001558988239,
+  0.88562946476174387, 0.87487486629101741, 0.86410460481099671,
+  0.85331700984236547, 0.8425103518103606, 0.8316828377342651,
+  0.82083260655440382, 0.80995772405741018, 0.79905617735547896,
+  0.78812586886948433, 0.77716460975912138, 0.76617011273542623,
+  0.75513998418197359, 0.74407171550049944, 0.73296267358435663,
+  0.72181009030874732, 0.71061105090964605, 0.69936248110322297,
+  0.68806113277373881, 0.67670356802951348, 0.66528614139266862,
+  0.65380497984765551, 0.64225596042452693, 0.63063468493348063,
+  0.61893645139486642, 0.60715622162029026, 0.59528858429149301,
+  0.58332771274875961, 0.57126731653257812, 0.55910058551153019,
+  0.54682012516329981, 0.53441788123715472, 0.52188505159212406,
+  0.50921198244364319, 0.49638804551865967, 0.48340149165345014,
+  0.47023927508215713, 0.45688684093140813, 0.44332786607354013,
+  0.42954394022539827, 0.4155141696003436, 0.40121467889626466,
+  0.38661797794110619, 0.37169214532990352, 0.35639976025837972,
+  0.34069648106483463, 0.32452911701689441, 0.30783295467491661,
+  0.29052795549121424, 0.27251318547844777, 0.25365836338589415,
+  0.23379048305965566, 0.21267151063094616, 0.18995868962240969,
+  0.1651276225641628, 0.13730498093998469, 0.10483850756578511,
+  0.063852163814956245, 0.0
+};
+
+# define ZIG_NOR_R 3.442619855899
+# define ZIG_EXP_R 7.69711747013104972
+
+/******************************************************************************/
+
+double genbet_r8 ( double aa, double bb )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    GENBET_R8 generates a beta random deviate in double precision.
+
+  Discussion:
+
+    The deviate is X / ( X + Y ), with X and Y independent standard gamma
+    deviates of shapes AA and BB.  When both shapes are small, X + Y may
+    underflow; the pair is drawn again in that case.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Parameters:
+
+    Input, double AA, BB, the shape parameters.  0.0 < AA, 0.0 < BB.
+
+    Output, double GENBET_R8, a random deviate from the distribution.
+*/
+{
+  double x;
+  double y;
+
+  if ( aa <= 0.0 || bb <= 0.0 )
+  {
+    fprintf ( stderr, "\n" );
+    fprintf ( stderr, "GENBET_R8 - Fatal error!\n" );
+    fprintf ( stderr, "  AA or BB <= 0.0\n" );
+    exit ( 1 );
+  }
+
+  for ( ; ; )
+  {
+    x = sgamma_r8 ( aa );
+    y = sgamma_r8 ( bb );
+
+    if ( 0.0 < x + y )
+    {
+      return x / ( x + y );
+    }
+  }
+}
+/******************************************************************************/
+
+double genchi_r8 ( double df )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    GENCHI_R8 generates a Chi-Square random deviate in double precision.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Parameters:
+
+    Input, double DF, the degrees of freedom.  0.0 < DF.
+
+    Output, double GENCHI_R8, a random deviate from the distribution.
+*/
+{
+  if ( df <= 0.0 )
+  {
+    fprintf ( stderr, "\n" );
+    fprintf ( stderr, "GENCHI_R8 - Fatal error!\n" );
+    fprintf ( stderr, "  DF <= 0.\n" );
+    exit ( 1 );
+  }
+
+  return 2.0 * sgamma_r8 ( df / 2.0 );
+}
+/******************************************************************************/
+
+double genexp_r8 ( double av )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    GENEXP_R8 generates an exponential random deviate in double precision.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Parameters:
+
+    Input, double AV, the mean of the exponential distribution.
+
+    Output, double GENEXP_R8, a random deviate from the distribution.
+*/
+{
+  return sexpo_r8 ( ) * av;
+}
+/******************************************************************************/
+
+double genf_r8 ( double dfn, double dfd )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    GENF_R8 generates an F random deviate in double precision.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Parameters:
+
+    Input, double DFN, the degrees of freedom in the numerator.  0.0 < DFN.
+
+    Input, double DFD, the degrees of freedom in the denominator.  0.0 < DFD.
+
+    Output, double GENF_R8, a random deviate from the distribution.
+*/
+{
+  double xden;
+  double xnum;
+
+  if ( dfn <= 0.0 || dfd <= 0.0 )
+  {
+    fprintf ( stderr, "\n" );
+    fprintf ( stderr, "GENF_R8 - Fatal error!\n" );
+    fprintf ( stderr, "  DFN or DFD <= 0.0\n" );
+    exit ( 1 );
+  }
+
+  xnum = genchi_r8 ( dfn ) / dfn;
+  xden = genchi_r8 ( dfd ) / dfd;
+
+  return xnum / xden;
+}
+/******************************************************************************/
+
+double gengam_r8 ( double a, double r )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    GENGAM_R8 generates a Gamma random deviate in double precision.
+
+  Discussion:
+
+    The density is ( A^R / Gamma(R) ) * X^(R-1) * Exp(-A*X), as in GENGAM.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Parameters:
+
+    Input, double A, the location (rate) parameter.
+
+    Input, double R, the shape parameter.
+
+    Output, double GENGAM_R8, a random deviate from the distribution.
+*/
+{
+  return sgamma_r8 ( r ) / a;
+}
+/******************************************************************************/
+
+double gennor_r8 ( double av, double sd )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    GENNOR_R8 generates a normal random deviate in double precision.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Parameters:
+
+    Input, double AV, the mean.
+
+    Input, double SD, the standard deviation.
+
+    Output, double GENNOR_R8, a random deviate from the distribution.
+*/
+{
+  return sd * snorm_r8 ( ) + av;
+}
+/******************************************************************************/
+
+double genunf_r8 ( double low, double high )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    GENUNF_R8 generates a uniform random deviate in double precision.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Parameters:
+
+    Input, double LOW, HIGH, the lower and upper bounds.
+
+    Output, double GENUNF_R8, a random deviate from the distribution.
+*/
+{
+  return low + ( high - low ) * r8_uni_01 ( );
+}
+/******************************************************************************/
+
+int ignbin_draw_r8 ( binomial_r8_setup *setup )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    IGNBIN_DRAW_R8 generates a binomial random deviate from a prepared setup.
+
+  Discussion:
+
+    This is algorithm BTPE of IGNBIN carried out in double precision, with
+    inversion when N * min ( PP, 1 - PP ) < 30.  Unlike IGNBIN, the
+    degenerate cases PP = 0 and PP = 1 are accepted.
+
+    The constants of both methods depend on N and PP only, and are computed
+    once by IGNBIN_SETUP_R8.  Nothing is kept between calls, so several
+    setups may be interleaved.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Author:
+
+    Original FORTRAN77 version by Barry Brown, James Lovato.
+    C version by John Burkardt.
+
+  Reference:
+
+    Voratas Kachitvichyanukul, Bruce Schmeiser,
+    Binomial Random Variate Generation,
+    Communications of the ACM,
+    Volume 31, Number 2, February 1988, pages 216-222.
+
+  Parameters:
+
+    Input, binomial_r8_setup *SETUP, the setup prepared for N and PP.
+
+    Output, int IGNBIN_DRAW_R8, a random deviate from the distribution.
+*/
+{
+  double alv;
+  double amaxp;
+  double f;
+  double f1;
+  double f2;
+  double g;
+  int i;
+  int ix;
+  int ix1;
+  int k;
+  int m;
+  int mp;
+  int n;
+  double p;
+  double q;
+  double r;
+  double t;
+  double u;
+  double v;
+  double w;
+  double w2;
+  double x;
+  double x1;
+  double x2;
+  double xnpq;
+  double ynorm;
+  double z;
+  double z2;
+
+  n = setup->n;
+
+  if ( n == 0 || setup->pp <= 0.0 )
+  {
+    return 0;
+  }
+
+  if ( 1.0 <= setup->pp )
+  {
+    return n;
+  }
+
+  p = setup->p;
+  q = setup->q;
+
+  if ( setup->xnp < 30.0 )
+  {
+    r = setup->r;
+    g = setup->g;
+
+    for ( ; ; )
+    {
+      ix = 0;
+      f = setup->qn;
+      u = r8_uni_01 ( );
+
+      for ( ; ; )
+      {
+        if ( u < f )
+        {
+          return ( 0.5 < setup->pp ) ? n - ix : ix;
+        }
+
+        if ( 110 < ix )
+        {
+          break;
+        }
+        u = u - f;
+        ix = ix + 1;
+        f = f * ( g / ( double ) ( ix ) - r );
+      }
+    }
+  }
+
+  m = setup->m;
+  xnpq = setup->xnpq;
+/*
+  Generate a variate.
+*/
+  for ( ; ; )
+  {
+    u = r8_uni_01 ( ) * setup->p4;
+    v = r8_uni_01 ( );
+/*
+  Triangle
+*/
+    if ( u < setup->p1 )
+    {
+      ix = setup->xm - setup->p1 * v + u;
+      return ( 0.5 < setup->pp ) ? n - ix : ix;
+    }
+/*
+  Parallelogram
+*/
+    if ( u <= setup->p2 )
+    {
+      x = setup->xl + ( u - setup->p1 ) / setup->c;
+      v = v * setup->c + 1.0 - fabs ( setup->xm - x ) / setup->p1;
+
+      if ( v <= 0.0 || 1.0 < v )
+      {
+        continue;
+      }
+      ix = x;
+    }
+    else if ( u <= setup->p3 )
+    {
+      ix = setup->xl + log ( v ) / setup->xll;
+      if ( ix < 0 )
+      {
+        continue;
+      }
+      v = v * ( u - setup->p2 ) * setup->xll;
+    }
+    else
+    {
+      ix = setup->xr - log ( v ) / setup->xlr;
+      if ( n < ix )
+      {
+        continue;
+      }
+      v = v * ( u - setup->p3 ) * setup->xlr;
+    }
+    k = abs ( ix - m );
+
+    if ( k <= 20 || xnpq / 2.0 - 1.0 <= k )
+    {
+      f = 1.0;
+      r = setup->r;
+      g = setup->g;
+
+      if ( m < ix )
+      {
+        mp = m + 1;
+        for ( i = mp; i <= ix; i++ )
+        {
+          f = f * ( g / i - r );
+        }
+      }
+      else if ( ix < m )
+      {
+        ix1 = ix + 1;
+        for ( i = ix1; i <= m; i++ )
+        {
+          f = f / ( g / i - r );
+        }
+      }
+
+      if ( v <= f )
+      {
+        return ( 0.5 < setup->pp ) ? n - ix : ix;
+      }
+    }
+    else
+    {
+      amaxp = ( k / xnpq ) * ( ( k * ( k / 3.0
+        + 0.625 ) + 0.1666666666666 ) / xnpq + 0.5 );
+      ynorm = - ( double ) ( k ) * ( double ) ( k ) / ( 2.0 * xnpq );
+      alv = log ( v );
+
+      if ( alv < ynorm - amaxp )
+      {
+        return ( 0.5 < setup->pp ) ? n - ix : ix;
+      }
+
+      if ( ynorm + amaxp < alv )
+      {
+        continue;
+      }
+
+      x1 = ( double ) ( ix + 1 );
+      f1 = setup->fm + 1.0;
+      z = ( double ) ( n + 1 ) - setup->fm;
+      w = ( double ) ( n - ix + 1 );
+      z2 = z * z;
+      x2 = x1 * x1;
+      f2 = f1 * f1;
+      w2 = w * w;
+
+      t = setup->xm * log ( f1 / x1 ) + ( n - m + 0.5 ) * log ( z / w )
+        + ( double ) ( ix - m ) * log ( w * p / ( x1 * q ))
+        + ( 13860.0 - ( 462.0 - ( 132.0 - ( 99.0 - 140.0
+        / f2 ) / f2 ) / f2 ) / f2 ) / f1 / 166320.0
+        + ( 13860.0 - ( 462.0 - ( 132.0 - ( 99.0 - 140.0
+        / z2 ) / z2 ) / z2 ) / z2 ) / z / 166320.0
+        + ( 13860.0 - ( 462.0 - ( 132.0 - ( 99.0 - 140.0
+        / x2 ) / x2 ) / x2 ) / x2 ) / x1 / 166320.0
+        + ( 13860.0 - ( 462.0 - ( 132.0 - ( 99.0 - 140.0
+        / w2 ) / w2 ) / w2 ) / w2 ) / w / 166320.0;
+
+      if ( alv <= t )
+      {
+        return ( 0.5 < setup->pp ) ? n - ix : ix;
+      }
+    }
+  }
+}
+/******************************************************************************/
+
+int ignbin_r8 ( int n, double pp )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    IGNBIN_R8 generates a binomial random deviate in double precision.
+
+  Discussion:
+
+    The setup is computed on every call.  Callers sampling repeatedly with
+    the same N and PP should keep a setup from IGNBIN_SETUP_R8 and call
+    IGNBIN_DRAW_R8 instead.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Parameters:
+
+    Input, int N, the number of binomial trials.  0 <= N.
+
+    Input, double PP, the probability of an event in each trial.
+
+    Output, int IGNBIN_R8, a random deviate from the distribution.
+*/
+{
+  binomial_r8_setup setup;
+
+  ignbin_setup_r8 ( n, pp, &setup );
+
+  return ignbin_draw_r8 ( &setup );
+}
+/******************************************************************************/
+
+void ignbin_setup_r8 ( int n, double pp, binomial_r8_setup *setup )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    IGNBIN_SETUP_R8 computes the constants of the binomial sampler.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Parameters:
+
+    Input, int N, the number of binomial trials.  0 <= N.
+
+    Input, double PP, the probability of an event in each trial.
+
+    Output, binomial_r8_setup *SETUP, the constants used by IGNBIN_DRAW_R8.
+*/
+{
+  double al;
+  double ffm;
+  double p;
+  double q;
+
+  if ( n < 0 )
+  {
+    fprintf ( stderr, "\n" );
+    fprintf ( stderr, "IGNBIN_SETUP_R8 - Fatal error!\n" );
+    fprintf ( stderr, "  N < 0.\n" );
+    exit ( 1 );
+  }
+
+  setup->n = n;
+  setup->pp = pp;
+
+  if ( n == 0 || pp <= 0.0 || 1.0 <= pp )
+  {
+    return;
+  }
+
+  p = ( pp < 1.0 - pp ) ? pp : 1.0 - pp;
+  q = 1.0 - p;
+  setup->p = p;
+  setup->q = q;
+  setup->xnp = ( double ) ( n ) * p;
+  setup->r = p / q;
+  setup->g = setup->r * ( double ) ( n + 1 );
+
+  if ( setup->xnp < 30.0 )
+  {
+    setup->qn = pow ( q, n );
+    return;
+  }
+
+  ffm = setup->xnp + p;
+  setup->m = ffm;
+  setup->fm = setup->m;
+  setup->xnpq = setup->xnp * q;
+  setup->p1 = ( int ) ( 2.195 * sqrt ( setup->xnpq ) - 4.6 * q ) + 0.5;
+  setup->xm = setup->fm + 0.5;
+  setup->xl = setup->xm - setup->p1;
+  setup->xr = setup->xm + setup->p1;
+  setup->c = 0.134 + 20.5 / ( 15.3 + setup->fm );
+  al = ( ffm - setup->xl ) / ( ffm - setup->xl * p );
+  setup->xll = al * ( 1.0 + 0.5 * al );
+  al = ( setup->xr - ffm ) / ( setup->xr * q );
+  setup->xlr = al * ( 1.0 + 0.5 * al );
+  setup->p2 = setup->p1 * ( 1.0 + setup->c + setup->c );
+  setup->p3 = setup->p2 + setup->c / setup->xll;
+  setup->p4 = setup->p3 + setup->c / setup->xlr;
+
+  return;
+}
+/******************************************************************************/
+
+int ignnbn_r8 ( int n, double p )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    IGNNBN_R8 generates a negative binomial random deviate in double precision.
+
+  Discussion:
+
+    As in IGNNBN, the deviate is a Poisson deviate whose mean is itself a
+    Gamma deviate.  N = 0 yields 0.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Reference:
+
+    Luc Devroye,
+    Non-Uniform Random Variate Generation,
+    Springer, 1986,
+    ISBN: 0387963057,
+    LC: QA274.D48.
+
+  Parameters:
+
+    Input, int N, the required number of events.  0 <= N.
+
+    Input, double P, the probability of an event during a Bernoulli trial.
+    0.0 < P < 1.0.
+
+    Output, int IGNNBN_R8, a random deviate from the distribution.
+*/
+{
+  double y;
+
+  if ( n < 0 )
+  {
+    fprintf ( stderr, "\n" );
+    fprintf ( stderr, "IGNNBN_R8 - Fatal error!\n" );
+    fprintf ( stderr, "  N < 0.\n" );
+    exit ( 1 );
+  }
+
+  if ( p <= 0.0 || 1.0 <= p )
+  {
+    fprintf ( stderr, "\n" );
+    fprintf ( stderr, "IGNNBN_R8 - Fatal error!\n" );
+    fprintf ( stderr, "  P is out of range.\n" );
+    exit ( 1 );
+  }
+
+  if ( n == 0 )
+  {
+    return 0;
+  }
+
+  y = gengam_r8 ( p / ( 1.0 - p ), ( double ) n );
+
+  return ignpoi_r8 ( y );
+}
+/******************************************************************************/
+
+int ignpoi_draw_r8 ( poisson_r8_setup *setup )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    IGNPOI_DRAW_R8 generates a Poisson random deviate from a prepared setup.
+
+  Discussion:
+
+    For MU < 10, the deviate is obtained by inversion (sequential search
+    from 0).  Otherwise, the transformed rejection method with squeeze
+    (PTRS) of Hoermann is used; it needs two uniforms per trial and accepts
+    about 90 percent of the time for all MU.  The final acceptance test
+    uses R8_FACTORIAL_LOG rather than LGAMMA, which writes the global
+    SIGNGAM and so races when deviates are drawn from several threads.
+
+    The constants of both methods depend on MU only, and are computed once
+    by IGNPOI_SETUP_R8.  A setup may be used for any number of draws, and
+    nothing is kept between calls, so several setups may be interleaved.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Reference:
+
+    Wolfgang Hoermann,
+    The transformed rejection method for generating Poisson random variables,
+    Insurance: Mathematics and Economics,
+    Volume 12, Number 1, February 1993, pages 39-45.
+
+  Parameters:
+
+    Input, poisson_r8_setup *SETUP, the setup prepared for the mean.
+
+    Output, int IGNPOI_DRAW_R8, a random deviate from the distribution.
+*/
+{
+  int k;
+  double p;
+  double s;
+  double u;
+  double us;
+  double v;
+
+  if ( setup->mu <= 0.0 )
+  {
+    return 0;
+  }
+
+  if ( setup->mu < 10.0 )
+  {
+    p = setup->emu;
+    s = p;
+    u = r8_uni_01 ( );
+    k = 0;
+
+    while ( s < u && k < 1000 )
+    {
+      k = k + 1;
+      p = p * setup->mu / ( double ) k;
+      s = s + p;
+    }
+    return k;
+  }
+
+  for ( ; ; )
+  {
+    u = r8_uni_01 ( ) - 0.5;
+    v = r8_uni_01 ( );
+    us = 0.5 - fabs ( u );
+    k = ( int ) floor ( ( 2.0 * setup->a / us + setup->b ) * u + setup->mu + 0.43 );
+
+    if ( 0.07 <= us && v <= setup->vr )
+    {
+      return k;
+    }
+
+    if ( k < 0 || ( us < 0.013 && us < v ) )
+    {
+      continue;
+    }
+
+    if ( log ( v * setup->invalpha / ( setup->a / ( us * us ) + setup->b ) )
+      <= - setup->mu + ( double ) k * setup->lmu - r8_factorial_log ( k ) )
+    {
+      return k;
+    }
+  }
+}
+/******************************************************************************/
+
+int ignpoi_r8 ( double mu )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    IGNPOI_R8 generates a Poisson random deviate in double precision.
+
+  Discussion:
+
+    The setup is computed on every call.  Callers sampling repeatedly with
+    the same mean should keep a setup from IGNPOI_SETUP_R8 and call
+    IGNPOI_DRAW_R8 instead.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Parameters:
+
+    Input, double MU, the mean of the Poisson distribution.
+
+    Output, int IGNPOI_R8, a random deviate from the distribution.
+*/
+{
+  poisson_r8_setup setup;
+
+  ignpoi_setup_r8 ( mu, &setup );
+
+  return ignpoi_draw_r8 ( &setup );
+}
+/******************************************************************************/
+
+void ignpoi_setup_r8 ( double mu, poisson_r8_setup *setup )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    IGNPOI_SETUP_R8 computes the constants of the Poisson sampler for a mean.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Parameters:
+
+    Input, double MU, the mean of the Poisson distribution.
+
+    Output, poisson_r8_setup *SETUP, the constants used by IGNPOI_DRAW_R8.
+*/
+{
+  setup->mu = mu;
+  setup->emu = 0.0;
+  setup->smu = 0.0;
+  setup->lmu = 0.0;
+  setup->a = 0.0;
+  setup->b = 0.0;
+  setup->invalpha = 0.0;
+  setup->vr = 0.0;
+
+  if ( mu <= 0.0 )
+  {
+    return;
+  }
+
+  if ( mu < 10.0 )
+  {
+    setup->emu = exp ( - mu );
+    return;
+  }
+
+  setup->smu = sqrt ( mu );
+  setup->lmu = log ( mu );
+  setup->b = 0.931 + 2.53 * setup->smu;
+  setup->a = -0.059 + 0.02483 * setup->b;
+  setup->invalpha = 1.1239 + 1.1328 / ( setup->b - 3.4 );
+  setup->vr = 0.9277 - 3.6224 / ( setup->b - 2.0 );
+
+  return;
+}
+/******************************************************************************/
+
+double r8_factorial_log ( int k )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    R8_FACTORIAL_LOG returns the logarithm of K factorial.
+
+  Discussion:
+
+    Values for K < 10 are tabulated.  Larger values use the Stirling series
+    of log Gamma ( K + 1 ) up to the 1/X^5 term, whose error is below 1.0E-11
+    there.  Unlike LGAMMA, nothing global is written, so the routine may be
+    called from several threads.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Reference:
+
+    Wolfgang Hoermann,
+    The transformed rejection method for generating Poisson random variables,
+    Insurance: Mathematics and Economics,
+    Volume 12, Number 1, February 1993, pages 39-45.
+
+  Parameters:
+
+    Input, int K, the argument, which should be nonnegative.
+
+    Output, double R8_FACTORIAL_LOG, the value of log ( K! ).
+*/
+{
+  static const double table[10] = {
+    0.0,
+    0.0,
+    0.69314718055994530942,
+    1.79175946922805500081,
+    3.17805383034794561965,
+    4.78749174278204599425,
+    6.57925121201010099506,
+    8.52516136106541430017,
+    10.60460290274525022842,
+    12.80182748008146961121 };
+  double x;
+  double x2;
+
+  if ( k < 10 )
+  {
+    return table[k];
+  }
+
+  x = ( double ) k + 1.0;
+  x2 = x * x;
+
+  return ( x - 0.5 ) * log ( x ) - x + 0.91893853320467274178
+    + ( 1.0 / 12.0 - ( 1.0 / 360.0 - 1.0 / ( 1260.0 * x2 ) ) / x2 ) / x;
+}
+/******************************************************************************/
+
+double r8_uni_53 ( )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    R8_UNI_53 returns a uniform deviate in (0,1) with full double resolution.
+
+  Discussion:
+
+    Two draws K1, K2 of the current generator, each uniform on 1..M1-1, are
+    combined in base M1-1.  The result is uniform on a grid of (M1-1)^2
+    (about 2^62) points, which rounds to a 53-bit mantissa.  It is used where
+    the extreme tails of a distribution matter.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Parameters:
+
+    Output, double R8_UNI_53, the uniform random value.
+*/
+{
+  const double m = 2147483562.0;
+  double k1;
+  double k2;
+
+  k1 = ( double ) ( i4_uni ( ) - 1 );
+  k2 = ( double ) ( i4_uni ( ) - 1 );
+
+  return ( k1 + ( k2 + 0.5 ) / m ) / m;
+}
+/******************************************************************************/
+
+double sexpo_r8 ( )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    SEXPO_R8 samples the standard exponential distribution in double precision.
+
+  Discussion:
+
+    Inversion of a 53-bit uniform, so the largest deviate is about 37.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Parameters:
+
+    Output, double SEXPO_R8, a random deviate from the standard
+    exponential distribution.
+*/
+{
+  return - log ( r8_uni_53 ( ) );
+}
+/******************************************************************************/
+
+double sexpo_zig_r8 ( )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    SEXPO_ZIG_R8 samples the standard exponential distribution by Ziggurat.
+
+  Discussion:
+
+    One generator draw supplies both the layer (its low 8 bits) and the
+    abscissa (its upper 23 bits).  About 98.9 percent of the draws return
+    after one comparison; the rest evaluate the density on the wedge or
+    sample the tail beyond R by inversion.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Reference:
+
+    George Marsaglia, Wai Wan Tsang,
+    The Ziggurat Method for Generating Random Variables,
+    Journal of Statistical Software,
+    Volume 5, Number 8, October 2000.
+
+    Jurgen Doornik,
+    An Improved Ziggurat Method to Generate Normal Random Samples,
+    University of Oxford, 2005.
+
+  Parameters:
+
+    Output, double SEXPO_ZIG_R8, a random deviate from the standard
+    exponential distribution.
+*/
+{
+  double f0;
+  double f1;
+  int i;
+  int j;
+  double x;
+
+  for ( ; ; )
+  {
+    j = i4_uni ( );
+    i = j & 255;
+    x = ( ( double ) ( j >> 8 ) + 0.5 ) / 8388608.0 * zig_exp_x[i];
+
+    if ( x < zig_exp_x[i+1] )
+    {
+      return x;
+    }
+
+    if ( i == 0 )
+    {
+      return ZIG_EXP_R - log ( r8_uni_53 ( ) );
+    }
+
+    f0 = exp ( x - zig_exp_x[i] );
+    f1 = exp ( x - zig_exp_x[i+1] );
+
+    if ( f1 + r8_uni_01 ( ) * ( f0 - f1 ) < 1.0 )
+    {
+      return x;
+    }
+  }
+}
+/******************************************************************************/
+
+double sgamma_r8 ( double a )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    SGAMMA_R8 samples the standard Gamma distribution in double precision.
+
+  Discussion:
+
+    For 1 <= A, the squeeze method of Marsaglia and Tsang is used.  For
+    A < 1, a deviate of shape A + 1 is scaled by U^(1/A).
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Reference:
+
+    George Marsaglia, Wai Wan Tsang,
+    A Simple Method for Generating Gamma Variables,
+    ACM Transactions on Mathematical Software,
+    Volume 26, Number 3, September 2000, pages 363-372.
+
+  Parameters:
+
+    Input, double A, the parameter of the standard gamma distribution.
+    0.0 < A.
+
+    Output, double SGAMMA_R8, a random deviate from the distribution.
+*/
+{
+  double c;
+  double d;
+  double u;
+  double v;
+  double x;
+
+  if ( a <= 0.0 )
+  {
+    fprintf ( stderr, "\n" );
+    fprintf ( stderr, "SGAMMA_R8 - Fatal error!\n" );
+    fprintf ( stderr, "  A <= 0.\n" );
+    exit ( 1 );
+  }
+
+  if ( a < 1.0 )
+  {
+    return sgamma_r8 ( a + 1.0 ) * pow ( r8_uni_53 ( ), 1.0 / a );
+  }
+
+  d = a - 1.0 / 3.0;
+  c = 1.0 / sqrt ( 9.0 * d );
+
+  for ( ; ; )
+  {
+    do
+    {
+      x = snorm_r8 ( );
+      v = 1.0 + c * x;
+    } while ( v <= 0.0 );
+
+    v = v * v * v;
+    u = r8_uni_01 ( );
+
+    if ( u < 1.0 - 0.0331 * x * x * x * x )
+    {
+      return d * v;
+    }
+
+    if ( log ( u ) < 0.5 * x * x + d * ( 1.0 - v + log ( v ) ) )
+    {
+      return d * v;
+    }
+  }
+}
+/******************************************************************************/
+
+double snorm_r8 ( )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    SNORM_R8 samples the standard normal distribution in double precision.
+
+  Discussion:
+
+    Marsaglia's polar method.  Only one of the two deviates of a pair is
+    returned, so that no value is carried between calls and the deviate
+    depends only on the current position of the generator.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Reference:
+
+    George Marsaglia, Thomas Bray,
+    A Convenient Method for Generating Normal Variables,
+    SIAM Review,
+    Volume 6, Number 3, July 1964, pages 260-264.
+
+  Parameters:
+
+    Output, double SNORM_R8, a random deviate from the distribution.
+*/
+{
+  double s;
+  double v1;
+  double v2;
+
+  do
+  {
+    v1 = 2.0 * r8_uni_01 ( ) - 1.0;
+    v2 = 2.0 * r8_uni_01 ( ) - 1.0;
+    s = v1 * v1 + v2 * v2;
+  } while ( 1.0 <= s || s == 0.0 );
+
+  return v1 * sqrt ( - 2.0 * log ( s ) / s );
+}
+/******************************************************************************/
+
+double snorm_zig_r8 ( )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    SNORM_ZIG_R8 samples the standard normal distribution by Ziggurat.
+
+  Discussion:
+
+    One generator draw supplies both the layer (its low 7 bits) and a signed
+    abscissa (its upper 24 bits).  About 98.8 percent of the draws return
+    after one comparison; the rest evaluate the density on the wedge or
+    sample the tail beyond R with Marsaglia's method.
+
+  Licensing:
+
+    This code is distributed under the GNU LGPL license.
+
+  Reference:
+
+    George Marsaglia, Wai Wan Tsang,
+    The Ziggurat Method for Generating Random Variables,
+    Journal of Statistical Software,
+    Volume 5, Number 8, October 2000.
+
+    Jurgen Doornik,
+    An Improved Ziggurat Method to Generate Normal Random Samples,
+    University of Oxford, 2005.
+
+  Parameters:
+
+    Output, double SNORM_ZIG_R8, a random deviate from the distribution.
+*/
+{
+  double f0;
+  double f1;
+  int i;
+  int j;
+  double u;
+  double x;
+  double y;
+
+  for ( ; ; )
+  {
+    j = i4_uni ( );
+    i = j & 127;
+    u = ( ( double ) ( j >> 7 ) + 0.5 ) / 8388608.0 - 1.0;
+    x = u * zig_nor_x[i];
+
+    if ( fabs ( x ) < zig_nor_x[i+1] )
+    {
+      return x;
+    }
+
+    if ( i == 0 )
+    {
+      do
+      {
+        x = log ( r8_uni_53 ( ) ) / ZIG_NOR_R;
+        y = log ( r8_uni_53 ( ) );
+      } while ( - 2.0 * y < x * x );
+
+      return ( u < 0.0 ) ? x - ZIG_NOR_R : ZIG_NOR_R - x;
+    }
+
+    f0 = exp ( - 0.5 * ( zig_nor_x[i] * zig_nor_x[i] - x * x ) );
+    f1 = exp ( - 0.5 * ( zig_nor_x[i+1] * zig_nor_x[i+1] - x * x ) );
+
+    if ( f1 + r8_uni_01 ( ) * ( f0 - f1 ) < 1.0 )
+    {
+      return x;
+    }
+  }
+}
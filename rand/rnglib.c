@@ -4,6 +4,15 @@
 
 # include "rnglib.h"
 
+/*
+  The generator tables used to live in static arrays inside the *_MEMORY
+  functions. They are now kept in an RNG_STATE structure so that callers can
+  own one per stream. The default state keeps the original single-table
+  behavior; a thread may bind its own state with RNG_STATE_BIND.
+*/
+static rng_state rng_default_state;
+static __thread rng_state *rng_bound_state = NULL;
+
 /******************************************************************************/
 
 void advance_state ( int k )
@@ -165,7 +174,7 @@ void antithetic_memory ( int i, int *value )
 {
 # define G_MAX 32
 
-  static int a_save[G_MAX];
+  int *a_save = rng_state_get ( )->a;
   int g;
   const int g_max = 32;
   int j;
@@ -302,8 +311,8 @@ void cg_memory ( int i, int g, int *cg1, int *cg2 )
 {
 # define G_MAX 32
 
-  static int cg1_save[G_MAX];
-  static int cg2_save[G_MAX];
+  int *cg1_save = rng_state_get ( )->cg1;
+  int *cg2_save = rng_state_get ( )->cg2;
   const int g_max = 32;
   int j;
 
@@ -444,17 +453,17 @@ void cgn_memory ( int i, int *g )
 {
 # define G_MAX 32
 
-  static int g_save = 0;
+  int *g_save = &rng_state_get ( )->g;
   const int g_max = 32;
 
   if ( i < 0 )
   {
-    *g = g_save;
+    *g = *g_save;
   }
   else if ( i == 0 )
   {
-    g_save = 0;
-    *g = g_save;
+    *g_save = 0;
+    *g = *g_save;
   }
   else if ( 0 < i )
   {
@@ -467,7 +476,7 @@ void cgn_memory ( int i, int *g )
       exit ( 1 );
     }
 
-    g_save = *g;
+    *g_save = *g;
   }
 
   return;
@@ -583,6 +592,10 @@ int i4_uni ( )
     The original name of this function was "random()", but this conflicts
     with a standard library function name in C.
 
+    If the bound state has been switched to the counter-based backend by
+    RNG_PHILOX_SET_KEY, the value is taken from the Philox block at the
+    current counter position instead, and no generator table is touched.
+
   Licensing:
 
     This code is distributed under the GNU LGPL license.
@@ -616,8 +629,30 @@ int i4_uni ( )
   int k;
   const int m1 = 2147483563;
   const int m2 = 2147483399;
+  rng_state *state;
   int value;
   int z;
+/*
+  Counter-based backend: one Philox block yields four draws.
+*/
+  state = rng_state_get ( );
+
+  if ( state->backend == RNG_BACKEND_PHILOX )
+  {
+    if ( ( state->draw % 4 ) == 0 )
+    {
+      state->ctr[0] = state->draw / 4;
+      philox4x32 ( state->ctr, state->key, state->block );
+    }
+    z = 1 + ( int ) ( ( state->block[state->draw % 4] >> 1 ) % ( m1 - 1 ) );
+    state->draw = state->draw + 1;
+
+    if ( state->a[state->g] )
+    {
+      z = m1 - z;
+    }
+    return z;
+  }
 /*
   Check whether the package must be initialized.
 */
@@ -756,8 +791,8 @@ void ig_memory ( int i, int g, int *ig1, int *ig2 )
 # define G_MAX 32
 
   const int g_max = 32;
-  static int ig1_save[G_MAX];
-  static int ig2_save[G_MAX];
+  int *ig1_save = rng_state_get ( )->ig1;
+  int *ig2_save = rng_state_get ( )->ig2;
   int j;
 
   if ( g < 0 || g_max <= g )
@@ -1071,19 +1106,19 @@ void initialized_memory ( int i, int *initialized )
     this is ignored.
 */
 {
-  static int initialized_save = 0;
+  int *initialized_save = &rng_state_get ( )->initialized;
 
   if ( i < 0 )
   {
-    *initialized = initialized_save;
+    *initialized = *initialized_save;
   }
   else if ( i == 0 )
   {
-    initialized_save = 0;
+    *initialized_save = 0;
   }
   else if ( 0 < i )
   {
-    initialized_save = *initialized;
+    *initialized_save = *initialized;
   }
 
   return;
@@ -1204,8 +1239,8 @@ void lg_memory ( int i, int g, int *lg1, int *lg2 )
   const int g_max = 32;
 
   int j;
-  static int lg1_save[G_MAX];
-  static int lg2_save[G_MAX];
+  int *lg1_save = rng_state_get ( )->lg1;
+  int *lg2_save = rng_state_get ( )->lg2;
 
   if ( g < 0 || g_max <= g )
   {
@@ -1436,6 +1471,83 @@ int multmod ( int a, int s, int m )
 }
 /******************************************************************************/
 
+void philox4x32 ( unsigned int ctr[4], unsigned int key[2], unsigned int out[4] )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    PHILOX4X32 computes one block of the Philox-4x32-10 counter-based generator.
+
+  Discussion:
+
+    The output is a pure function of the 128 bit counter and the 64 bit key,
+    so any block of any stream can be computed independently of all others.
+
+  Reference:
+
+    John Salmon, Mark Moraes, Ron Dror, David Shaw,
+    Parallel Random Numbers: As Easy as 1, 2, 3,
+    Proceedings of SC11, November 2011.
+
+  Parameters:
+
+    Input, unsigned int CTR[4], the counter.
+
+    Input, unsigned int KEY[2], the key.
+
+    Output, unsigned int OUT[4], the four random words of the block.
+*/
+{
+  const unsigned int m0 = 0xD2511F53u;
+  const unsigned int m1 = 0xCD9E8D57u;
+  const unsigned int w0 = 0x9E3779B9u;
+  const unsigned int w1 = 0xBB67AE85u;
+  unsigned int c[4];
+  unsigned int hi0;
+  unsigned int hi1;
+  int i;
+  unsigned int k0;
+  unsigned int k1;
+  unsigned int lo0;
+  unsigned int lo1;
+  unsigned long long p0;
+  unsigned long long p1;
+
+  c[0] = ctr[0];
+  c[1] = ctr[1];
+  c[2] = ctr[2];
+  c[3] = ctr[3];
+  k0 = key[0];
+  k1 = key[1];
+
+  for ( i = 0; i < 10; i++ )
+  {
+    p0 = ( unsigned long long ) m0 * c[0];
+    p1 = ( unsigned long long ) m1 * c[2];
+    hi0 = ( unsigned int ) ( p0 >> 32 );
+    lo0 = ( unsigned int ) p0;
+    hi1 = ( unsigned int ) ( p1 >> 32 );
+    lo1 = ( unsigned int ) p1;
+
+    c[0] = hi1 ^ c[1] ^ k0;
+    c[1] = lo1;
+    c[2] = hi0 ^ c[3] ^ k1;
+    c[3] = lo0;
+
+    k0 = k0 + w0;
+    k1 = k1 + w1;
+  }
+
+  out[0] = c[0];
+  out[1] = c[1];
+  out[2] = c[2];
+  out[3] = c[3];
+
+  return;
+}
+/******************************************************************************/
+
 float r4_uni_01 ( )
 
 /******************************************************************************/
@@ -1564,6 +1676,127 @@ double r8_uni_01 ( )
 }
 /******************************************************************************/
 
+void rng_philox_set_counter ( unsigned int c1, unsigned int c2, unsigned int c3 )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    RNG_PHILOX_SET_COUNTER positions the counter-based stream of the bound state.
+
+  Discussion:
+
+    The three words select an independent stream, typically a variable
+    identifier and a 64 bit step number.  The first counter word enumerates
+    the blocks drawn inside that stream and is reset to zero.
+
+  Parameters:
+
+    Input, unsigned int C1, C2, C3, the stream coordinates.
+*/
+{
+  rng_state *state;
+
+  state = rng_state_get ( );
+  state->ctr[1] = c1;
+  state->ctr[2] = c2;
+  state->ctr[3] = c3;
+  state->draw = 0;
+
+  return;
+}
+/******************************************************************************/
+
+void rng_philox_set_key ( unsigned int k0, unsigned int k1 )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    RNG_PHILOX_SET_KEY switches the bound state to the counter-based backend.
+
+  Discussion:
+
+    From this point on, I4_UNI (and therefore every RANLIB sampler) draws
+    from PHILOX4X32 with the given key, and the L'Ecuyer tables of the state
+    are ignored.  The counter starts at zero.
+
+  Parameters:
+
+    Input, unsigned int K0, K1, the key, typically a seed and an agent
+    identifier.
+*/
+{
+  rng_state *state;
+
+  state = rng_state_get ( );
+  state->backend = RNG_BACKEND_PHILOX;
+  state->key[0] = k0;
+  state->key[1] = k1;
+  rng_philox_set_counter ( 0, 0, 0 );
+
+  return;
+}
+/******************************************************************************/
+
+rng_state *rng_state_bind ( rng_state *state )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    RNG_STATE_BIND selects the generator tables used by the calling thread.
+
+  Discussion:
+
+    Every function in this library reads and writes the generator tables
+    through RNG_STATE_GET.  Binding a state redirects all of them, including
+    the samplers in RANLIB, to that state until another one is bound.
+    Passing NULL restores the process-wide default tables.
+
+    The binding is private to the calling thread, so distinct threads may
+    draw from distinct states without any locking.
+
+  Parameters:
+
+    Input, rng_state *STATE, the state to bind, or NULL.
+
+    Output, rng_state *RNG_STATE_BIND, the previously bound state, or NULL
+    if the default tables were in use.
+*/
+{
+  rng_state *previous;
+
+  previous = rng_bound_state;
+  rng_bound_state = state;
+
+  return previous;
+}
+/******************************************************************************/
+
+rng_state *rng_state_get ( )
+
+/******************************************************************************/
+/*
+  Purpose:
+
+    RNG_STATE_GET returns the generator tables in use by the calling thread.
+
+  Parameters:
+
+    Output, rng_state *RNG_STATE_GET, the bound state, or the process-wide
+    default state if none is bound.
+*/
+{
+  if ( rng_bound_state == NULL )
+  {
+    return &rng_default_state;
+  }
+
+  return rng_bound_state;
+}
+/******************************************************************************/
+
 void set_initial_seed ( int ig1, int ig2 )
 
 /******************************************************************************/
@@ -0,0 +1,363 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pse.h>
+#include <psecustom.h>
+#include <psetable.h>
+
+#define BENCH_SAMPLES		200000
+#define BENCH_ARRAY_SIZE	64
+#define BENCH_BATCH			1024
+#define BENCH_SEED_1		1234
+#define BENCH_SEED_2		5678
+#define BENCH_TABLE_SIZE	8
+#define BENCH_ERROR_SIZE	256
+
+/*
+ * Purpose of the benchmark:
+ * -------------------------
+ *
+ * Measure the cost of one observation for every distribution handled by the
+ * PSE samplers, for scalar and array variables, with read_and_alter off and
+ * on, through single observations and through pse_observe_batch(). Results
+ * are written as JSON so that versions can be compared.
+ *
+ * Usage: 02-benchmark-pse [samples] [output.json]
+ *
+ * All variables live in a single stub started once. With read_and_alter on,
+ * SELF distributions would otherwise feed on their own output and drift to
+ * degenerate values, so their content is restored before every observation;
+ * the restore is a plain store and is included in the timing. Batches are
+ * only measured with read_and_alter off for the same reason.
+ *
+ * CUSTOM variables are given a uniform random walk as sampler, and tabulated
+ * variables a table of BENCH_TABLE_SIZE outcomes (or bins). Any error aborts
+ * the benchmark, as its timings would not measure sampling.
+ */
+typedef struct bench_case {
+	char *name;
+	pse_distribution_type distribution;
+	pse_storage_type storage;
+	double parameters[PSE_MAX_DIST_PARAMS];
+	double initial;
+	unsigned int self;
+} bench_case;
+
+static bench_case cases[] = {
+	{"UNIFORM_INT_SELF", PSE_DIST_UNIFORM_INT_SELF, PSE_VAR_INT, {0}, 100, 1},
+	{"UNIFORM_INT_BOUNDED", PSE_DIST_UNIFORM_INT_BOUNDED, PSE_VAR_INT, {0, 100}, 0, 0},
+	{"BERNOULLI", PSE_DIST_BERNOULLI, PSE_VAR_INT, {0.3}, 0, 0},
+	{"BINOMIAL", PSE_DIST_BINOMIAL, PSE_VAR_INT, {50, 0.3}, 0, 0},
+	{"BINOMIAL_SELF", PSE_DIST_BINOMIAL_SELF, PSE_VAR_INT, {0.3}, 50, 1},
+	{"NEG_BINOMIAL", PSE_DIST_NEG_BINOMIAL, PSE_VAR_INT, {0.4, 10}, 0, 0},
+	{"NEG_BINOMIAL_SELF", PSE_DIST_NEG_BINOMIAL_SELF, PSE_VAR_INT, {0.4}, 10, 1},
+	{"POISSON", PSE_DIST_POISSON, PSE_VAR_INT, {4.0}, 0, 0},
+	{"POISSON_SELF", PSE_DIST_POISSON_SELF, PSE_VAR_INT, {0}, 4, 1},
+	{"NONE", PSE_DIST_NONE, PSE_VAR_INT, {0}, 7, 0},
+	{"UNIFORM_DOUBLE_SELF", PSE_DIST_UNIFORM_DOUBLE_SELF, PSE_VAR_DOUBLE, {0}, 10.0, 1},
+	{"UNIFORM_DOUBLE_BOUNDED", PSE_DIST_UNIFORM_DOUBLE_BOUNDED, PSE_VAR_DOUBLE, {-1.0, 1.0}, 0, 0},
+	{"NORMAL", PSE_DIST_NORMAL, PSE_VAR_DOUBLE, {0.0, 1.0}, 0, 0},
+	{"NORMAL_SELF", PSE_DIST_NORMAL_SELF, PSE_VAR_DOUBLE, {1.0}, 0.0, 1},
+	{"EXPONENTIAL", PSE_DIST_EXPONENTIAL, PSE_VAR_DOUBLE, {2.0}, 0, 0},
+	{"EXPONENTIAL_SELF", PSE_DIST_EXPONENTIAL_SELF, PSE_VAR_DOUBLE, {0}, 2.0, 1},
+	{"GAMMA", PSE_DIST_GAMMA, PSE_VAR_DOUBLE, {1.0, 2.0}, 0, 0},
+	{"GAMMA_SELF", PSE_DIST_GAMMA_SELF, PSE_VAR_DOUBLE, {0, 2.0}, 2.0, 1},
+	{"CHISQ", PSE_DIST_CHISQ, PSE_VAR_DOUBLE, {3.0}, 0, 0},
+	{"CHISQ_SELF", PSE_DIST_CHISQ_SELF, PSE_VAR_DOUBLE, {0}, 3.0, 1},
+	{"F", PSE_DIST_F, PSE_VAR_DOUBLE, {5.0, 10.0}, 0, 0},
+	{"BETA", PSE_DIST_BETA, PSE_VAR_DOUBLE, {2.0, 3.0}, 0, 0},
+	{"FOKKER_PLANCK", PSE_DIST_FOKKER_PLANCK, PSE_VAR_DOUBLE, {0, -0.5, 0.3, 0, 0.01}, 1.0, 1},
+	{"CUSTOM", PSE_DIST_CUSTOM, PSE_VAR_INT, {4.0}, 10, 1},
+	{"CUSTOM", PSE_DIST_CUSTOM, PSE_VAR_DOUBLE, {1.0}, 1.0, 1},
+	{"TABLE_INT", PSE_DIST_TABLE_INT, PSE_VAR_INT, {0}, 0, 0},
+	{"TABLE_DOUBLE", PSE_DIST_TABLE_DOUBLE, PSE_VAR_DOUBLE, {0}, 0, 0},
+	{"NONE", PSE_DIST_NONE, PSE_VAR_DOUBLE, {0}, 1.0, 0}
+};
+
+#define BENCH_CASES		(sizeof(cases)/sizeof(cases[0]))
+
+/*
+ * Variables are registered per case, per shape (scalar or array) and per
+ * read_and_alter flag.
+ */
+static pse_varid varids[BENCH_CASES][2][2];
+
+/*
+ * Tables of the tabulated cases: weights of the outcomes 0 to
+ * BENCH_TABLE_SIZE - 1, and of the bins between consecutive edges.
+ */
+static double table_weights[BENCH_TABLE_SIZE] = {1, 2, 3, 4, 4, 3, 2, 1};
+static double table_edges[BENCH_TABLE_SIZE + 1] = {0, 1, 2, 3, 4, 5, 6, 7, 8};
+
+/*
+ * Accumulates every observation so that none can be optimized away
+ */
+static volatile double sink;
+
+/*
+ * Abort on any error
+ */
+static void bench_check(pse_error error, char *what) {
+	char message[BENCH_ERROR_SIZE];
+
+	if (error == PSE_ERROR_OK)
+		return;
+
+	pse_error_log(error, message, what);
+	fprintf(stderr, "%s", message);
+	exit(EXIT_FAILURE);
+}
+
+/*
+ * Sampler of the CUSTOM cases: a random walk with uniform steps of width
+ * pars[0]
+ */
+static void bench_walk(rng_state *rng, double *pars, double *values, double *out,
+						unsigned int count) {
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		out[i] = values[i] + pars[0]*(r8_uni_01() - 0.5);
+}
+
+/*
+ * Supply what CUSTOM and tabulated cases need to draw
+ */
+static void bench_configure(pse_agent_stub *pse, pse_varid varid, bench_case *bc,
+							pse_table **tables) {
+	switch(bc->distribution) {
+	case PSE_DIST_CUSTOM:
+		bench_check(pse_supply_sampler(pse, varid, bench_walk), bc->name);
+		break;
+	case PSE_DIST_TABLE_INT:
+		bench_check(pse_supply_table(pse, varid, tables[0]), bc->name);
+		break;
+	case PSE_DIST_TABLE_DOUBLE:
+		bench_check(pse_supply_table(pse, varid, tables[1]), bc->name);
+		break;
+	default:
+		break;
+	}
+}
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/*
+ * Store the initial value of a case in a variable (all locations of arrays)
+ */
+static void bench_reset(pse_variable *var, bench_case *bc, unsigned int location) {
+	if (var->array == PSE_SCALAR) {
+		if (bc->storage == PSE_VAR_INT)
+			var->content.cint = (int)bc->initial;
+		else
+			var->content.cdouble = bc->initial;
+	} else {
+		if (bc->storage == PSE_VAR_INT)
+			var->content.cint_a[location] = (int)bc->initial;
+		else
+			var->content.cdouble_a[location] = bc->initial;
+	}
+}
+
+static double bench_single(pse_agent_stub *pse, pse_varid varid, bench_case *bc,
+							unsigned int samples, unsigned int restore) {
+	pse_variable *var = pse->variables[varid];
+	unsigned int mask = (var->array == PSE_ARRAY) ? BENCH_ARRAY_SIZE - 1 : 0;
+	unsigned int i;
+	double sum = 0;
+	double start;
+	pse_error error;
+
+	start = now();
+
+	if (bc->storage == PSE_VAR_INT) {
+		for (i = 0; i < samples; i++) {
+			if (restore)
+				bench_reset(var, bc, i & mask);
+
+			sum += pse_observe_int(pse, varid, i & mask, &error);
+
+			if (error != PSE_ERROR_OK)
+				bench_check(error, bc->name);
+		}
+	} else {
+		for (i = 0; i < samples; i++) {
+			if (restore)
+				bench_reset(var, bc, i & mask);
+
+			sum += pse_observe_double(pse, varid, i & mask, &error);
+
+			if (error != PSE_ERROR_OK)
+				bench_check(error, bc->name);
+		}
+	}
+
+	sink += sum;
+
+	return now() - start;
+}
+
+static double bench_batch(pse_agent_stub *pse, pse_varid varid, bench_case *bc,
+							unsigned int samples) {
+	int ibuffer[BENCH_BATCH];
+	double dbuffer[BENCH_BATCH];
+	pse_content out;
+	unsigned int done;
+	unsigned int count;
+	double start;
+	pse_error error;
+
+	if (bc->storage == PSE_VAR_INT)
+		out.cint_a = ibuffer;
+	else
+		out.cdouble_a = dbuffer;
+
+	start = now();
+
+	for (done = 0; done < samples; done += count) {
+		count = (samples - done < BENCH_BATCH) ? samples - done : BENCH_BATCH;
+		pse_observe_batch(pse, varid, 0, out, count, bc->storage, &error);
+		bench_check(error, bc->name);
+	}
+
+	sink += (bc->storage == PSE_VAR_INT) ? ibuffer[0] : dbuffer[0];
+
+	return now() - start;
+}
+
+static void bench_emit(FILE *fp, int *first, bench_case *bc, unsigned int shape,
+						unsigned int alter, char *api, unsigned int samples,
+						double seconds) {
+	fprintf(fp, "%s\n    {\"distribution\": \"%s\", \"storage\": \"%s\", "
+				"\"shape\": \"%s\", \"read_and_alter\": %s, \"api\": \"%s\", "
+				"\"samples\": %u, \"ns_per_sample\": %.2f, "
+				"\"samples_per_sec\": %.0f}",
+				*first ? "" : ",", bc->name,
+				bc->storage == PSE_VAR_INT ? "int" : "double",
+				shape == 0 ? "scalar" : "array",
+				alter ? "true" : "false", api, samples,
+				1e9*seconds/samples, samples/seconds);
+	*first = 0;
+}
+
+int main(int argc, char **argv) {
+	pse_agent_stub bench_pse;
+	double array_params[PSE_MAX_DIST_PARAMS] = {0.0,0.0,0.0,0.0,0.0};
+	unsigned int samples = BENCH_SAMPLES;
+	unsigned int c;
+	unsigned int shape;
+	unsigned int alter;
+	unsigned int i;
+	int first = 1;
+	bench_case *bc;
+	pse_variable *var;
+	pse_table *tables[2];
+	pse_error error;
+	FILE *fp = stdout;
+
+	if (argc > 1)
+		samples = (unsigned int) strtoul(argv[1], NULL, 10);
+
+	if (argc > 2) {
+		fp = fopen(argv[2], "w");
+
+		if (fp == NULL) {
+			perror(argv[2]);
+			return 1;
+		}
+	}
+
+	tables[0] = pse_table_int(table_weights, NULL, BENCH_TABLE_SIZE, &error);
+	bench_check(error, "TABLE_INT");
+	tables[1] = pse_table_double(table_edges, table_weights, BENCH_TABLE_SIZE, &error);
+	bench_check(error, "TABLE_DOUBLE");
+
+	bench_pse.state = CREATED;
+	bench_check(pse_init(&bench_pse), "init");
+
+	for (c = 0; c < BENCH_CASES; c++) {
+		for (shape = 0; shape < 2; shape++) {
+			for (alter = 0; alter < 2; alter++) {
+				varids[c][shape][alter] = pse_register(&bench_pse, cases[c].storage,
+								PSE_VAR_STOCHASTIC, PSE_AGENT, cases[c].distribution,
+								cases[c].parameters, shape == 0 ? PSE_SCALAR : PSE_ARRAY,
+								shape == 0 ? 1 : BENCH_ARRAY_SIZE,
+								alter ? PSE_TRUE : PSE_FALSE, PSE_DIST_NONE,
+								array_params, cases[c].name);
+
+				if (varids[c][shape][alter] < 0)
+					bench_check((pse_error) varids[c][shape][alter], cases[c].name);
+
+				bench_configure(&bench_pse, varids[c][shape][alter], &cases[c], tables);
+			}
+		}
+	}
+
+	bench_check(pse_start(&bench_pse, BENCH_SEED_1, BENCH_SEED_2), "start");
+
+	for (c = 0; c < BENCH_CASES; c++) {
+		for (shape = 0; shape < 2; shape++) {
+			for (alter = 0; alter < 2; alter++) {
+				var = bench_pse.variables[varids[c][shape][alter]];
+
+				for (i = 0; i < var->size; i++)
+					bench_reset(var, &cases[c], i);
+			}
+		}
+	}
+
+	fprintf(fp, "{\n  \"benchmark\": \"pse\",\n  \"samples\": %u,\n"
+				"  \"array_size\": %u,\n  \"batch\": %u,\n  \"results\": [",
+				samples, BENCH_ARRAY_SIZE, BENCH_BATCH);
+
+	for (c = 0; c < BENCH_CASES; c++) {
+		bc = &cases[c];
+
+		for (shape = 0; shape < 2; shape++) {
+			for (alter = 0; alter < 2; alter++) {
+				/*
+				 * Warm up caches and branch predictors before timing
+				 */
+				bench_single(&bench_pse, varids[c][shape][alter], bc, samples/10,
+								alter && bc->self);
+				bench_emit(fp, &first, bc, shape, alter, "single", samples,
+							bench_single(&bench_pse, varids[c][shape][alter], bc,
+											samples, alter && bc->self));
+
+				if (!alter)
+					bench_emit(fp, &first, bc, shape, alter, "batch", samples,
+								bench_batch(&bench_pse, varids[c][shape][alter], bc,
+											samples));
+			}
+		}
+	}
+
+	fprintf(fp, "\n  ]\n}\n");
+
+	if (fp != stdout)
+		fclose(fp);
+
+	bench_check(pse_finalize(&bench_pse), "finalize");
+	pse_table_release(tables[0]);
+	pse_table_release(tables[1]);
+
+	return 0;
+}
@@ -0,0 +1,351 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#include <stdio.h>
+#include <pse.h>
+#include <pseckpt.h>
+#include <psegibbs.h>
+#include <psesde.h>
+#include <psecustom.h>
+#include <rnglib.h>
+
+#define ERROR_BUFF_SIZE 200
+#define TEST_DRAWS		200
+#define TEST_SEED_1		103
+#define TEST_SEED_2		29
+#define TEST_FILE		"03-checkpoint-pse.ckpt"
+
+/*
+ * Purpose of the test:
+ * --------------------
+ *
+ * Checkpoint a started stub whose variable depends on another one, with a
+ * prior and a block prior, and restore it. The restored stub must refuse to
+ * draw the dependent variable until its priors are supplied again, and must
+ * then draw exactly what the original stub draws. The same holds for a
+ * FOKKER_PLANCK variable and its model, for a FOKKER_PLANCK variable with a
+ * dependency, which must not advance until its prior is supplied again, and
+ * for a CUSTOM variable and its sampler.
+ */
+static double rain_given(unsigned int count, unsigned int *evidence) {
+	return 0.1 + 0.25*evidence[0];
+}
+
+static void rain_block(pse_prior_block *block) {
+	unsigned int i;
+
+	for (i = 0; i < block->items; i++)
+		block->priors[i] = rain_given(1, block->evidence + block->offsets[i]);
+}
+
+static void level_model(unsigned int count, double *values, double *pars,
+						double *drift, double *diffusion) {
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		drift[i] = 100;
+		diffusion[i] = 0.5*values[i];
+	}
+}
+
+static double flow_given(unsigned int count, unsigned int *evidence) {
+	return 0.5 + 0.5*evidence[0];
+}
+
+static void flow_model(unsigned int count, double *values, double *pars,
+						double *drift, double *diffusion) {
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		drift[i] = pars[0];
+		diffusion[i] = 0.1;
+	}
+}
+
+static void walk_sampler(rng_state *rng, double *pars, double *values, double *out,
+						unsigned int count) {
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		out[i] = values[i] + pars[0]*(r8_uni_01() - 0.5);
+}
+
+/*
+ * Draw the same sequence from a stub: seasons, rain conditioned on them and a
+ * Gibbs sweep. Returns PSE_ERROR_OK or the first error.
+ */
+static pse_error run(pse_agent_stub *pse, pse_varid season, pse_varid rain, int *draws) {
+	pse_error error;
+	unsigned int i;
+
+	for (i = 0; i < TEST_DRAWS; i++) {
+		if (i % 10 == 0) {
+			pse_observe_int(pse, season, 0, &error);
+
+			if (error != PSE_ERROR_OK)
+				return error;
+		}
+
+		draws[i] = pse_observe_int(pse, rain, 0, &error);
+
+		if (error != PSE_ERROR_OK)
+			return error;
+	}
+
+	error = pse_gibbs(pse, 1, 0);
+
+	if (error != PSE_ERROR_OK)
+		return error;
+
+	draws[TEST_DRAWS] = pse_read_int(pse, rain);
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Step a FOKKER_PLANCK variable, through observations and advances
+ */
+static pse_error run_level(pse_agent_stub *pse, pse_varid level, double *draws) {
+	pse_error error;
+	unsigned int i;
+
+	for (i = 0; i < TEST_DRAWS; i++) {
+		draws[i] = pse_observe_double(pse, level, 0, &error);
+
+		if (error != PSE_ERROR_OK)
+			return error;
+	}
+
+	pse_sde_advance(pse, level, &error);
+
+	if (error != PSE_ERROR_OK)
+		return error;
+
+	draws[TEST_DRAWS] = pse_read_double(pse, level);
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Step a CUSTOM variable, through observations and a batch
+ */
+static pse_error run_walk(pse_agent_stub *pse, pse_varid walk, double *draws) {
+	pse_content batch;
+	pse_error error;
+	unsigned int i;
+
+	for (i = 0; i < TEST_DRAWS; i++) {
+		draws[i] = pse_observe_double(pse, walk, 0, &error);
+
+		if (error != PSE_ERROR_OK)
+			return error;
+	}
+
+	batch.cdouble_a = &draws[TEST_DRAWS];
+	pse_observe_batch(pse, walk, 0, batch, 1, PSE_VAR_DOUBLE, &error);
+
+	return error;
+}
+
+static int check(pse_error errno, pse_error expected, char *what) {
+	char errmsg[ERROR_BUFF_SIZE];
+
+	if (errno == expected)
+		return 0;
+
+	pse_error_log(errno, errmsg, what);
+	fprintf(stderr, "%s", errmsg);
+
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	pse_agent_stub original;
+	pse_agent_stub restored;
+	double season_params[PSE_MAX_DIST_PARAMS] = {0.0,3.0,0.0,0.0,0.0};
+	double rain_params[PSE_MAX_DIST_PARAMS] = {0.5,0.0,0.0,0.0,0.0};
+	double array_params[PSE_MAX_DIST_PARAMS] = {0.0,0.0,0.0,0.0,0.0};
+	double level_params[PSE_MAX_DIST_PARAMS] = {0.0,0.0,0.0,0.0,0.1};
+	double walk_params[PSE_MAX_DIST_PARAMS] = {2.0,0.0,0.0,0.0,0.0};
+	double flow_params[PSE_MAX_DIST_PARAMS] = {0.0,0.0,0.0,0.0,0.1};
+	int expected[TEST_DRAWS + 1];
+	int draws[TEST_DRAWS + 1];
+	double expected_level[TEST_DRAWS + 1];
+	double level_draws[TEST_DRAWS + 1];
+	double expected_walk[TEST_DRAWS + 1];
+	double walk_draws[TEST_DRAWS + 1];
+	double expected_flow[TEST_DRAWS + 1];
+	double flow_draws[TEST_DRAWS + 1];
+	double flow_value;
+	pse_varid season;
+	pse_varid rain;
+	pse_varid level;
+	pse_varid walk;
+	pse_varid flow;
+	pse_error errno;
+	int failures = 0;
+	unsigned int i;
+
+	original.state = CREATED;
+	failures += check(pse_init(&original), PSE_ERROR_OK, "init");
+
+	season = pse_register(&original, PSE_VAR_INT, PSE_VAR_STOCHASTIC, PSE_WORLD,
+					PSE_DIST_UNIFORM_INT_BOUNDED, season_params, PSE_SCALAR, 1,
+					PSE_TRUE, PSE_DIST_NONE, array_params, "season");
+	rain = pse_register(&original, PSE_VAR_INT, PSE_VAR_STOCHASTIC, PSE_WORLD,
+					PSE_DIST_BERNOULLI, rain_params, PSE_SCALAR, 1,
+					PSE_FALSE, PSE_DIST_NONE, array_params, "rain");
+	level = pse_register(&original, PSE_VAR_DOUBLE, PSE_VAR_STOCHASTIC, PSE_AGENT,
+					PSE_DIST_FOKKER_PLANCK, level_params, PSE_SCALAR, 1,
+					PSE_TRUE, PSE_DIST_NONE, array_params, "level");
+	walk = pse_register(&original, PSE_VAR_DOUBLE, PSE_VAR_STOCHASTIC, PSE_AGENT,
+					PSE_DIST_CUSTOM, walk_params, PSE_SCALAR, 1,
+					PSE_TRUE, PSE_DIST_NONE, array_params, "walk");
+	flow = pse_register(&original, PSE_VAR_DOUBLE, PSE_VAR_STOCHASTIC, PSE_WORLD,
+					PSE_DIST_FOKKER_PLANCK, flow_params, PSE_SCALAR, 1,
+					PSE_TRUE, PSE_DIST_NONE, array_params, "flow");
+
+	if (season < 0 || rain < 0 || level < 0 || walk < 0 || flow < 0) {
+		fprintf(stderr, "[PSE Test] Registration failed.\n");
+		return 1;
+	}
+
+	failures += check(pse_add_dependencies(&original, rain, &season, 1), PSE_ERROR_OK,
+					"add dependencies");
+	failures += check(pse_supply_prior(&original, rain, rain_given), PSE_ERROR_OK,
+					"supply prior");
+	failures += check(pse_add_dependencies(&original, flow, &season, 1), PSE_ERROR_OK,
+					"add flow dependencies");
+	failures += check(pse_supply_prior(&original, flow, flow_given), PSE_ERROR_OK,
+					"supply flow prior");
+	failures += check(pse_supply_block_prior(&original, rain_block), PSE_ERROR_OK,
+					"supply block prior");
+	failures += check(pse_start_rng(&original, PSE_RNG_PHILOX, TEST_SEED_1, TEST_SEED_2),
+					PSE_ERROR_OK, "start");
+	failures += check(pse_supply_sde(&original, level, level_model, PSE_SDE_NO_CLOCK),
+					PSE_ERROR_OK, "supply model");
+	failures += check(pse_supply_sde(&original, flow, flow_model, PSE_SDE_NO_CLOCK),
+					PSE_ERROR_OK, "supply flow model");
+	failures += check(pse_supply_sampler(&original, walk, walk_sampler), PSE_ERROR_OK,
+					"supply sampler");
+	failures += check(run(&original, season, rain, draws), PSE_ERROR_OK, "warm up");
+	failures += check(run_level(&original, level, level_draws), PSE_ERROR_OK,
+					"warm up level");
+	failures += check(run_walk(&original, walk, walk_draws), PSE_ERROR_OK, "warm up walk");
+	failures += check(run_level(&original, flow, flow_draws), PSE_ERROR_OK, "warm up flow");
+
+	failures += check(pse_checkpoint(&original, 1, TEST_FILE), PSE_ERROR_OK, "checkpoint");
+	flow_value = pse_read_double(&original, flow);
+	failures += check(run(&original, season, rain, expected), PSE_ERROR_OK, "original");
+	failures += check(run_level(&original, level, expected_level), PSE_ERROR_OK,
+					"original level");
+	failures += check(run_walk(&original, walk, expected_walk), PSE_ERROR_OK,
+					"original walk");
+	failures += check(run_level(&original, flow, expected_flow), PSE_ERROR_OK,
+					"original flow");
+
+	restored.state = CREATED;
+	failures += check(pse_restore(&restored, 1, TEST_FILE), PSE_ERROR_OK, "restore");
+	remove(TEST_FILE);
+
+	/*
+	 * Until the priors are supplied again, the dependency cannot be drawn
+	 */
+	pse_observe_int(&restored, rain, 0, &errno);
+	failures += check(errno, PSE_ERROR_PRIOR_MISSING, "observe without prior");
+	failures += check(pse_gibbs(&restored, 1, 0), PSE_ERROR_PRIOR_MISSING,
+					"sweep without block prior");
+
+	failures += check(pse_supply_prior(&restored, rain, rain_given), PSE_ERROR_OK,
+					"supply prior again");
+	failures += check(pse_supply_block_prior(&restored, rain_block), PSE_ERROR_OK,
+					"supply block prior again");
+	failures += check(pse_supply_prior(&restored, rain, rain_given),
+					PSE_ERROR_ALREADY_STARTED, "supply prior twice");
+
+	/*
+	 * Nor can the FOKKER_PLANCK variable until its model is supplied again
+	 */
+	pse_observe_double(&restored, level, 0, &errno);
+	failures += check(errno, PSE_ERROR_SAMPLER_MISSING, "observe without model");
+	pse_sde_advance(&restored, level, &errno);
+	failures += check(errno, PSE_ERROR_SAMPLER_MISSING, "advance without model");
+
+	failures += check(pse_supply_sde(&restored, level, level_model, PSE_SDE_NO_CLOCK),
+					PSE_ERROR_OK, "supply model again");
+
+	/*
+	 * Nor can the FOKKER_PLANCK variable with a dependency advance, even with
+	 * its model, until its prior is supplied again
+	 */
+	failures += check(pse_supply_sde(&restored, flow, flow_model, PSE_SDE_NO_CLOCK),
+					PSE_ERROR_OK, "supply flow model again");
+	pse_sde_advance(&restored, flow, &errno);
+	failures += check(errno, PSE_ERROR_PRIOR_MISSING, "advance without prior");
+
+	if (pse_read_double(&restored, flow) != flow_value) {
+		fprintf(stderr, "[PSE Test] Flow advanced without its prior.\n");
+		failures++;
+	}
+
+	failures += check(pse_supply_prior(&restored, flow, flow_given), PSE_ERROR_OK,
+					"supply flow prior again");
+
+	/*
+	 * Nor the CUSTOM variable until its sampler is supplied again
+	 */
+	pse_observe_double(&restored, walk, 0, &errno);
+	failures += check(errno, PSE_ERROR_SAMPLER_MISSING, "observe without sampler");
+	failures += check(run_walk(&restored, walk, walk_draws), PSE_ERROR_SAMPLER_MISSING,
+					"batch without sampler");
+
+	failures += check(pse_supply_sampler(&restored, walk, walk_sampler), PSE_ERROR_OK,
+					"supply sampler again");
+
+	failures += check(run(&restored, season, rain, draws), PSE_ERROR_OK, "restored");
+	failures += check(run_level(&restored, level, level_draws), PSE_ERROR_OK,
+					"restored level");
+	failures += check(run_walk(&restored, walk, walk_draws), PSE_ERROR_OK, "restored walk");
+	failures += check(run_level(&restored, flow, flow_draws), PSE_ERROR_OK, "restored flow");
+
+	for (i = 0; i <= TEST_DRAWS; i++) {
+		if (draws[i] != expected[i]) {
+			fprintf(stderr, "[PSE Test] Draw %u differs: %d instead of %d.\n", i,
+					draws[i], expected[i]);
+			failures++;
+		}
+
+		if (walk_draws[i] != expected_walk[i]) {
+			fprintf(stderr, "[PSE Test] Walk %u differs: %f instead of %f.\n", i,
+					walk_draws[i], expected_walk[i]);
+			failures++;
+		}
+
+		if (level_draws[i] != expected_level[i]) {
+			fprintf(stderr, "[PSE Test] Level %u differs: %f instead of %f.\n", i,
+					level_draws[i], expected_level[i]);
+			failures++;
+		}
+
+		if (flow_draws[i] != expected_flow[i]) {
+			fprintf(stderr, "[PSE Test] Flow %u differs: %f instead of %f.\n", i,
+					flow_draws[i], expected_flow[i]);
+			failures++;
+		}
+	}
+
+	pse_finalize(&original);
+	pse_finalize(&restored);
+
+	fprintf(stderr, "[PSE Test] %s: %d failure(s).\n", failures == 0 ? "Passed" : "Failed",
+			failures);
+
+	return failures == 0 ? 0 : 1;
+}
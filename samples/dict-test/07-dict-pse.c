@@ -0,0 +1,125 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pse.h>
+#include <psedict.h>
+
+#define TEST_NAMES		40
+#define TEST_CHURN		1000
+
+/*
+ * Purpose of the test:
+ * --------------------
+ *
+ * Exercise a dictionary: a miss once a first name is in, growth past its
+ * initial table, removal and reinsertion of a name into the entry it left,
+ * rejection of a handle on a removed name once its entry is taken again,
+ * rejection of names that do not fit in an entry, and many additions and
+ * removals, which leave deleted markers behind, without the table filling
+ * up.
+ */
+static int expect(int value, int expected, char *what) {
+	if (value == expected)
+		return 0;
+
+	fprintf(stderr, "[PSE Test] %s: %d instead of %d.\n", what, value, expected);
+
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	pse_dictionary dict;
+	pse_dict_handle stale;
+	pse_dict_handle fresh;
+	char name[2*PSE_VARNAME_SIZE];
+	int failures = 0;
+	int i;
+
+	dict.slots = NULL;
+	failures += expect(pse_dict_init(&dict), 1, "init");
+	failures += expect(pse_dict_init(&dict), 0, "init twice");
+
+	/*
+	 * A miss must end at an empty slot, with one name in or many
+	 */
+	failures += expect(pse_dict_add(&dict, "name0", 0), 1, "add first");
+	failures += expect(pse_dict_search(&dict, "missing"), -1, "miss after first");
+
+	for (i = 1; i < TEST_NAMES; i++) {
+		sprintf(name, "name%d", i);
+		failures += expect(pse_dict_add(&dict, name, i), 1, "add");
+	}
+
+	failures += expect(pse_dict_add(&dict, "name7", 70), 0, "add twice");
+	failures += expect(pse_dict_search(&dict, "missing"), -1, "miss after growth");
+
+	for (i = 0; i < TEST_NAMES; i++) {
+		sprintf(name, "name%d", i);
+		failures += expect(pse_dict_search(&dict, name), i, "search");
+		failures += expect(pse_dict_search_hashed(&dict, name, pse_dict_hash(name)), i,
+						"search hashed");
+		failures += expect(pse_dict_get(&dict, pse_dict_resolve(&dict, name)), i, "get");
+	}
+
+	/*
+	 * A removed name gives its entry to the next one added; handles on the
+	 * removed name are refused from then on
+	 */
+	stale = pse_dict_resolve(&dict, "name7");
+
+	failures += expect(pse_dict_remove(&dict, "name7"), 1, "remove");
+	failures += expect(pse_dict_remove(&dict, "name7"), 0, "remove twice");
+	failures += expect(pse_dict_search(&dict, "name7"), -1, "search removed");
+	failures += expect(pse_dict_get(&dict, stale), -1, "get removed");
+	failures += expect(dict.length, TEST_NAMES - 1, "length");
+
+	failures += expect(pse_dict_add(&dict, "name7", 77), 1, "add again");
+	fresh = pse_dict_resolve(&dict, "name7");
+
+	failures += expect((int)(fresh & 0xffffffffLL), (int)(stale & 0xffffffffLL),
+					"reused entry");
+	failures += expect(pse_dict_get(&dict, fresh), 77, "get again");
+	failures += expect(pse_dict_get(&dict, stale), -1, "get stale");
+	failures += expect(pse_dict_search(&dict, "name7"), 77, "search again");
+
+	/*
+	 * Names that do not fit in an entry are refused, not truncated
+	 */
+	memset(name, 'x', PSE_VARNAME_SIZE);
+	name[PSE_VARNAME_SIZE] = '\0';
+	failures += expect(pse_dict_add(&dict, name, 100), 0, "add long name");
+	failures += expect(pse_dict_search(&dict, name), -1, "search long name");
+
+	name[PSE_VARNAME_SIZE - 1] = '\0';
+	failures += expect(pse_dict_add(&dict, name, 101), 1, "add longest name");
+	failures += expect(pse_dict_search(&dict, name), 101, "search longest name");
+
+	/*
+	 * Deleted markers are cleaned before they fill the table
+	 */
+	for (i = 0; i < TEST_CHURN; i++) {
+		sprintf(name, "churn%d", i);
+		failures += expect(pse_dict_add(&dict, name, i), 1, "add churn");
+		failures += expect(pse_dict_remove(&dict, name), 1, "remove churn");
+	}
+
+	failures += expect(pse_dict_search(&dict, "missing"), -1, "miss after churn");
+	failures += expect(pse_dict_search(&dict, "name39"), 39, "search after churn");
+	failures += expect(dict.length, TEST_NAMES + 1, "length after churn");
+
+	pse_dict_finalize(&dict);
+
+	fprintf(stderr, "[PSE Test] %s: %d failure(s).\n", failures == 0 ? "Passed" : "Failed",
+			failures);
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#include <cstdio>
+#include <pse.hpp>
+#include <psecustom.h>
+#include <pseckpt.h>
+
+#define ERROR_BUFF_SIZE 200
+#define TEST_DRAWS		200
+#define TEST_LEVELS		4
+#define TEST_SEED		71
+#define TEST_AGENT		5
+#define TEST_FILE		"04-facade-pse.ckpt"
+
+/*
+ * Purpose of the test:
+ * --------------------
+ *
+ * Build two twin stubs, one driven through pse::Variable handles and the
+ * other through the C API, and check that every observation and preparation
+ * agrees: a typed distribution (POISSON), a normal array under
+ * PSE_SAMPLER_CLASSIC, a variable with a dependency and a CUSTOM variable.
+ * Then restore a checkpoint of the first stub and check that handles of its
+ * dependent and CUSTOM variables report what the C API refuses to draw.
+ */
+static double rain_given(unsigned int count, unsigned int *evidence) {
+	return 0.1 + 0.25*evidence[0];
+}
+
+static void walk_sampler(rng_state *rng, double *pars, double *values, double *out,
+						unsigned int count) {
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		out[i] = values[i] + pars[0]*(r8_uni_01() - 0.5);
+}
+
+static int check(pse_error error, pse_error expected, const char *what) {
+	char errmsg[ERROR_BUFF_SIZE];
+
+	if (error == expected)
+		return 0;
+
+	pse_error_log(error, errmsg, const_cast<char *>(what));
+	fprintf(stderr, "%s", errmsg);
+
+	return 1;
+}
+
+static int compare(double value, double expected, const char *what, unsigned int i) {
+	if (value == expected)
+		return 0;
+
+	fprintf(stderr, "[PSE Test] %s %u differs: %f instead of %f.\n", what, i, value,
+			expected);
+
+	return 1;
+}
+
+/*
+ * Register, in the C stub, the variables the handles register in theirs
+ */
+static pse_varid register_c(pse_agent_stub *pse, pse_storage_type storage,
+						pse_locality_type locality, pse_distribution_type distribution,
+						double *parameters, unsigned int size, unsigned int read_and_alter,
+						const char *name) {
+	double array_params[PSE_MAX_DIST_PARAMS] = {0.0,0.0,0.0,0.0,0.0};
+
+	return pse_register(pse, storage, PSE_VAR_STOCHASTIC, locality, distribution,
+					parameters, size > 1 ? PSE_ARRAY : PSE_SCALAR, size, read_and_alter,
+					PSE_DIST_NONE, array_params, const_cast<char *>(name));
+}
+
+int main(int argc, char **argv) {
+	pse_agent_stub typed;
+	pse_agent_stub plain;
+	pse_agent_stub restored;
+	double season_params[PSE_MAX_DIST_PARAMS] = {0.0,3.0,0.0,0.0,0.0};
+	double rain_params[PSE_MAX_DIST_PARAMS] = {0.5,0.0,0.0,0.0,0.0};
+	double count_params[PSE_MAX_DIST_PARAMS] = {4.0,0.0,0.0,0.0,0.0};
+	double level_params[PSE_MAX_DIST_PARAMS] = {0.0,2.0,0.0,0.0,0.0};
+	double walk_params[PSE_MAX_DIST_PARAMS] = {2.0,0.0,0.0,0.0,0.0};
+	double walk_expected[TEST_DRAWS];
+	double walk_batch[TEST_DRAWS];
+	pse_varid season;
+	pse_varid rain;
+	pse_content content;
+	pse_error error;
+	int failures = 0;
+	unsigned int location;
+	unsigned int i;
+
+	typed.state = CREATED;
+	plain.state = CREATED;
+	failures += check(pse_init(&typed), PSE_ERROR_OK, "init typed");
+	failures += check(pse_init(&plain), PSE_ERROR_OK, "init plain");
+	failures += check(pse_set_sampler(&typed, PSE_SAMPLER_CLASSIC), PSE_ERROR_OK,
+					"sampler typed");
+	failures += check(pse_set_sampler(&plain, PSE_SAMPLER_CLASSIC), PSE_ERROR_OK,
+					"sampler plain");
+
+	/*
+	 * Dependencies only hold for world variables, which handles bind to
+	 */
+	season = register_c(&typed, PSE_VAR_INT, PSE_WORLD, PSE_DIST_UNIFORM_INT_BOUNDED,
+					season_params, 1, PSE_TRUE, "season");
+	rain = register_c(&typed, PSE_VAR_INT, PSE_WORLD, PSE_DIST_BERNOULLI, rain_params,
+					1, PSE_FALSE, "rain");
+	register_c(&plain, PSE_VAR_INT, PSE_WORLD, PSE_DIST_UNIFORM_INT_BOUNDED,
+					season_params, 1, PSE_TRUE, "season");
+	register_c(&plain, PSE_VAR_INT, PSE_WORLD, PSE_DIST_BERNOULLI, rain_params,
+					1, PSE_FALSE, "rain");
+
+	pse::Variable<int, PSE_DIST_POISSON> count(typed, "count", {4.0});
+	pse::Variable<double, PSE_DIST_NORMAL> level(typed, "level", {0.0, 2.0}, true,
+					TEST_LEVELS);
+	pse::Variable<double, PSE_DIST_CUSTOM> walk(typed, "walk", {2.0}, true);
+	pse::Variable<int, PSE_DIST_BERNOULLI> raining(typed, rain);
+
+	register_c(&plain, PSE_VAR_INT, PSE_AGENT, PSE_DIST_POISSON, count_params, 1,
+					PSE_FALSE, "count");
+	register_c(&plain, PSE_VAR_DOUBLE, PSE_AGENT, PSE_DIST_NORMAL, level_params,
+					TEST_LEVELS, PSE_TRUE, "level");
+	register_c(&plain, PSE_VAR_DOUBLE, PSE_AGENT, PSE_DIST_CUSTOM, walk_params, 1,
+					PSE_TRUE, "walk");
+
+	failures += check(count.error(), PSE_ERROR_OK, "count handle");
+	failures += check(level.error(), PSE_ERROR_OK, "level handle");
+	failures += check(walk.error(), PSE_ERROR_OK, "walk handle");
+	failures += check(raining.error(), PSE_ERROR_OK, "rain handle");
+
+	/*
+	 * Handles refuse variables of another type or distribution
+	 */
+	failures += check(pse::Variable<int, PSE_DIST_POISSON>(typed, rain).error(),
+					PSE_ERROR_TYPE_MISMATCH, "mismatched handle");
+
+	failures += check(pse_add_dependencies(&typed, rain, &season, 1), PSE_ERROR_OK,
+					"dependencies typed");
+	failures += check(pse_add_dependencies(&plain, rain, &season, 1), PSE_ERROR_OK,
+					"dependencies plain");
+	failures += check(pse_supply_prior(&typed, rain, rain_given), PSE_ERROR_OK,
+					"prior typed");
+	failures += check(pse_supply_prior(&plain, rain, rain_given), PSE_ERROR_OK,
+					"prior plain");
+	failures += check(pse_supply_sampler(&typed, walk.id(), walk_sampler), PSE_ERROR_OK,
+					"sampler typed");
+	failures += check(pse_supply_sampler(&plain, walk.id(), walk_sampler), PSE_ERROR_OK,
+					"sampler plain");
+
+	failures += check(pse_start_rng(&typed, PSE_RNG_PHILOX, TEST_SEED, TEST_AGENT),
+					PSE_ERROR_OK, "start typed");
+	failures += check(pse_start_rng(&plain, PSE_RNG_PHILOX, TEST_SEED, TEST_AGENT),
+					PSE_ERROR_OK, "start plain");
+
+	for (i = 0; i < TEST_DRAWS; i++) {
+		failures += compare(count.observe(), pse_observe_int(&plain, count.id(), 0, &error),
+					"Count", i);
+
+		location = i % TEST_LEVELS;
+
+		if (i % 5 == 0) {
+			level.prepare(0.5*i, location);
+			content.cdouble = 0.5*i;
+			pse_prepare(&plain, level.id(), content, location, PSE_VAR_DOUBLE, &error);
+			failures += check(error, PSE_ERROR_OK, "prepare level");
+			failures += compare(level.read(location),
+					plain.variables[level.id()]->content.cdouble_a[location],
+					"Prepared level", i);
+		}
+
+		failures += compare(level.observe(location),
+					pse_observe_double(&plain, level.id(), location, &error), "Level", i);
+
+		if (i % 10 == 0) {
+			pse_observe_int(&typed, season, 0, &error);
+			pse_observe_int(&plain, season, 0, &error);
+		}
+
+		failures += compare(raining.observe(), pse_observe_int(&plain, rain, 0, &error),
+					"Rain", i);
+		failures += compare(walk.observe(),
+					pse_observe_double(&plain, walk.id(), 0, &error), "Walk", i);
+	}
+
+	/*
+	 * Batches of handles are those of the C API
+	 */
+	content.cdouble_a = walk_expected;
+	pse_observe_batch(&plain, walk.id(), 0, content, TEST_DRAWS, PSE_VAR_DOUBLE, &error);
+	failures += check(error, PSE_ERROR_OK, "batch plain");
+	failures += check(walk.observe(walk_batch, TEST_DRAWS), PSE_ERROR_OK, "batch typed");
+
+	for (i = 0; i < TEST_DRAWS; i++)
+		failures += compare(walk_batch[i], walk_expected[i], "Batch", i);
+
+	/*
+	 * Handles of restored variables record the errors of the C API
+	 */
+	failures += check(pse_checkpoint(&typed, 1, const_cast<char *>(TEST_FILE)),
+					PSE_ERROR_OK, "checkpoint");
+	restored.state = CREATED;
+	failures += check(pse_restore(&restored, 1, const_cast<char *>(TEST_FILE)),
+					PSE_ERROR_OK, "restore");
+	remove(TEST_FILE);
+
+	pse::Variable<int, PSE_DIST_BERNOULLI> restored_rain(restored, rain);
+	pse::Variable<double, PSE_DIST_CUSTOM> restored_walk(restored, walk.id());
+
+	failures += check(restored_rain.error(), PSE_ERROR_OK, "restored rain handle");
+	failures += check(restored_walk.error(), PSE_ERROR_OK, "restored walk handle");
+
+	restored_rain.observe();
+	failures += check(restored_rain.error(), PSE_ERROR_PRIOR_MISSING,
+					"observe without prior");
+	restored_walk.observe();
+	failures += check(restored_walk.error(), PSE_ERROR_SAMPLER_MISSING,
+					"observe without sampler");
+
+	failures += check(pse_supply_prior(&restored, rain, rain_given), PSE_ERROR_OK,
+					"prior restored");
+	failures += check(pse_supply_sampler(&restored, walk.id(), walk_sampler), PSE_ERROR_OK,
+					"sampler restored");
+
+	failures += compare(restored_rain.observe(), raining.observe(), "Restored rain", 0);
+	failures += check(restored_rain.error(), PSE_ERROR_OK, "observe with prior");
+	failures += compare(restored_walk.observe(), walk.observe(), "Restored walk", 0);
+	failures += check(restored_walk.error(), PSE_ERROR_OK, "observe with sampler");
+
+	pse_finalize(&typed);
+	pse_finalize(&plain);
+	pse_finalize(&restored);
+
+	fprintf(stderr, "[PSE Test] %s: %d failure(s).\n", failures == 0 ? "Passed" : "Failed",
+			failures);
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,289 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pse.h>
+#include <psepop.h>
+#include <psesde.h>
+#include <psesnap.h>
+#include <psetable.h>
+
+#define ERROR_BUFF_SIZE 200
+#define TEST_AGENTS		5000
+#define TEST_STEPS		3
+#define TEST_SEED		211
+#define TEST_FILE		"05-population-pse.snap"
+
+/*
+ * Purpose of the test:
+ * --------------------
+ *
+ * Step a population with PSE_RNG_PHILOX on 1, 2, 4 and 7 threads, and check
+ * that every column ends up identical, and identical to observing each column
+ * in turn (clocked FOKKER_PLANCK columns last). Then snapshot a population,
+ * map the snapshot and check that the mapped population refuses to step
+ * until its SDE model and table are supplied again, and then resumes exactly
+ * where the original goes.
+ */
+typedef struct test_columns {
+	pse_varid wealth;
+	pse_varid visits;
+	pse_varid trials;
+	pse_varid dt;
+	pse_varid price;
+	pse_varid rate;
+	pse_varid choice;
+} test_columns;
+
+static const unsigned int thread_counts[] = {1, 2, 4, 7};
+
+static void price_model(unsigned int count, double *values, double *pars,
+						double *drift, double *diffusion) {
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		drift[i] = pars[0]*values[i]*(1 - values[i]);
+		diffusion[i] = pars[2]*values[i];
+	}
+}
+
+static int check(pse_error errno, pse_error expected, char *what) {
+	char errmsg[ERROR_BUFF_SIZE];
+
+	if (errno == expected)
+		return 0;
+
+	pse_error_log(errno, errmsg, what);
+	fprintf(stderr, "%s", errmsg);
+
+	return 1;
+}
+
+/*
+ * Supply what a population cannot keep in a snapshot: the model of the price
+ * column and the table of the choice column
+ */
+static int supply(pse_population *pop, test_columns *cols) {
+	double weights[4] = {0.1, 0.2, 0.3, 0.4};
+	int values[4] = {-1, 2, 5, 7};
+	pse_table *table;
+	pse_error errno;
+	int failures = 0;
+
+	failures += check(pse_pop_supply_sde(pop, cols->price, price_model, cols->dt),
+					PSE_ERROR_OK, "supply model");
+
+	table = pse_table_int(weights, values, 4, &errno);
+	failures += check(errno, PSE_ERROR_OK, "table");
+
+	if (table != NULL) {
+		failures += check(pse_pop_supply_table(pop, cols->choice, table), PSE_ERROR_OK,
+						"supply table");
+		pse_table_release(table);
+	}
+
+	return failures;
+}
+
+/*
+ * A started population with one column of each kind
+ */
+static int build(pse_population *pop, test_columns *cols) {
+	double wealth_params[PSE_MAX_DIST_PARAMS] = {0.3,0.0,0.0,0.0,0.0};
+	double visits_params[PSE_MAX_DIST_PARAMS] = {3.5,0.0,0.0,0.0,0.0};
+	double trials_params[PSE_MAX_DIST_PARAMS] = {20.0,0.3,0.0,0.0,0.0};
+	double dt_params[PSE_MAX_DIST_PARAMS] = {0.01,0.1,0.0,0.0,0.0};
+	double price_params[PSE_MAX_DIST_PARAMS] = {0.5,0.0,0.2,0.0,0.0};
+	double rate_params[PSE_MAX_DIST_PARAMS] = {0.05,-0.5,0.1,0.0,0.0};
+	double choice_params[PSE_MAX_DIST_PARAMS] = {0.0,0.0,0.0,0.0,0.0};
+	char long_name[PSE_VARNAME_SIZE + 1];
+	pse_content content;
+	pse_error errno;
+	int failures = 0;
+	unsigned int i;
+
+	pop->state = CREATED;
+	failures += check(pse_pop_init(pop, TEST_AGENTS), PSE_ERROR_OK, "init");
+
+	cols->wealth = pse_pop_register(pop, PSE_VAR_DOUBLE, PSE_VAR_STOCHASTIC,
+					PSE_DIST_NORMAL_SELF, wealth_params, PSE_TRUE, "wealth");
+	cols->visits = pse_pop_register(pop, PSE_VAR_INT, PSE_VAR_STOCHASTIC,
+					PSE_DIST_POISSON, visits_params, PSE_TRUE, "visits");
+	cols->trials = pse_pop_register(pop, PSE_VAR_INT, PSE_VAR_STOCHASTIC,
+					PSE_DIST_BINOMIAL, trials_params, PSE_TRUE, "trials");
+	cols->dt = pse_pop_register(pop, PSE_VAR_TIME, PSE_VAR_STOCHASTIC,
+					PSE_DIST_UNIFORM_DOUBLE_BOUNDED, dt_params, PSE_TRUE, "dt");
+	cols->price = pse_pop_register(pop, PSE_VAR_DOUBLE, PSE_VAR_STOCHASTIC,
+					PSE_DIST_FOKKER_PLANCK, price_params, PSE_TRUE, "price");
+	cols->rate = pse_pop_register(pop, PSE_VAR_DOUBLE, PSE_VAR_STOCHASTIC,
+					PSE_DIST_FOKKER_PLANCK, rate_params, PSE_TRUE, "rate");
+	cols->choice = pse_pop_register(pop, PSE_VAR_INT, PSE_VAR_STOCHASTIC,
+					PSE_DIST_TABLE_INT, choice_params, PSE_TRUE, "choice");
+
+	if (cols->wealth < 0 || cols->visits < 0 || cols->trials < 0 || cols->dt < 0 ||
+		cols->price < 0 || cols->rate < 0 || cols->choice < 0) {
+		fprintf(stderr, "[PSE Test] Registration failed.\n");
+		return failures + 1;
+	}
+
+	/*
+	 * Names that do not fit in a column are refused before it is taken
+	 */
+	memset(long_name, 'x', PSE_VARNAME_SIZE);
+	long_name[PSE_VARNAME_SIZE] = '\0';
+	failures += check((pse_error) pse_pop_register(pop, PSE_VAR_DOUBLE, PSE_VAR_STOCHASTIC,
+					PSE_DIST_NORMAL_SELF, wealth_params, PSE_TRUE, long_name),
+					PSE_ERROR_NAME_TOO_LONG, "register long name");
+
+	if (pop->column_count != cols->choice + 1) {
+		fprintf(stderr, "[PSE Test] A refused column was taken.\n");
+		failures++;
+	}
+
+	failures += supply(pop, cols);
+	failures += check(pse_pop_supply_sde(pop, cols->rate, NULL, cols->dt), PSE_ERROR_OK,
+					"supply clock");
+	failures += check(pse_pop_start(pop, PSE_RNG_PHILOX, TEST_SEED, 0), PSE_ERROR_OK,
+					"start");
+
+	for (i = 0; i < TEST_AGENTS; i++) {
+		content.cdouble = 100.0 + i;
+		pse_pop_prepare(pop, cols->wealth, i, content, PSE_VAR_DOUBLE, &errno);
+		failures += check(errno, PSE_ERROR_OK, "prepare wealth");
+
+		content.cdouble = 0.1 + 0.8*i/TEST_AGENTS;
+		pse_pop_prepare(pop, cols->price, i, content, PSE_VAR_DOUBLE, &errno);
+		failures += check(errno, PSE_ERROR_OK, "prepare price");
+	}
+
+	return failures;
+}
+
+/*
+ * Compare every column of two populations. Returns the number of columns
+ * that differ.
+ */
+static int compare(pse_population *pop, pse_population *expected, char *what) {
+	unsigned int width;
+	unsigned int i;
+	int failures = 0;
+
+	for (i = 0; i < expected->column_count; i++) {
+		width = (expected->columns[i].storage == PSE_VAR_INT) ? sizeof(int) : sizeof(double);
+
+		if (memcmp(pse_pop_column(pop, i).cdouble_a, pse_pop_column(expected, i).cdouble_a,
+					(size_t) width*TEST_AGENTS) != 0) {
+			fprintf(stderr, "[PSE Test] %s: column %s differs.\n", what,
+					expected->columns[i].name);
+			failures++;
+		}
+	}
+
+	return failures;
+}
+
+/*
+ * Observe each column in turn, as a step does, with the clocked columns last
+ */
+static int observe_in_turn(pse_population *pop, test_columns *cols) {
+	pse_varid order[] = {cols->wealth, cols->visits, cols->trials, cols->dt,
+							cols->choice, cols->price, cols->rate};
+	pse_content in_place;
+	pse_error errno;
+	int failures = 0;
+	unsigned int i;
+
+	in_place.cdouble_a = NULL;
+
+	for (i = 0; i < sizeof(order)/sizeof(pse_varid); i++) {
+		pse_pop_observe(pop, order[i], in_place, pop->columns[order[i]].storage, &errno);
+		failures += check(errno, PSE_ERROR_OK, "observe");
+	}
+
+	return failures;
+}
+
+int main(int argc, char **argv) {
+	pse_population reference;
+	pse_population stepped;
+	pse_population mapped;
+	test_columns cols;
+	pse_content in_place;
+	pse_error errno;
+	int failures = 0;
+	unsigned int t;
+	unsigned int s;
+
+	failures += build(&reference, &cols);
+
+	for (s = 0; s < TEST_STEPS; s++)
+		failures += observe_in_turn(&reference, &cols);
+
+	/*
+	 * Steps do not depend on the number of threads
+	 */
+	for (t = 0; t < sizeof(thread_counts)/sizeof(unsigned int); t++) {
+		failures += build(&stepped, &cols);
+
+		for (s = 0; s < TEST_STEPS; s++) {
+			pse_pop_step(&stepped, thread_counts[t], &errno);
+			failures += check(errno, PSE_ERROR_OK, "step");
+		}
+
+		if (compare(&stepped, &reference, "step") != 0) {
+			fprintf(stderr, "[PSE Test] Steps on %u thread(s) differ.\n", thread_counts[t]);
+			failures++;
+		}
+
+		pse_pop_finalize(&stepped);
+	}
+
+	/*
+	 * A mapped snapshot resumes where the original goes, once supplied
+	 */
+	failures += build(&stepped, &cols);
+	pse_pop_step(&stepped, 4, &errno);
+	failures += check(errno, PSE_ERROR_OK, "step before snapshot");
+	failures += check(pse_pop_snapshot(&stepped, TEST_FILE), PSE_ERROR_OK, "snapshot");
+
+	mapped.state = CREATED;
+	failures += check(pse_pop_map(&mapped, TEST_FILE), PSE_ERROR_OK, "map");
+	remove(TEST_FILE);
+
+	for (s = 0; s < TEST_STEPS; s++) {
+		pse_pop_step(&stepped, 4, &errno);
+		failures += check(errno, PSE_ERROR_OK, "step original");
+	}
+
+	in_place.cdouble_a = NULL;
+	pse_pop_observe(&mapped, cols.price, in_place, PSE_VAR_DOUBLE, &errno);
+	failures += check(errno, PSE_ERROR_SAMPLER_MISSING, "observe without model");
+	pse_pop_step(&mapped, 4, &errno);
+	failures += check(errno, PSE_ERROR_SAMPLER_MISSING, "step without model");
+
+	failures += supply(&mapped, &cols);
+
+	for (s = 0; s < TEST_STEPS; s++) {
+		pse_pop_step(&mapped, 2, &errno);
+		failures += check(errno, PSE_ERROR_OK, "step mapped");
+	}
+
+	failures += compare(&mapped, &stepped, "mapped");
+
+	pse_pop_finalize(&reference);
+	pse_pop_finalize(&stepped);
+	pse_pop_finalize(&mapped);
+
+	fprintf(stderr, "[PSE Test] %s: %d failure(s).\n", failures == 0 ? "Passed" : "Failed",
+			failures);
+
+	return failures == 0 ? 0 : 1;
+}
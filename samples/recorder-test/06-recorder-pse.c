@@ -0,0 +1,325 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <pse.h>
+#include <pserec.h>
+
+#define ERROR_BUFF_SIZE 200
+#define TEST_THREADS	(PSE_REC_RINGS + 1)
+#define TEST_DRAWS		(3*PSE_REC_RING)
+#define TEST_SEED		131
+#define TEST_TICK		17
+#define TEST_FILE		"06-recorder-pse.rec"
+#define TEST_FULL		"/dev/full"
+#define TEST_FULL_DRAWS	16
+#define TEST_MISSING	"missing/06-recorder-pse.rec"
+
+/*
+ * Purpose of the test:
+ * --------------------
+ *
+ * Record from one thread per agent into a single recorder, one thread more
+ * than there are rings, while the writer is held back until some thread has
+ * stalled on a full ring. Then close the recorder, parse its header and
+ * blocks, and check that every agent but one was recorded in full, that the
+ * entries of the remaining one were dropped, that at least one stall was
+ * counted and that the recorded values are those a twin stub without a
+ * recorder draws on the same seed. Finally check that a recorder reports
+ * PSE_ERROR_IO when its file cannot be opened, or when the entries it still
+ * buffers cannot be flushed on closing.
+ */
+typedef struct test_agent {
+	pse_agent_stub stub;
+	pse_varid wealth;
+	pse_varid visits;
+	pse_error error;
+} test_agent;
+
+static test_agent agents[TEST_THREADS];
+static double recorded[TEST_THREADS][TEST_DRAWS];
+static unsigned int recorded_count[TEST_THREADS];
+static pthread_barrier_t claimed;
+static pthread_barrier_t released;
+
+static int check(pse_error errno, pse_error expected, char *what) {
+	char errmsg[ERROR_BUFF_SIZE];
+
+	if (errno == expected)
+		return 0;
+
+	pse_error_log(errno, errmsg, what);
+	fprintf(stderr, "%s", errmsg);
+
+	return 1;
+}
+
+/*
+ * A started stub with a double and an int variable, seeded by its agent
+ */
+static int build(test_agent *a, unsigned int agent) {
+	double wealth_params[PSE_MAX_DIST_PARAMS] = {100.0,10.0,0.0,0.0,0.0};
+	double visits_params[PSE_MAX_DIST_PARAMS] = {3.5,0.0,0.0,0.0,0.0};
+	double array_params[PSE_MAX_DIST_PARAMS] = {0.0,0.0,0.0,0.0,0.0};
+	int failures = 0;
+
+	a->error = PSE_ERROR_OK;
+	a->stub.state = CREATED;
+	failures += check(pse_init(&a->stub), PSE_ERROR_OK, "init");
+
+	a->wealth = pse_register(&a->stub, PSE_VAR_DOUBLE, PSE_VAR_STOCHASTIC, PSE_AGENT,
+					PSE_DIST_NORMAL, wealth_params, PSE_SCALAR, 1,
+					PSE_FALSE, PSE_DIST_NONE, array_params, "wealth");
+	a->visits = pse_register(&a->stub, PSE_VAR_INT, PSE_VAR_STOCHASTIC, PSE_AGENT,
+					PSE_DIST_POISSON, visits_params, PSE_SCALAR, 1,
+					PSE_FALSE, PSE_DIST_NONE, array_params, "visits");
+
+	if (a->wealth < 0 || a->visits < 0) {
+		fprintf(stderr, "[PSE Test] Registration failed.\n");
+		return failures + 1;
+	}
+
+	failures += check(pse_start_rng(&a->stub, PSE_RNG_PHILOX, TEST_SEED, agent),
+					PSE_ERROR_OK, "start");
+
+	return failures;
+}
+
+/*
+ * The i-th observation of an agent, alternating between its variables
+ */
+static double draw(test_agent *a, unsigned int i, pse_error *error) {
+	if (i % 2 == 0)
+		return pse_observe_double(&a->stub, a->wealth, 0, error);
+	else
+		return (double) pse_observe_int(&a->stub, a->visits, 0, error);
+}
+
+/*
+ * Claim a ring with the first observation, then wait for the writer to be
+ * held back before recording the rest
+ */
+static void * record(void *data) {
+	test_agent *a = (test_agent *) data;
+	pse_error error;
+	unsigned int i;
+
+	draw(a, 0, &error);
+	a->error = error;
+
+	pthread_barrier_wait(&claimed);
+	pthread_barrier_wait(&released);
+
+	for (i = 1; i < TEST_DRAWS; i++) {
+		draw(a, i, &error);
+
+		if (error != PSE_ERROR_OK)
+			a->error = error;
+	}
+
+	return NULL;
+}
+
+/*
+ * Read the recorder file back, sorting values by agent. Returns the number
+ * of failures.
+ */
+static int parse(char *path) {
+	static unsigned long long ticks[PSE_REC_RING];
+	static unsigned int agent_ids[PSE_REC_RING];
+	static pse_varid varids[PSE_REC_RING];
+	static unsigned int locations[PSE_REC_RING];
+	static double values[PSE_REC_RING];
+	pse_rec_header header;
+	pse_rec_block block;
+	unsigned int agent;
+	unsigned int n;
+	unsigned int i;
+	int failures = 0;
+	FILE *fp;
+
+	fp = fopen(path, "rb");
+
+	if (fp == NULL) {
+		fprintf(stderr, "[PSE Test] Cannot open %s.\n", path);
+		return 1;
+	}
+
+	if (fread(&header, sizeof(pse_rec_header), 1, fp) != 1 ||
+		strcmp(header.magic, PSE_REC_MAGIC) != 0 || header.version != PSE_REC_VERSION ||
+		header.byte_order != PSE_REC_BYTE_ORDER) {
+		fprintf(stderr, "[PSE Test] Bad header.\n");
+		fclose(fp);
+		return 1;
+	}
+
+	while (fread(&block, sizeof(pse_rec_block), 1, fp) == 1) {
+		n = block.count;
+
+		if (n == 0 || n > PSE_REC_RING || block.ring >= PSE_REC_RINGS ||
+			fread(ticks, sizeof(unsigned long long), n, fp) != n ||
+			fread(agent_ids, sizeof(unsigned int), n, fp) != n ||
+			fread(varids, sizeof(pse_varid), n, fp) != n ||
+			fread(locations, sizeof(unsigned int), n, fp) != n ||
+			fread(values, sizeof(double), n, fp) != n) {
+			fprintf(stderr, "[PSE Test] Bad block.\n");
+			fclose(fp);
+			return failures + 1;
+		}
+
+		for (i = 0; i < n; i++) {
+			agent = agent_ids[i];
+
+			if (agent >= TEST_THREADS || recorded_count[agent] == TEST_DRAWS ||
+				ticks[i] != TEST_TICK || locations[i] != 0 ||
+				varids[i] != ((recorded_count[agent] % 2 == 0) ?
+					agents[agent].wealth : agents[agent].visits)) {
+				fprintf(stderr, "[PSE Test] Bad entry %u of ring %u.\n", i, block.ring);
+				failures++;
+				continue;
+			}
+
+			recorded[agent][recorded_count[agent]++] = values[i];
+		}
+	}
+
+	fclose(fp);
+
+	return failures;
+}
+
+int main(int argc, char **argv) {
+	pthread_t threads[TEST_THREADS];
+	pse_recorder rec;
+	test_agent twin;
+	pse_error errno;
+	unsigned long long stalls;
+	unsigned int missing = 0;
+	unsigned int agent;
+	unsigned int r;
+	unsigned int i;
+	int failures = 0;
+
+	failures += check(pse_rec_open(&rec, TEST_FILE), PSE_ERROR_OK, "open");
+	pse_rec_tick(&rec, TEST_TICK);
+
+	for (agent = 0; agent < TEST_THREADS; agent++) {
+		failures += build(&agents[agent], agent);
+		failures += check(pse_rec_attach(&agents[agent].stub, &rec, agent), PSE_ERROR_OK,
+						"attach");
+	}
+
+	pthread_barrier_init(&claimed, NULL, TEST_THREADS + 1);
+	pthread_barrier_init(&released, NULL, TEST_THREADS + 1);
+
+	for (agent = 0; agent < TEST_THREADS; agent++)
+		pthread_create(&threads[agent], NULL, record, &agents[agent]);
+
+	/*
+	 * Holding the lock of the recorder keeps its writer from waking, so the
+	 * threads fill their rings and stall
+	 */
+	pthread_barrier_wait(&claimed);
+	pthread_mutex_lock(&rec.lock);
+	pthread_barrier_wait(&released);
+
+	for (stalls = 0; stalls == 0; sched_yield()) {
+		for (r = 0; r < rec.ring_count; r++)
+			stalls += __atomic_load_n(&rec.rings[r]->stalls, __ATOMIC_RELAXED);
+	}
+
+	pthread_mutex_unlock(&rec.lock);
+
+	for (agent = 0; agent < TEST_THREADS; agent++) {
+		pthread_join(threads[agent], NULL);
+		failures += check(agents[agent].error, PSE_ERROR_OK, "observe");
+	}
+
+	pthread_barrier_destroy(&claimed);
+	pthread_barrier_destroy(&released);
+
+	failures += check(pse_rec_close(&rec), PSE_ERROR_OK, "close");
+
+	if (rec.stalls == 0) {
+		fprintf(stderr, "[PSE Test] No stall was counted.\n");
+		failures++;
+	}
+
+	if (rec.dropped != TEST_DRAWS) {
+		fprintf(stderr, "[PSE Test] %llu entries dropped instead of %u.\n", rec.dropped,
+				TEST_DRAWS);
+		failures++;
+	}
+
+	failures += parse(TEST_FILE);
+	remove(TEST_FILE);
+
+	/*
+	 * Every agent but the one without a ring is recorded in full, with the
+	 * values of a twin stub without a recorder
+	 */
+	for (agent = 0; agent < TEST_THREADS; agent++) {
+		if (recorded_count[agent] == 0) {
+			missing++;
+			continue;
+		}
+
+		if (recorded_count[agent] != TEST_DRAWS) {
+			fprintf(stderr, "[PSE Test] Agent %u has %u entries instead of %u.\n", agent,
+					recorded_count[agent], TEST_DRAWS);
+			failures++;
+			continue;
+		}
+
+		failures += build(&twin, agent);
+
+		for (i = 0; i < TEST_DRAWS; i++) {
+			if (draw(&twin, i, &errno) != recorded[agent][i]) {
+				fprintf(stderr, "[PSE Test] Agent %u entry %u differs.\n", agent, i);
+				failures++;
+				break;
+			}
+		}
+
+		pse_finalize(&twin.stub);
+	}
+
+	if (missing != 1) {
+		fprintf(stderr, "[PSE Test] %u agents unrecorded instead of 1.\n", missing);
+		failures++;
+	}
+
+	for (agent = 0; agent < TEST_THREADS; agent++)
+		pse_finalize(&agents[agent].stub);
+
+	/*
+	 * Files that cannot be opened are reported, and so are entries small
+	 * enough to stay in the buffer of the file until closing
+	 */
+	failures += check(pse_rec_open(&rec, TEST_MISSING), PSE_ERROR_IO, "open missing");
+
+	failures += check(pse_rec_open(&rec, TEST_FULL), PSE_ERROR_OK, "open full");
+	failures += build(&twin, 0);
+	failures += check(pse_rec_attach(&twin.stub, &rec, 0), PSE_ERROR_OK, "attach full");
+
+	for (i = 0; i < TEST_FULL_DRAWS; i++)
+		draw(&twin, i, &errno);
+
+	failures += check(pse_rec_close(&rec), PSE_ERROR_IO, "close full");
+	pse_finalize(&twin.stub);
+
+	fprintf(stderr, "[PSE Test] %s: %d failure(s).\n", failures == 0 ? "Passed" : "Failed",
+			failures);
+
+	return failures == 0 ? 0 : 1;
+}
@@ -46,6 +46,7 @@ int main(int argc, char **argv) {
 	int varid_time;
 
 	int i;
+	pse_time observed_time;
 
 	/*
 	 * Error handling
@@ -61,8 +62,9 @@ int main(int argc, char **argv) {
 //	fprintf(stderr, "%s", errmsg);
 
 	/*
-	 * Initialize the PSE
+	 * Initialize the PSE. Stubs on the stack must start in the CREATED state.
 	 */
+	test_pse.state = CREATED;
 	errno = pse_init(&test_pse);
 	pse_error_log(errno, errmsg, "init");
 	fprintf(stderr, "%s", errmsg);
@@ -132,9 +134,9 @@ int main(int argc, char **argv) {
 	/*
 	 * Observe double variables iteratively
 	 */
-	for (i = 0; i < TEST_CYCLES; i++) {
-		temp_var = pse_template(temp_var,test_pse.variables[varid_double]);
+	temp_var = pse_template(temp_var,test_pse.variables[varid_double]);
 
+	for (i = 0; i < TEST_CYCLES; i++) {
 		pse_observe(&test_pse, varid_double, 0, temp_var, &errno);
 		pse_error_log(errno, errmsg, "observe distance");
 		fprintf(stderr, "%s", errmsg);
@@ -145,16 +147,16 @@ int main(int argc, char **argv) {
 			printf("[PSE Runtime] Iteration: %d\tRead double (stored) value: %lf\n", i,
 					pse_read_double(&test_pse, varid_double));
 		}
-
-		pse_scratch(temp_var);
 	}
 
+	pse_scratch(temp_var);
+
 	/*
 	 * Observe int variables iteratively
 	 */
-	for (i = 0; i < TEST_CYCLES; i++) {
-		temp_var = pse_template(temp_var,test_pse.variables[varid_int]);
+	temp_var = pse_template(temp_var,test_pse.variables[varid_int]);
 
+	for (i = 0; i < TEST_CYCLES; i++) {
 		pse_observe(&test_pse, varid_int, 0, temp_var, &errno);
 		pse_error_log(errno, errmsg, "observe hopping_step");
 		fprintf(stderr, "%s", errmsg);
@@ -165,25 +167,21 @@ int main(int argc, char **argv) {
 			printf("[PSE Runtime] Iteration: %d\tRead int (stored) value: %d\n", i,
 					pse_read_int(&test_pse, varid_int));
 		}
-
-		pse_scratch(temp_var);
 	}
 
+	pse_scratch(temp_var);
+
 	/*
 	 * Observe time variables iteratively
 	 */
 	for (i = 0; i < TEST_CYCLES; i++) {
-		temp_var = pse_template(temp_var,test_pse.variables[varid_time]);
-
-		pse_observe(&test_pse, varid_time, 0, temp_var, &errno);
+		observed_time = pse_observe_time(&test_pse, varid_time, 0, &errno);
 		pse_error_log(errno, errmsg, "observe deterministic_time");
 		fprintf(stderr, "%s", errmsg);
 
 		if (errno == PSE_ERROR_OK)
 			printf("[PSE Runtime] Iteration: %d\tRead time value: %lf\n", i,
-					pse_read_time(&test_pse, varid_time));
-
-		pse_scratch(temp_var);
+					observed_time);
 	}
 
 	/*
@@ -8,12 +8,19 @@
  * Author: Santiago Nunez-Corrales
  */
 #include <ranlib.h>
+#include <ranlib_r8.h>
 #include <rnglib.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
 #include <pse.h>
+#include <psesimd.h>
+#include <pserec.h>
+#include <psesde.h>
+#include <psetable.h>
+#include <psedraw.h>
+#include "pseint.h"
 
 /*
  * Declaration of private functions
@@ -27,13 +34,37 @@
  * 2. Additionaly, we provide randomization alternatives for compute an update
  * 	  or compute and discard.
  */
-int pse_sizeof(pse_variable *);
 unsigned int pse_is_world_var(pse_variable *);
-int pse_sample_int_distribution(int, double *, pse_distribution_type);
+pse_error pse_grow_variables(pse_agent_stub *);
+void pse_drop_dependencies(pse_agent_stub *, pse_varid);
+int pse_sample_int_distribution(int, double *, pse_distribution_type,
+						pse_sampler_cache *);
+int pse_sample_binomial_self(int, double, pse_sampler_cache *);
 unsigned int pse_is_int_distribution(pse_distribution_type);
-double pse_sample_double_distribution(double, double *, pse_distribution_type);
-void pse_randomize(pse_variable *, pse_variable *, unsigned int location);
-void pse_randomize_and_alter(pse_variable *, pse_variable *, unsigned int location, pse_error *error);
+double pse_sample_double_distribution(double, double *, pse_distribution_type,
+						pse_sampler_type);
+void pse_sde_coefficients(unsigned int, double *, double *, pse_sampler_cache *,
+						double *, double *);
+double pse_sde_dt(double *, pse_sampler_cache *);
+void pse_randomize(pse_variable *, pse_variable *, unsigned int location,
+						pse_sampler_type);
+void pse_randomize_and_alter(pse_variable *, pse_variable *, unsigned int location,
+						pse_sampler_type, pse_error *error);
+void pse_rng_reserve(pse_agent_stub *, pse_varid, unsigned int);
+void pse_sample_int_batch(pse_agent_stub *, pse_varid, int, double *,
+						unsigned int, int *, unsigned int);
+void pse_sample_double_batch(pse_agent_stub *, pse_varid, double, double *,
+						unsigned int, double *, unsigned int);
+pse_variable * pse_observe_target(pse_agent_stub *, pse_varid, unsigned int,
+						pse_storage_type, pse_error *);
+double pse_observe_number(pse_agent_stub *, pse_varid, unsigned int,
+						pse_storage_type, pse_error *);
+void pse_copy_content(pse_variable *, pse_variable *, unsigned int);
+void pse_record(pse_agent_stub *, pse_varid, unsigned int, pse_variable *);
+void pse_record_batch(pse_agent_stub *, pse_varid, unsigned int, pse_content,
+						unsigned int, pse_storage_type);
+void pse_randomize_conditional(pse_variable *, pse_variable *, unsigned int,
+						double *, pse_sampler_cache *);
 
 /*
  * Calculate the size of registered content
@@ -70,6 +101,295 @@ int pse_sizeof(pse_variable *var) {
 	}
 }
 
+/*
+ * Map an arbitrary seed into the valid range of a generator component. Seeds
+ * already in range are kept as given.
+ */
+int pse_fold_seed(int seed, int modulus) {
+	if (seed >= 1 && seed < modulus)
+		return seed;
+
+	return 1 + (int)((unsigned int)seed % (unsigned int)(modulus - 1));
+}
+
+/*
+ * Advance the sampling step of a variable. With the counter-based generator,
+ * the draws that follow come from the stream (variable id, step).
+ */
+void pse_rng_position(pse_agent_stub *pse, pse_varid varid) {
+	pse_variable *var = pse->variables[varid];
+
+	if (pse->rng.backend == RNG_BACKEND_PHILOX)
+		rng_philox_set_counter((unsigned int)varid, (unsigned int)var->step,
+								(unsigned int)(var->step >> 32));
+
+	var->step++;
+}
+
+/*
+ * Reserve the steps of a whole batch at once. With the counter-based
+ * generator the batch draws from the stream of its first step; the steps that
+ * follow are skipped so that later observations remain independent.
+ */
+void pse_rng_reserve(pse_agent_stub *pse, pse_varid varid, unsigned int count) {
+	if (count == 0)
+		return;
+
+	pse_rng_position(pse, varid);
+	pse->variables[varid]->step += count - 1;
+}
+
+/*
+ * A variable identifier is valid if it falls within the registered range and
+ * has not been deregistered.
+ */
+unsigned int pse_is_registered(pse_agent_stub *pse, pse_varid varid) {
+	if (varid < 0 || (unsigned int)varid >= pse->var_limit)
+		return PSE_FALSE;
+
+	if (pse->variables[varid] == NULL)
+		return PSE_FALSE;
+
+	return PSE_TRUE;
+}
+
+/*
+ * Double the capacity of the variable and dependency arrays. New slots are
+ * empty, and their dependencies zeroed: checkpoints store the dependency of
+ * every variable, with or without dependencies.
+ */
+pse_error pse_grow_variables(pse_agent_stub *pse) {
+	unsigned int capacity;
+	unsigned int i;
+	pse_variable **variables;
+	pse_dependency *dependencies;
+
+	capacity = (pse->var_capacity == 0) ? PSE_INITIAL_VARIABLES : 2*pse->var_capacity;
+
+	variables = (pse_variable **) realloc(pse->variables, sizeof(pse_variable *)*capacity);
+
+	if (variables == NULL)
+		return PSE_ERROR_TOO_MANY_VARIABLES;
+
+	pse->variables = variables;
+
+	dependencies = (pse_dependency *) realloc(pse->dependencies,
+							sizeof(pse_dependency)*capacity);
+
+	if (dependencies == NULL)
+		return PSE_ERROR_TOO_MANY_VARIABLES;
+
+	pse->dependencies = dependencies;
+
+	for (i = pse->var_capacity; i < capacity; i++)
+		pse->variables[i] = NULL;
+
+	memset(&dependencies[pse->var_capacity], 0,
+			sizeof(pse_dependency)*(capacity - pse->var_capacity));
+
+	pse->var_capacity = capacity;
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Remove the conditionals of a variable from the pool. Runs stored after it
+ * are moved down, so the pool stays compact.
+ */
+void pse_drop_dependencies(pse_agent_stub *pse, pse_varid varid) {
+	pse_dependency *dep = &(pse->dependencies[varid]);
+	unsigned int end = dep->offset + dep->count;
+	unsigned int i;
+
+	memmove(pse->conditionals + dep->offset, pse->conditionals + end,
+							sizeof(pse_depid)*(pse->cond_count - end));
+	memmove(pse->evidence + dep->offset, pse->evidence + end,
+							sizeof(unsigned int)*(pse->cond_count - end));
+	pse->cond_count -= dep->count;
+
+	for (i = 0; i < pse->var_limit; i++) {
+		if (pse->variables[i] != NULL &&
+			pse->variables[i]->has_dependencies == PSE_TRUE &&
+			pse->dependencies[i].offset >= end)
+			pse->dependencies[i].offset -= dep->count;
+	}
+
+	dep->count = 0;
+	dep->offset = 0;
+	dep->priors = NULL;
+	dep->prior_pending = PSE_FALSE;
+	dep->evaluated = PSE_FALSE;
+
+	pse->variables[varid]->has_dependencies = PSE_FALSE;
+}
+
+/*
+ * Dependency graph
+ *
+ * Edges go from each conditional to the variables that depend on it. They are
+ * counted, then laid out in compressed form, and Kahn's algorithm visits every
+ * variable once all of its conditionals have been visited. It proceeds in
+ * rounds, each visiting what the previous round released, and the variables
+ * with dependencies of one round form a level. Variables that are never
+ * visited lie on a cycle. Conditionals deregistered since they were
+ * added are left out, as they are when the evidence is gathered.
+ */
+pse_error pse_build_graph(pse_agent_stub *pse) {
+	unsigned int *offsets;
+	unsigned int *pending;
+	unsigned int *queue;
+	unsigned int *levels;
+	pse_varid *dependents;
+	pse_varid *order;
+	pse_dependency *dep;
+	pse_depid conditional;
+	unsigned int edges = 0;
+	unsigned int visited = 0;
+	unsigned int count = 0;
+	unsigned int level_count = 0;
+	unsigned int head = 0;
+	unsigned int tail = 0;
+	unsigned int round;
+	unsigned int first;
+	unsigned int i;
+	unsigned int j;
+
+	offsets = (unsigned int *) calloc(pse->var_limit + 1, sizeof(unsigned int));
+	pending = (unsigned int *) calloc(pse->var_limit + 1, sizeof(unsigned int));
+	queue = (unsigned int *) malloc(sizeof(unsigned int)*(pse->var_limit + 1));
+	order = (pse_varid *) malloc(sizeof(pse_varid)*(pse->var_limit + 1));
+	levels = (unsigned int *) malloc(sizeof(unsigned int)*(pse->var_limit + 2));
+	dependents = (pse_varid *) malloc(sizeof(pse_varid)*(pse->cond_count + 1));
+
+	if (offsets == NULL || pending == NULL || queue == NULL || order == NULL ||
+		levels == NULL || dependents == NULL) {
+		free(offsets);
+		free(pending);
+		free(queue);
+		free(order);
+		free(levels);
+		free(dependents);
+		return PSE_ERROR_TOO_MANY_VARIABLES;
+	}
+
+	for (i = 0; i < pse->var_limit; i++) {
+		if (pse->variables[i] == NULL || pse->variables[i]->has_dependencies == PSE_FALSE)
+			continue;
+
+		dep = &(pse->dependencies[i]);
+
+		for (j = 0; j < dep->count; j++) {
+			conditional = pse->conditionals[dep->offset + j];
+
+			if (pse_is_registered(pse, conditional) == PSE_TRUE) {
+				offsets[conditional + 1]++;
+				pending[i]++;
+				edges++;
+			}
+		}
+	}
+
+	for (i = 0; i < pse->var_limit; i++) {
+		offsets[i + 1] += offsets[i];
+		queue[i] = offsets[i];
+	}
+
+	for (i = 0; i < pse->var_limit; i++) {
+		if (pse->variables[i] == NULL || pse->variables[i]->has_dependencies == PSE_FALSE)
+			continue;
+
+		dep = &(pse->dependencies[i]);
+
+		for (j = 0; j < dep->count; j++) {
+			conditional = pse->conditionals[dep->offset + j];
+
+			if (pse_is_registered(pse, conditional) == PSE_TRUE)
+				dependents[queue[conditional]++] = i;
+		}
+	}
+
+	/*
+	 * The queue is reused for the traversal
+	 */
+	for (i = 0; i < pse->var_limit; i++) {
+		if (pse->variables[i] != NULL && pending[i] == 0)
+			queue[tail++] = i;
+	}
+
+	while (head < tail) {
+		round = tail;
+		first = count;
+
+		while (head < round) {
+			i = queue[head++];
+			visited++;
+
+			if (pse->variables[i]->has_dependencies == PSE_TRUE)
+				order[count++] = i;
+
+			for (j = offsets[i]; j < offsets[i + 1]; j++) {
+				if (--pending[dependents[j]] == 0)
+					queue[tail++] = dependents[j];
+			}
+		}
+
+		if (count > first)
+			levels[level_count++] = first;
+	}
+
+	levels[level_count] = count;
+
+	free(pending);
+	free(queue);
+
+	if (visited < pse->var_count) {
+		free(offsets);
+		free(order);
+		free(levels);
+		free(dependents);
+		return PSE_ERROR_DEPENDENCY_CYCLE;
+	}
+
+	pse_release_graph(pse);
+	pse->dependent_offsets = offsets;
+	pse->dependents = dependents;
+	pse->order = order;
+	pse->order_count = count;
+	pse->level_offsets = levels;
+	pse->level_count = level_count;
+
+	return PSE_ERROR_OK;
+}
+
+void pse_release_graph(pse_agent_stub *pse) {
+	free(pse->dependent_offsets);
+	free(pse->dependents);
+	free(pse->order);
+	free(pse->level_offsets);
+	pse->dependent_offsets = NULL;
+	pse->dependents = NULL;
+	pse->order = NULL;
+	pse->order_count = 0;
+	pse->level_offsets = NULL;
+	pse->level_count = 0;
+}
+
+/*
+ * Mark the dependents of a variable whose stored value has been written.
+ * Only direct dependents are marked: the evidence of a dependency is the
+ * stored values of its conditionals, and those further down change only when
+ * their own conditionals are written to, which marks them in turn.
+ */
+void pse_touch(pse_agent_stub *pse, pse_varid varid) {
+	unsigned int i;
+
+	if (pse->dependent_offsets == NULL)
+		return;
+
+	for (i = pse->dependent_offsets[varid]; i < pse->dependent_offsets[varid + 1]; i++)
+		pse->dependencies[pse->dependents[i]].dirty = PSE_TRUE;
+}
+
 unsigned int pse_is_world_var(pse_variable *var) {
 	if (var->locality == PSE_WORLD)
 		return PSE_TRUE;
@@ -78,144 +398,620 @@ unsigned int pse_is_world_var(pse_variable *var) {
 }
 
 /*
- * Obtain a random number from one amongst many integer distributions
+ * Bring the sampler constants of a variable up to date with its parameters.
+ * Distributions without constants leave the cache untouched.
  */
-int pse_sample_int_distribution(int value, double *pars,
-										pse_distribution_type distribution) {
-	int min;
-	int max;
-	double p;
-	double mu;
+void pse_refresh_cache(pse_distribution_type distribution, double *pars,
+						pse_sampler_cache *cache) {
+	int n;
 
 	switch(distribution) {
-	case PSE_DIST_UNIFORM_INT_SELF:
-		min = 0;
-		return ignuin(min, value);
+	case PSE_DIST_BINOMIAL:
+		n = round(pars[0]);
+		if (cache->binomial.n != n || cache->binomial.pp != pars[1])
+			ignbin_setup_r8(n, pars[1], &cache->binomial);
+		break;
+	case PSE_DIST_POISSON:
+		if (cache->poisson.mu != pars[0])
+			ignpoi_setup_r8(pars[0], &cache->poisson);
+		break;
+	default:
 		break;
+	}
+}
+
+/*
+ * Release what the cache of a variable holds beyond its own storage
+ */
+void pse_release_cache(pse_distribution_type distribution, pse_sampler_cache *cache) {
+	if (distribution == PSE_DIST_BINOMIAL_SELF) {
+		free(cache->binomial_by_n);
+		cache->binomial_by_n = NULL;
+	} else if (distribution == PSE_DIST_TABLE_INT || distribution == PSE_DIST_TABLE_DOUBLE) {
+		pse_table_release(cache->table);
+		cache->table = NULL;
+	}
+}
+
+/*
+ * Binomial draw with n trials for BINOMIAL_SELF. Without a cache of setups
+ * indexed by n (e.g. in population columns), the setup is computed each time.
+ */
+int pse_sample_binomial_self(int n, double p, pse_sampler_cache *cache) {
+	binomial_r8_setup *setup;
+
+	if (cache == NULL || cache->binomial_by_n == NULL || n < 0)
+		return ignbin_r8(n, p);
+
+	setup = &(cache->binomial_by_n[(((unsigned int) n*2654435761u) >> 16) %
+										PSE_BINOMIAL_CACHE]);
+
+	if (setup->n != n || setup->pp != p)
+		ignbin_setup_r8(n, p, setup);
+
+	return ignbin_draw_r8(setup);
+}
+
+/*
+ * Specialized samplers
+ *
+ * There is one routine per distribution (and per normal/exponential sampler
+ * type). pse_register() resolves the routine of a variable once, so that an
+ * observation is a single indirect call instead of nested switches. All share
+ * the signature of pse_int_sampler or pse_double_sampler: the current value,
+ * the point parameters and the sampler cache of the variable, which may be
+ * NULL when there is none. Parameter names are preserved for clarity.
+ */
+int pse_draw_uniform_int_self(int value, double *pars, pse_sampler_cache *cache) {
+	return ignuin(0, value);
+}
+
+int pse_draw_uniform_int_bounded(int value, double *pars, pse_sampler_cache *cache) {
+	int min = round(pars[0]);
+	int max = round(pars[1]);
+
+	return ignuin(min, max);
+}
+
+int pse_draw_bernoulli(int value, double *pars, pse_sampler_cache *cache) {
+	double p = pars[0];
+
+	return r8_uni_01() > p ? PSE_HEADS : PSE_TAILS;
+}
+
+int pse_draw_binomial(int value, double *pars, pse_sampler_cache *cache) {
+	if (cache == NULL)
+		return ignbin_r8(round(pars[0]), pars[1]);
+
+	pse_refresh_cache(PSE_DIST_BINOMIAL, pars, cache);
+
+	return ignbin_draw_r8(&cache->binomial);
+}
+
+int pse_draw_binomial_self(int value, double *pars, pse_sampler_cache *cache) {
+	return pse_sample_binomial_self(value, pars[0], cache);
+}
+
+int pse_draw_neg_binomial(int value, double *pars, pse_sampler_cache *cache) {
+	double p = pars[0];
+	int max = round(pars[1]);
+
+	return ignnbn_r8(max, p);
+}
+
+int pse_draw_neg_binomial_self(int value, double *pars, pse_sampler_cache *cache) {
+	return ignnbn_r8(value, pars[0]);
+}
+
+int pse_draw_poisson(int value, double *pars, pse_sampler_cache *cache) {
+	if (cache == NULL)
+		return ignpoi_r8(pars[0]);
+
+	pse_refresh_cache(PSE_DIST_POISSON, pars, cache);
+
+	return ignpoi_draw_r8(&cache->poisson);
+}
+
+int pse_draw_poisson_self(int value, double *pars, pse_sampler_cache *cache) {
+	return ignpoi_r8(value);
+}
+
+/*
+ * Without a sampler, CUSTOM variables keep their value
+ */
+int pse_draw_int_custom(int value, double *pars, pse_sampler_cache *cache) {
+	double v = value;
+
+	if (cache == NULL || cache->custom == NULL)
+		return value;
+
+	cache->custom(rng_state_get(), pars, &v, &v, 1);
+
+	return round(v);
+}
+
+/*
+ * Without a table, tabulated variables keep their value
+ */
+int pse_draw_table_int(int value, double *pars, pse_sampler_cache *cache) {
+	if (cache == NULL || cache->table == NULL)
+		return value;
+
+	return pse_table_draw_int(cache->table);
+}
+
+int pse_draw_int_none(int value, double *pars, pse_sampler_cache *cache) {
+	return value;
+}
+
+int pse_draw_int_zero(int value, double *pars, pse_sampler_cache *cache) {
+	return 0;
+}
+
+double pse_draw_uniform_double_self(double value, double *pars, pse_sampler_cache *cache) {
+	return genunf_r8(0, value);
+}
+
+double pse_draw_uniform_double_bounded(double value, double *pars, pse_sampler_cache *cache) {
+	double min = pars[0];
+	double max = pars[1];
+
+	return genunf_r8(min, max);
+}
+
+double pse_draw_normal(double value, double *pars, pse_sampler_cache *cache) {
+	double mu = pars[0];
+	double sigma = pars[1];
+
+	return sigma*snorm_zig_r8() + mu;
+}
+
+double pse_draw_normal_classic(double value, double *pars, pse_sampler_cache *cache) {
+	double mu = pars[0];
+	double sigma = pars[1];
+
+	return gennor_r8(mu, sigma);
+}
+
+double pse_draw_normal_self(double value, double *pars, pse_sampler_cache *cache) {
+	double sigma = pars[0];
+
+	return sigma*snorm_zig_r8() + value;
+}
+
+double pse_draw_normal_self_classic(double value, double *pars, pse_sampler_cache *cache) {
+	double sigma = pars[0];
+
+	return gennor_r8(value, sigma);
+}
+
+double pse_draw_exponential(double value, double *pars, pse_sampler_cache *cache) {
+	double mu = pars[0];
+
+	return sexpo_zig_r8()*mu;
+}
+
+double pse_draw_exponential_classic(double value, double *pars, pse_sampler_cache *cache) {
+	double mu = pars[0];
+
+	return genexp_r8(mu);
+}
+
+double pse_draw_exponential_self(double value, double *pars, pse_sampler_cache *cache) {
+	return sexpo_zig_r8()*value;
+}
+
+double pse_draw_exponential_self_classic(double value, double *pars, pse_sampler_cache *cache) {
+	return genexp_r8(value);
+}
+
+/*
+ * alpha: shape constant
+ * beta: rate constant
+ *
+ * Note: parameter order in ranlib is counter-intuitive
+ */
+double pse_draw_gamma(double value, double *pars, pse_sampler_cache *cache) {
+	double alpha = pars[1];
+	double beta = pars[0];
+
+	return gengam_r8(beta, alpha);
+}
+
+double pse_draw_gamma_self(double value, double *pars, pse_sampler_cache *cache) {
+	double alpha = pars[1];
+
+	return gengam_r8(value, alpha);
+}
+
+/*
+ * F statistics are independent of value. They represent a proportion of the
+ * ratio of variations between sample and population variance for two
+ * populations.
+ */
+double pse_draw_f(double value, double *pars, pse_sampler_cache *cache) {
+	double dfn = pars[0];
+	double dfd = pars[1];
+
+	return genf_r8(dfn, dfd);
+}
+
+double pse_draw_beta(double value, double *pars, pse_sampler_cache *cache) {
+	double alpha = pars[0];
+	double beta = pars[1];
+
+	return genbet_r8(alpha, beta);
+}
+
+double pse_draw_chisq(double value, double *pars, pse_sampler_cache *cache) {
+	double df = pars[0];
+
+	return genchi_r8(df);
+}
+
+double pse_draw_chisq_self(double value, double *pars, pse_sampler_cache *cache) {
+	return genchi_r8(value);
+}
+
+/*
+ * Drift and diffusion of count values of a FOKKER_PLANCK variable (see
+ * pse_sde_setup in pse.h). Without a cache (string contents) the coefficients
+ * are affine.
+ */
+void pse_sde_coefficients(unsigned int count, double *values, double *pars,
+						pse_sampler_cache *cache, double *drift, double *diffusion) {
+	unsigned int i;
+
+	if (cache != NULL && cache->sde.model != NULL) {
+		cache->sde.model(count, values, pars, drift, diffusion);
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		drift[i] = pars[0] + pars[1]*values[i];
+		diffusion[i] = pars[2] + pars[3]*values[i];
+	}
+}
+
+double pse_sde_dt(double *pars, pse_sampler_cache *cache) {
+	if (cache != NULL && cache->sde.step != NULL)
+		return *(cache->sde.step);
+
+	return pars[4];
+}
+
+/*
+ * Euler-Maruyama step of count values, given one standard normal per value.
+ * Coefficients are evaluated a block at a time. steps holds one step per
+ * value (population clocks), or is NULL for the step of the variable. out
+ * may be values.
+ */
+void pse_sde_update(unsigned int count, double *values, double *pars,
+						pse_sampler_cache *cache, pse_time *steps, double *z, double *out) {
+	double drift[PSE_SIMD_BLOCK];
+	double diffusion[PSE_SIMD_BLOCK];
+	double dt = pse_sde_dt(pars, cache);
+	unsigned int first;
+	unsigned int n;
+	unsigned int i;
+
+	for (first = 0; first < count; first += n) {
+		n = count - first;
+
+		if (n > PSE_SIMD_BLOCK)
+			n = PSE_SIMD_BLOCK;
+
+		pse_sde_coefficients(n, values + first, pars, cache, drift, diffusion);
+
+		for (i = 0; i < n; i++) {
+			if (steps != NULL)
+				dt = steps[first + i];
+
+			out[first + i] = (dt > 0) ?
+					values[first + i] + drift[i]*dt + diffusion[i]*sqrt(dt)*z[first + i] :
+					values[first + i];
+		}
+	}
+}
+
+double pse_draw_fokker_planck(double value, double *pars, pse_sampler_cache *cache) {
+	double z = snorm_zig_r8();
+
+	pse_sde_update(1, &value, pars, cache, NULL, &z, &value);
+
+	return value;
+}
+
+double pse_draw_fokker_planck_classic(double value, double *pars, pse_sampler_cache *cache) {
+	double z = snorm_r8();
+
+	pse_sde_update(1, &value, pars, cache, NULL, &z, &value);
+
+	return value;
+}
+
+double pse_draw_custom(double value, double *pars, pse_sampler_cache *cache) {
+	if (cache != NULL && cache->custom != NULL)
+		cache->custom(rng_state_get(), pars, &value, &value, 1);
+
+	return value;
+}
+
+double pse_draw_table_double(double value, double *pars, pse_sampler_cache *cache) {
+	if (cache == NULL || cache->table == NULL)
+		return value;
+
+	return pse_table_draw_double(cache->table);
+}
+
+double pse_draw_double_none(double value, double *pars, pse_sampler_cache *cache) {
+	return value;
+}
+
+double pse_draw_double_zero(double value, double *pars, pse_sampler_cache *cache) {
+	return 0;
+}
+
+/*
+ * Resolve the specialized sampler of a distribution
+ */
+pse_int_sampler pse_resolve_int_sampler(pse_distribution_type distribution) {
+	switch(distribution) {
+	case PSE_DIST_UNIFORM_INT_SELF:
+		return pse_draw_uniform_int_self;
 	case PSE_DIST_UNIFORM_INT_BOUNDED:
-		min = round(pars[0]);
-		max = round(pars[1]);
-		return ignuin(min, max);
+		return pse_draw_uniform_int_bounded;
 	case PSE_DIST_BERNOULLI:
-		p = pars[0];
-		return genunf(0,1) > p ? PSE_HEADS : PSE_TAILS;
+		return pse_draw_bernoulli;
 	case PSE_DIST_BINOMIAL:
-		max = round(pars[0]);
-		p = pars[1];
-		return ignbin(max,p);
+		return pse_draw_binomial;
 	case PSE_DIST_BINOMIAL_SELF:
-		p = pars[0];
-		max = value;
-		return ignbin(max,p);
+		return pse_draw_binomial_self;
 	case PSE_DIST_NEG_BINOMIAL:
-		p = pars[0];
-		max = round(pars[1]);
-		return ignnbn(max,p);
+		return pse_draw_neg_binomial;
 	case PSE_DIST_NEG_BINOMIAL_SELF:
-		p = pars[0];
-		max = value;
-		return ignnbn(max,p);
+		return pse_draw_neg_binomial_self;
 	case PSE_DIST_POISSON:
-		mu = pars[0];
-		return ignpoi(mu);
+		return pse_draw_poisson;
 	case PSE_DIST_POISSON_SELF:
-		mu = value;
-		return ignpoi(mu);
+		return pse_draw_poisson_self;
+	case PSE_DIST_CUSTOM:
+		return pse_draw_int_custom;
+	case PSE_DIST_TABLE_INT:
+		return pse_draw_table_int;
 	case PSE_DIST_NONE:
-		return value;
+		return pse_draw_int_none;
 	default:
-		return 0;
+		return pse_draw_int_zero;
 	}
 }
 
-/*
- * Obtain a random number from one amongst many integer distributions
- */
-double pse_sample_double_distribution(double value, double *pars,
-										pse_distribution_type distribution) {
-	/*
-	 * Parameter names are preserved for clarity
-	 */
-	double min;
-	double max;
-	double alpha;
-	double beta;
-	double mu;
-	double sigma;
-	double dfn;
-	double dfd;
-	double df;
+pse_double_sampler pse_resolve_double_sampler(pse_distribution_type distribution,
+						pse_sampler_type sampler) {
+	unsigned int classic = (sampler == PSE_SAMPLER_CLASSIC);
 
 	switch(distribution) {
 	case PSE_DIST_UNIFORM_DOUBLE_SELF:
-		min = 0;
-		return genunf(min, value);
-		break;
+		return pse_draw_uniform_double_self;
 	case PSE_DIST_UNIFORM_DOUBLE_BOUNDED:
-		min = pars[0];
-		max = pars[1];
-		return genunf(min, max);
+		return pse_draw_uniform_double_bounded;
 	case PSE_DIST_NORMAL:
-		mu = pars[0];
-		sigma = pars[1];
-		return gennor(mu,sigma);
+		return classic ? pse_draw_normal_classic : pse_draw_normal;
 	case PSE_DIST_NORMAL_SELF:
-		mu = value;
-		sigma = pars[0];
-		return gennor(mu,sigma);
+		return classic ? pse_draw_normal_self_classic : pse_draw_normal_self;
 	case PSE_DIST_EXPONENTIAL:
-		mu = pars[0];
-		return genexp(mu);
+		return classic ? pse_draw_exponential_classic : pse_draw_exponential;
 	case PSE_DIST_EXPONENTIAL_SELF:
-		mu = value;
-		return genexp(mu);
+		return classic ? pse_draw_exponential_self_classic : pse_draw_exponential_self;
 	case PSE_DIST_GAMMA:
-		/*
-		 * alpha: shape constant
-		 * beta: rate constant
-		 *
-		 * Note: parameter order in ranlib is counter-intuitive
-		 */
-		alpha = pars[1];
-		beta = pars[0];
-		return gengam(beta, alpha);
+		return pse_draw_gamma;
 	case PSE_DIST_GAMMA_SELF:
-		alpha = pars[1];
-		beta = value;
-		return gengam(beta, alpha);
+		return pse_draw_gamma_self;
 	case PSE_DIST_F:
-		/*
-		 * F statistics are independent of value. They represent a proportion
-		 * of the ratio of variations between sample and population variance
-		 * for two populations.
-		 */
-		dfn = pars[0];
-		dfd = pars[1];
-		return genf(dfn, dfd);
+		return pse_draw_f;
 	case PSE_DIST_BETA:
-		alpha = pars[0];
-		beta = pars[1];
-		return genbet(alpha, beta);
+		return pse_draw_beta;
 	case PSE_DIST_CHISQ:
-		df = pars[0];
-		return genchi(df);
+		return pse_draw_chisq;
 	case PSE_DIST_CHISQ_SELF:
-		df = value;
-		return genchi(df);
+		return pse_draw_chisq_self;
+	case PSE_DIST_FOKKER_PLANCK:
+		return classic ? pse_draw_fokker_planck_classic : pse_draw_fokker_planck;
+	case PSE_DIST_CUSTOM:
+		return pse_draw_custom;
+	case PSE_DIST_TABLE_DOUBLE:
+		return pse_draw_table_double;
 	case PSE_DIST_NONE:
-		return value;
+		return pse_draw_double_none;
+	default:
+		return pse_draw_double_zero;
+	}
+}
+
+/*
+ * Obtain a random number from one amongst many integer distributions. When a
+ * cache is given, it holds the sampler constants for pars and is refreshed if
+ * pars have changed since. Registered variables call their resolved sampler
+ * directly; this entry point serves the parameters of string contents.
+ */
+int pse_sample_int_distribution(int value, double *pars,
+										pse_distribution_type distribution,
+										pse_sampler_cache *cache) {
+	return pse_resolve_int_sampler(distribution)(value, pars, cache);
+}
+
+/*
+ * Obtain a random number from one amongst many double distributions
+ */
+double pse_sample_double_distribution(double value, double *pars,
+										pse_distribution_type distribution,
+										pse_sampler_type sampler) {
+	return pse_resolve_double_sampler(distribution, sampler)(value, pars, NULL);
+}
+
+/*
+ * Batch versions of the samplers above. Every draw advances the sampling step
+ * and calls the resolved sampler of the variable, so a batch of N draws is
+ * identical to N single observations. When chain is set, each draw is fed
+ * with the previous one (read_and_alter), which only SELF distributions read.
+ *
+ * A few distributions take faster routes, which the switches below single
+ * out. Uniform doubles go through the vector kernels of psesimd.c, which
+ * reserve the steps of the whole batch and transform a block of uniforms at
+ * once. Those batches follow the same distribution as single observations but
+ * are not identical to them. Normal and exponential doubles take the same
+ * route under PSE_SAMPLER_CLASSIC; the Ziggurat samplers cost about as much
+ * per draw as the vector kernels and keep batches identical to single
+ * observations.
+ *
+ * FOKKER_PLANCK batches draw their standard normals first, the same way as
+ * normal batches. A chained batch is then a trajectory of count
+ * Euler-Maruyama steps; otherwise every draw is one step from the same value,
+ * whose coefficients are evaluated once.
+ *
+ * CUSTOM batches that are not chained reserve their steps like the vector
+ * kernels and call the sampler once for the whole batch (once per block of
+ * PSE_SIMD_BLOCK for integers); chained batches call it once per draw.
+ */
+void pse_sample_int_batch(pse_agent_stub *pse, pse_varid varid, int value,
+						double *pars, unsigned int chain, int *out, unsigned int count) {
+	double draws[PSE_SIMD_BLOCK];
+	unsigned int first;
+	unsigned int n;
+	unsigned int i;
+	pse_variable *var = pse->variables[varid];
+	pse_sampler_cache *cache = &(var->point_cache);
+
+	if (var->point_distribution == PSE_DIST_CUSTOM && cache->custom != NULL &&
+		chain == PSE_FALSE) {
+		pse_rng_reserve(pse, varid, count);
+		for (first = 0; first < count; first += n) {
+			n = (count - first > PSE_SIMD_BLOCK) ? PSE_SIMD_BLOCK : count - first;
+			for (i = 0; i < n; i++)
+				draws[i] = value;
+			cache->custom(rng_state_get(), pars, draws, draws, n);
+			for (i = 0; i < n; i++)
+				out[first + i] = round(draws[i]);
+		}
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		pse_rng_position(pse, varid);
+		out[i] = var->sample_int(value, pars, cache);
+		if (chain == PSE_TRUE)
+			value = out[i];
+	}
+}
+
+void pse_sample_double_batch(pse_agent_stub *pse, pse_varid varid, double value,
+						double *pars, unsigned int chain, double *out, unsigned int count) {
+	unsigned int i;
+	unsigned int classic = (pse->sampler == PSE_SAMPLER_CLASSIC);
+	double mu;
+	double sigma;
+	double dt;
+	pse_variable *var = pse->variables[varid];
+	pse_sampler_cache *cache = &(var->point_cache);
+
+	switch(var->point_distribution) {
+	case PSE_DIST_UNIFORM_DOUBLE_SELF:
+		pse_rng_reserve(pse, varid, count);
+		if (chain == PSE_TRUE) {
+			pse_simd_uniform(out, count, 0, 1);
+			for (i = 0; i < count; i++) {
+				value = value*out[i];
+				out[i] = value;
+			}
+		} else {
+			pse_simd_uniform(out, count, 0, value);
+		}
+		return;
+	case PSE_DIST_UNIFORM_DOUBLE_BOUNDED:
+		pse_rng_reserve(pse, varid, count);
+		pse_simd_uniform(out, count, pars[0], pars[1]);
+		return;
+	case PSE_DIST_NORMAL:
+		if (classic == PSE_FALSE)
+			break;
+		pse_rng_reserve(pse, varid, count);
+		pse_simd_normal(out, count, pars[0], pars[1]);
+		return;
+	case PSE_DIST_NORMAL_SELF:
+		if (classic == PSE_FALSE)
+			break;
+		pse_rng_reserve(pse, varid, count);
+		if (chain == PSE_TRUE) {
+			pse_simd_normal(out, count, 0, pars[0]);
+			for (i = 0; i < count; i++) {
+				value = value + out[i];
+				out[i] = value;
+			}
+		} else {
+			pse_simd_normal(out, count, value, pars[0]);
+		}
+		return;
+	case PSE_DIST_EXPONENTIAL:
+		if (classic == PSE_FALSE)
+			break;
+		pse_rng_reserve(pse, varid, count);
+		pse_simd_exponential(out, count, pars[0]);
+		return;
+	case PSE_DIST_EXPONENTIAL_SELF:
+		if (classic == PSE_FALSE)
+			break;
+		pse_rng_reserve(pse, varid, count);
+		if (chain == PSE_TRUE) {
+			pse_simd_exponential(out, count, 1);
+			for (i = 0; i < count; i++) {
+				value = value*out[i];
+				out[i] = value;
+			}
+		} else {
+			pse_simd_exponential(out, count, value);
+		}
+		return;
 	case PSE_DIST_FOKKER_PLANCK:
-		/*
-		 * Placeholder for future implemenentation
-		 */
-		return value;
+		if (classic == PSE_TRUE) {
+			pse_rng_reserve(pse, varid, count);
+			pse_simd_normal(out, count, 0, 1);
+		} else {
+			for (i = 0; i < count; i++) {
+				pse_rng_position(pse, varid);
+				out[i] = snorm_zig_r8();
+			}
+		}
+		if (chain == PSE_TRUE) {
+			for (i = 0; i < count; i++) {
+				pse_sde_update(1, &value, pars, cache, NULL, &out[i], &value);
+				out[i] = value;
+			}
+		} else {
+			dt = pse_sde_dt(pars, cache);
+			pse_sde_coefficients(1, &value, pars, cache, &mu, &sigma);
+			mu = (dt > 0) ? value + mu*dt : value;
+			sigma = (dt > 0) ? sigma*sqrt(dt) : 0;
+			for (i = 0; i < count; i++)
+				out[i] = mu + sigma*out[i];
+		}
+		return;
 	case PSE_DIST_CUSTOM:
-		/*
-		 * Placeholder for future implementation
-		 */
-		return value;
+		if (cache->custom == NULL || chain == PSE_TRUE)
+			break;
+		for (i = 0; i < count; i++)
+			out[i] = value;
+		pse_rng_reserve(pse, varid, count);
+		cache->custom(rng_state_get(), pars, out, out, count);
+		return;
 	default:
-		return 0;
+		break;
+	}
+
+	for (i = 0; i < count; i++) {
+		pse_rng_position(pse, varid);
+		out[i] = var->sample_double(value, pars, cache);
+		if (chain == PSE_TRUE)
+			value = out[i];
 	}
 }
 
@@ -267,7 +1063,8 @@ unsigned int pse_is_self_distribution(pse_distribution_type distribution) {
  *
  * TODO: this method is ugly for strings. A common factorization should be possible.
  */
-void pse_randomize(pse_variable *ptr_out, pse_variable *var, unsigned int location) {
+void pse_randomize(pse_variable *ptr_out, pse_variable *var, unsigned int location,
+						pse_sampler_type sampler) {
 	unsigned int array_location;
 	unsigned int str_len;
 	char char_median = (char)127;
@@ -276,12 +1073,12 @@ void pse_randomize(pse_variable *ptr_out, pse_variable *var, unsigned int locati
 	if (var->array == PSE_SCALAR) {
 		switch(var->storage) {
 		case PSE_VAR_INT:
-			ptr_out->content.cint = pse_sample_int_distribution(var->content.cint,
-										var->point_parameters, var->point_distribution);
+			ptr_out->content.cint = var->sample_int(var->content.cint,
+										var->point_parameters, &var->point_cache);
 			break;
 		case PSE_VAR_DOUBLE:
-			ptr_out->content.cdouble = pse_sample_double_distribution(var->content.cdouble,
-										var->point_parameters, var->point_distribution);
+			ptr_out->content.cdouble = var->sample_double(var->content.cdouble,
+										var->point_parameters, &var->point_cache);
 			break;
 		case PSE_VAR_STRING:
 			/*
@@ -302,14 +1099,14 @@ void pse_randomize(pse_variable *ptr_out, pse_variable *var, unsigned int locati
 				if (pse_is_self_distribution(var->array_distribution) == PSE_TRUE) {
 					do {
 						array_location = pse_sample_int_distribution(str_len/2,
-								ptr_out->array_parameters, var->array_distribution);
+								ptr_out->array_parameters, var->array_distribution, NULL);
 					} while(array_location >= str_len);
 				} else {
 					ptr_out->array_parameters[0] = str_len/2;
 
 					do {
 						array_location = pse_sample_int_distribution(str_len/2,
-								ptr_out->array_parameters, var->array_distribution);
+								ptr_out->array_parameters, var->array_distribution, NULL);
 					} while(array_location >= str_len);
 				}
 			} else {
@@ -319,14 +1116,14 @@ void pse_randomize(pse_variable *ptr_out, pse_variable *var, unsigned int locati
 				if (pse_is_self_distribution(var->array_distribution) == PSE_TRUE) {
 					do {
 						array_location = (unsigned int)pse_sample_double_distribution(str_len/2,
-								ptr_out->array_parameters, var->array_distribution);
+								ptr_out->array_parameters, var->array_distribution, sampler);
 					} while(array_location >= str_len);
 				} else {
 					ptr_out->array_parameters[0] = str_len/2;
 
 					do {
 						array_location = (unsigned int)pse_sample_int_distribution(str_len/2,
-								ptr_out->array_parameters, var->array_distribution);
+								ptr_out->array_parameters, var->array_distribution, NULL);
 					} while(array_location >= str_len);
 				}
 			}
@@ -342,7 +1139,7 @@ void pse_randomize(pse_variable *ptr_out, pse_variable *var, unsigned int locati
 					do {
 						ptr_out->content.cstring[array_location] =
 								(char)pse_sample_int_distribution(char_median,
-								ptr_out->point_parameters, var->point_distribution);
+								ptr_out->point_parameters, var->point_distribution, NULL);
 					} while(ptr_out->content.cstring[array_location] > char_max);
 				} else {
 					ptr_out->array_parameters[0] = str_len/2;
@@ -350,7 +1147,7 @@ void pse_randomize(pse_variable *ptr_out, pse_variable *var, unsigned int locati
 					do {
 						ptr_out->content.cstring[array_location] =
 								(char)pse_sample_int_distribution(char_median,
-								ptr_out->point_parameters, var->point_distribution);
+								ptr_out->point_parameters, var->point_distribution, NULL);
 					} while(ptr_out->content.cstring[array_location] > char_max);
 				}
 			} else {
@@ -361,7 +1158,7 @@ void pse_randomize(pse_variable *ptr_out, pse_variable *var, unsigned int locati
 					do {
 						ptr_out->content.cstring[array_location] =
 								(char)pse_sample_double_distribution(char_median,
-								ptr_out->point_parameters, var->point_distribution);
+								ptr_out->point_parameters, var->point_distribution, sampler);
 					} while(ptr_out->content.cstring[array_location] > char_max);
 				} else {
 					ptr_out->array_parameters[0] = char_median;
@@ -369,15 +1166,15 @@ void pse_randomize(pse_variable *ptr_out, pse_variable *var, unsigned int locati
 					do {
 						ptr_out->content.cstring[array_location] =
 								(char)pse_sample_double_distribution(char_median,
-								ptr_out->point_parameters, var->point_distribution);
+								ptr_out->point_parameters, var->point_distribution, sampler);
 					} while(ptr_out->content.cstring[array_location] > char_max);
 				}
 			}
 
 			break;
 		case PSE_VAR_TIME:
-			ptr_out->content.ctime = pse_sample_double_distribution(var->content.ctime,
-										var->point_parameters, var->point_distribution);
+			ptr_out->content.ctime = var->sample_double(var->content.ctime,
+										var->point_parameters, &var->point_cache);
 			break;
 		default:
 			break;
@@ -386,13 +1183,13 @@ void pse_randomize(pse_variable *ptr_out, pse_variable *var, unsigned int locati
 		switch(var->storage) {
 		case PSE_VAR_INT:
 			ptr_out->content.cint_a[location] =
-					pse_sample_int_distribution(var->content.cint_a[location],
-										var->point_parameters, var->point_distribution);
+					var->sample_int(var->content.cint_a[location],
+										var->point_parameters, &var->point_cache);
 			break;
 		case PSE_VAR_DOUBLE:
 			ptr_out->content.cdouble_a[location] =
-					pse_sample_double_distribution(var->content.cdouble_a[location],
-										var->point_parameters, var->point_distribution);
+					var->sample_double(var->content.cdouble_a[location],
+										var->point_parameters, &var->point_cache);
 			break;
 		case PSE_VAR_STRING:
 			/*
@@ -413,14 +1210,14 @@ void pse_randomize(pse_variable *ptr_out, pse_variable *var, unsigned int locati
 				if (pse_is_self_distribution(var->array_distribution) == PSE_TRUE) {
 					do {
 						array_location = pse_sample_int_distribution(str_len/2,
-								ptr_out->array_parameters, var->array_distribution);
+								ptr_out->array_parameters, var->array_distribution, NULL);
 					} while(array_location >= str_len);
 				} else {
 					ptr_out->array_parameters[0] = str_len/2;
 
 					do {
 						array_location = pse_sample_int_distribution(str_len/2,
-								ptr_out->array_parameters, var->array_distribution);
+								ptr_out->array_parameters, var->array_distribution, NULL);
 					} while(array_location >= str_len);
 				}
 			} else {
@@ -430,14 +1227,14 @@ void pse_randomize(pse_variable *ptr_out, pse_variable *var, unsigned int locati
 				if (pse_is_self_distribution(var->array_distribution) == PSE_TRUE) {
 					do {
 						array_location = (unsigned int)pse_sample_double_distribution(str_len/2,
-								ptr_out->array_parameters, var->array_distribution);
+								ptr_out->array_parameters, var->array_distribution, sampler);
 					} while(array_location >= str_len);
 				} else {
 					ptr_out->array_parameters[0] = str_len/2;
 
 					do {
 						array_location = (unsigned int)pse_sample_int_distribution(str_len/2,
-								ptr_out->array_parameters, var->array_distribution);
+								ptr_out->array_parameters, var->array_distribution, NULL);
 					} while(array_location >= str_len);
 				}
 			}
@@ -453,14 +1250,14 @@ void pse_randomize(pse_variable *ptr_out, pse_variable *var, unsigned int locati
 					do {
 						ptr_out->content.cstring_a[location][array_location] =
 								(char)pse_sample_int_distribution(char_median,
-								ptr_out->point_parameters, var->point_distribution);
+								ptr_out->point_parameters, var->point_distribution, NULL);
 					} while(ptr_out->content.cstring_a[location][array_location] > char_max);
 				} else {
 					ptr_out->array_parameters[0] = char_median;
 
 					do {
 						ptr_out->content.cstring[array_location] = (char)pse_sample_int_distribution(char_median,
-								ptr_out->array_parameters, var->array_distribution);
+								ptr_out->array_parameters, var->array_distribution, NULL);
 					} while(ptr_out->content.cstring_a[location][array_location] > char_max);
 				}
 			} else {
@@ -471,7 +1268,7 @@ void pse_randomize(pse_variable *ptr_out, pse_variable *var, unsigned int locati
 					do {
 						ptr_out->content.cstring_a[location][array_location] =
 								(char)pse_sample_double_distribution(str_len/2,
-								ptr_out->array_parameters, var->array_distribution);
+								ptr_out->array_parameters, var->array_distribution, sampler);
 					} while(ptr_out->content.cstring[array_location] > char_max);
 				} else {
 					ptr_out->array_parameters[0] = str_len/2;
@@ -479,15 +1276,15 @@ void pse_randomize(pse_variable *ptr_out, pse_variable *var, unsigned int locati
 					do {
 						ptr_out->content.cstring_a[location][array_location] =
 								(char)pse_sample_double_distribution(char_median,
-								ptr_out->array_parameters, var->array_distribution);
+								ptr_out->array_parameters, var->array_distribution, sampler);
 					} while(ptr_out->content.cstring_a[location][array_location] > char_max);
 				}
 			}
 			break;
 		case PSE_VAR_TIME:
 			ptr_out->content.ctime_a[location] =
-					pse_sample_double_distribution(var->content.ctime_a[location],
-										var->point_parameters, var->point_distribution);
+					var->sample_double(var->content.ctime_a[location],
+										var->point_parameters, &var->point_cache);
 			break;
 		default:
 			break;
@@ -497,22 +1294,261 @@ void pse_randomize(pse_variable *ptr_out, pse_variable *var, unsigned int locati
 	return;
 }
 
+/*
+ * Copy the content at a location from one variable into another of the same
+ * shape. Arrays and strings are copied into the buffers owned by the target,
+ * never by aliasing the buffers of the source.
+ */
+void pse_copy_content(pse_variable *ptr_to, pse_variable *ptr_from, unsigned int location) {
+	if (ptr_to == ptr_from)
+		return;
+
+	if (ptr_from->array == PSE_SCALAR) {
+		switch(ptr_from->storage) {
+		case PSE_VAR_STRING:
+			strcpy(ptr_to->content.cstring, ptr_from->content.cstring);
+			break;
+		default:
+			ptr_to->content = ptr_from->content;
+			break;
+		}
+	} else {
+		switch(ptr_from->storage) {
+		case PSE_VAR_INT:
+			ptr_to->content.cint_a[location] = ptr_from->content.cint_a[location];
+			break;
+		case PSE_VAR_DOUBLE:
+			ptr_to->content.cdouble_a[location] = ptr_from->content.cdouble_a[location];
+			break;
+		case PSE_VAR_STRING:
+			strcpy(ptr_to->content.cstring_a[location], ptr_from->content.cstring_a[location]);
+			break;
+		case PSE_VAR_TIME:
+			ptr_to->content.ctime_a[location] = ptr_from->content.ctime_a[location];
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/*
+ * Record the numeric content observed at a location. Strings are not recorded.
+ */
+void pse_record(pse_agent_stub *pse, pse_varid varid, unsigned int location,
+						pse_variable *var) {
+	double value;
+
+	switch(var->storage) {
+	case PSE_VAR_INT:
+		value = (var->array == PSE_SCALAR) ? var->content.cint :
+					var->content.cint_a[location];
+		break;
+	case PSE_VAR_DOUBLE:
+		value = (var->array == PSE_SCALAR) ? var->content.cdouble :
+					var->content.cdouble_a[location];
+		break;
+	case PSE_VAR_TIME:
+		value = (var->array == PSE_SCALAR) ? var->content.ctime :
+					var->content.ctime_a[location];
+		break;
+	default:
+		return;
+	}
+
+	pse_rec_append(pse->recorder, pse->agent, varid, location, value);
+}
+
+void pse_record_batch(pse_agent_stub *pse, pse_varid varid, unsigned int location,
+						pse_content out, unsigned int count, pse_storage_type storage) {
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		pse_rec_append(pse->recorder, pse->agent, varid, location,
+						(storage == PSE_VAR_INT) ? out.cint_a[i] : out.cdouble_a[i]);
+}
+
+/*
+ * Index of the point parameter that a prior conditions
+ */
+unsigned int pse_conditioned_parameter(pse_distribution_type distribution) {
+	return (distribution == PSE_DIST_BINOMIAL) ? 1 : 0;
+}
+
+/*
+ * Whether the sampler cache of a distribution holds configuration of the
+ * variable rather than constants derived from its parameters. Conditioned
+ * draws keep using the cache of the variable for those.
+ */
+unsigned int pse_is_configured_distribution(pse_distribution_type distribution) {
+	switch(distribution) {
+	case PSE_DIST_BINOMIAL_SELF:
+	case PSE_DIST_FOKKER_PLANCK:
+	case PSE_DIST_CUSTOM:
+	case PSE_DIST_TABLE_INT:
+	case PSE_DIST_TABLE_DOUBLE:
+		return PSE_TRUE;
+	default:
+		return PSE_FALSE;
+	}
+}
+
+/*
+ * Value of a conditional, as evidence. Doubles are truncated. Arrays are read
+ * at the observed location, or at their first one if they are shorter.
+ */
+unsigned int pse_evidence(pse_variable *var, unsigned int location) {
+	if (var->array == PSE_ARRAY && location >= var->size)
+		location = 0;
+
+	switch(var->storage) {
+	case PSE_VAR_INT:
+		return (unsigned int)((var->array == PSE_SCALAR) ? var->content.cint :
+					var->content.cint_a[location]);
+	case PSE_VAR_DOUBLE:
+		return (unsigned int)(int)((var->array == PSE_SCALAR) ? var->content.cdouble :
+					var->content.cdouble_a[location]);
+	case PSE_VAR_TIME:
+		return (unsigned int)(int)((var->array == PSE_SCALAR) ? var->content.ctime :
+					var->content.ctime_a[location]);
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Conditional distribution of a variable with dependencies
+ *
+ * A clean dependency observed at the location of its last evaluation is
+ * answered at once. Otherwise the evidence is gathered and compared with that
+ * of the last evaluation in the same pass, so the prior (and the sampler setup
+ * that follows from it) only runs again when a conditional has changed.
+ * Returns the parameters to draw with and sets the cache that goes with them,
+ * or returns NULL with the error set if a conditional has been deregistered
+ * or the prior of a restored dependency has not been supplied again. Without
+ * a prior, the point distribution of the variable is used as is.
+ *
+ * BINOMIAL_SELF setups are indexed by the number of trials and checked
+ * against the probability, so the variable's own are shared.
+ */
+double * pse_condition(pse_agent_stub *pse, pse_varid varid, unsigned int location,
+						pse_sampler_cache **cache, pse_error *error) {
+	pse_variable *var = pse->variables[varid];
+	pse_dependency *dep = &(pse->dependencies[varid]);
+	pse_depid *conditionals = pse->conditionals + dep->offset;
+	unsigned int *evidence = pse->evidence + dep->offset;
+	unsigned int changed;
+	unsigned int value;
+	unsigned int i;
+
+	if (dep->prior_pending == PSE_TRUE) {
+		*error = PSE_ERROR_PRIOR_MISSING;
+		return NULL;
+	}
+
+	if (dep->priors == NULL) {
+		*cache = &(var->point_cache);
+		return var->point_parameters;
+	}
+
+	*cache = (pse_is_configured_distribution(var->point_distribution) == PSE_TRUE) ?
+				&(var->point_cache) : &(dep->cache);
+
+	if (dep->evaluated == PSE_TRUE && dep->dirty == PSE_FALSE && dep->location == location)
+		return dep->parameters;
+
+	changed = (dep->evaluated == PSE_FALSE);
+
+	for (i = 0; i < dep->count; i++) {
+		if (pse_is_registered(pse, conditionals[i]) == PSE_FALSE) {
+			*error = PSE_ERROR_DEPENDENCY_UNKNOWN;
+			return NULL;
+		}
+
+		value = pse_evidence(pse->variables[conditionals[i]], location);
+
+		if (value != evidence[i]) {
+			evidence[i] = value;
+			changed = PSE_TRUE;
+		}
+	}
+
+	if (changed == PSE_TRUE) {
+		if (dep->evaluated == PSE_FALSE) {
+			memcpy(dep->parameters, var->point_parameters,
+					PSE_MAX_DIST_PARAMS*sizeof(double));
+			memset(&dep->cache, 0, sizeof(pse_sampler_cache));
+		}
+
+		dep->parameters[pse_conditioned_parameter(var->point_distribution)] =
+					dep->priors(dep->count, evidence);
+		pse_refresh_cache(var->point_distribution, dep->parameters, &dep->cache);
+		dep->evaluated = PSE_TRUE;
+	}
+
+	dep->dirty = PSE_FALSE;
+	dep->location = location;
+
+	return dep->parameters;
+}
+
+/*
+ * Numeric part of pse_randomize(), drawing with the given parameters
+ */
+void pse_randomize_conditional(pse_variable *ptr_out, pse_variable *var,
+						unsigned int location, double *pars, pse_sampler_cache *cache) {
+	if (var->array == PSE_SCALAR) {
+		switch(var->storage) {
+		case PSE_VAR_INT:
+			ptr_out->content.cint = var->sample_int(var->content.cint, pars, cache);
+			break;
+		case PSE_VAR_DOUBLE:
+			ptr_out->content.cdouble = var->sample_double(var->content.cdouble,
+										pars, cache);
+			break;
+		case PSE_VAR_TIME:
+			ptr_out->content.ctime = var->sample_double(var->content.ctime, pars, cache);
+			break;
+		default:
+			break;
+		}
+	} else {
+		switch(var->storage) {
+		case PSE_VAR_INT:
+			ptr_out->content.cint_a[location] =
+					var->sample_int(var->content.cint_a[location], pars, cache);
+			break;
+		case PSE_VAR_DOUBLE:
+			ptr_out->content.cdouble_a[location] =
+					var->sample_double(var->content.cdouble_a[location], pars, cache);
+			break;
+		case PSE_VAR_TIME:
+			ptr_out->content.ctime_a[location] =
+					var->sample_double(var->content.ctime_a[location], pars, cache);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
 /*
  * Randomize and alter, used for replacing values and associated more closely
  * with SELF distributions.
  */
-void pse_randomize_and_alter(pse_variable *ptr_out, pse_variable *var, unsigned int location, pse_error *error) {
+void pse_randomize_and_alter(pse_variable *ptr_out, pse_variable *var, unsigned int location,
+						pse_sampler_type sampler, pse_error *error) {
 	if (var->read_and_alter == PSE_FALSE) {
 		*error = PSE_ERROR_VARIABLE_IS_IMMUTABLE;
 		return;
 	}
 
-	pse_randomize(ptr_out, var, location);
+	pse_randomize(ptr_out, var, location, sampler);
 
 	/*
 	 * Update contents of the original variable
 	 */
-	var->content = ptr_out->content;
+	pse_copy_content(var, ptr_out, location);
 	memcpy(var->point_parameters, ptr_out->point_parameters, PSE_MAX_DIST_PARAMS*sizeof(double));
 	memcpy(var->array_parameters, ptr_out->array_parameters, PSE_MAX_DIST_PARAMS*sizeof(double));
 
@@ -525,8 +1561,6 @@ void pse_randomize_and_alter(pse_variable *ptr_out, pse_variable *var, unsigned
  * PSE stubs cannot be reused.
  */
 pse_error pse_init(pse_agent_stub *pse) {
-	int i;
-
 	if (pse->state == INITIALIZED)
 		return PSE_ERROR_ALREADY_INITIALIZED;
 
@@ -536,13 +1570,28 @@ pse_error pse_init(pse_agent_stub *pse) {
 	if (pse->state == FINALIZED)
 			return PSE_ERROR_ALREADY_FINALIZED;
 
-	for (i = 0; i < PSE_MAX_VARIABLES; i++) {
-		pse->variables[i] = NULL;
-		pse->dependencies[i] = NULL;
-	}
-
+	memset(&pse->rng, 0, sizeof(rng_state));
+
+	pse->variables = NULL;
+	pse->dependencies = NULL;
+	pse->conditionals = NULL;
+	pse->evidence = NULL;
+	pse->dependent_offsets = NULL;
+	pse->dependents = NULL;
+	pse->order = NULL;
+	pse->order_count = 0;
+	pse->level_offsets = NULL;
+	pse->level_count = 0;
+	pse->block_priors = NULL;
+	pse->block_prior_pending = PSE_FALSE;
 	pse->var_count = 0;
 	pse->var_limit = 0;
+	pse->var_capacity = 0;
+	pse->cond_count = 0;
+	pse->cond_capacity = 0;
+	pse->sampler = PSE_DEFAULT_SAMPLER;
+	pse->recorder = NULL;
+	pse->agent = 0;
 	pse->state = INITIALIZED;
 
 	return PSE_ERROR_OK;
@@ -558,9 +1607,79 @@ pse_error pse_init(pse_agent_stub *pse) {
  * current time, it is only a flag.
  *
  * When the machine is started, the random number generators are initialized
- * in each agent with a provided seed.
+ * in each agent with a provided seed. The generator tables belong to the stub,
+ * so starting one agent does not reseed any other.
  */
 pse_error pse_start(pse_agent_stub *pse, int seed_1, int seed_2) {
+	return pse_start_rng(pse, PSE_RNG_LECUYER, seed_1, seed_2);
+}
+
+/*
+ * PSE start with an explicit generator backend
+ *
+ * For PSE_RNG_LECUYER both seeds feed the two generator components. For
+ * PSE_RNG_PHILOX the first seed is the global seed and the second one is the
+ * agent identifier; together they form the key of the counter-based stream.
+ */
+pse_error pse_start_rng(pse_agent_stub *pse, pse_rng_type rng, int seed_1, int seed_2) {
+	rng_state *previous;
+	pse_error error;
+
+	if (pse->state == CREATED)
+			return PSE_ERROR_NOT_INITIALIZED;
+
+	if (pse->state == STARTED)
+			return PSE_ERROR_ALREADY_STARTED;
+
+	if (pse->state == FINALIZED)
+			return PSE_ERROR_ALREADY_FINALIZED;
+
+	/*
+	 * Dependencies are fixed from now on. A stub whose dependencies form a
+	 * cycle is not started.
+	 */
+	error = pse_build_graph(pse);
+
+	if (error != PSE_ERROR_OK)
+		return error;
+
+	/*
+	 * Initialize the random number generators and set both seeds. Seeds are
+	 * installed as initial seeds so that every generator in the stub derives
+	 * from them (set_seed() would be undone by init_generator()).
+	 */
+	previous = rng_state_bind(&pse->rng);
+	initialize();
+
+	switch(rng) {
+	case PSE_RNG_LECUYER:
+		set_initial_seed(pse_fold_seed(seed_1, PSE_RNG_M1),
+							pse_fold_seed(seed_2, PSE_RNG_M2));
+		break;
+	case PSE_RNG_PHILOX:
+		rng_philox_set_key((unsigned int)seed_1, (unsigned int)seed_2);
+		break;
+	default:
+		rng_state_bind(previous);
+		return PSE_ERROR_TYPE_UNKNOWN;
+	}
+
+	rng_state_bind(previous);
+
+	pse->state = STARTED;
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Sampler selection
+ *
+ * Chooses how normal and exponential variables are sampled. The choice is part
+ * of the configuration of the stub and can only be made before it is started.
+ */
+pse_error pse_set_sampler(pse_agent_stub *pse, pse_sampler_type sampler) {
+	unsigned int i;
+
 	if (pse->state == CREATED)
 			return PSE_ERROR_NOT_INITIALIZED;
 
@@ -570,13 +1689,16 @@ pse_error pse_start(pse_agent_stub *pse, int seed_1, int seed_2) {
 	if (pse->state == FINALIZED)
 			return PSE_ERROR_ALREADY_FINALIZED;
 
-	/*
-	 * Initialize the random number generators and set both seeds.
-	 */
-	initialize();
-	set_seed(seed_1, seed_2);
+	if (sampler != PSE_SAMPLER_ZIGGURAT && sampler != PSE_SAMPLER_CLASSIC)
+		return PSE_ERROR_TYPE_UNKNOWN;
 
-	pse->state = STARTED;
+	pse->sampler = sampler;
+
+	for (i = 0; i < pse->var_limit; i++) {
+		if (pse->variables[i] != NULL)
+			pse->variables[i]->sample_double = pse_resolve_double_sampler(
+								pse->variables[i]->point_distribution, sampler);
+	}
 
 	return PSE_ERROR_OK;
 }
@@ -585,7 +1707,7 @@ pse_error pse_start(pse_agent_stub *pse, int seed_1, int seed_2) {
  * PSE finalization
  */
 pse_error pse_finalize(pse_agent_stub *pse) {
-	int i;
+	unsigned int i;
 
 	if (pse->state == FINALIZED)
 		return PSE_ERROR_ALREADY_FINALIZED;
@@ -593,8 +1715,11 @@ pse_error pse_finalize(pse_agent_stub *pse) {
 	if (pse->state == INITIALIZED)
 		return PSE_ERROR_NOT_STARTED;
 
-	for (i = 0; i < PSE_MAX_VARIABLES; i++) {
+	for (i = 0; i < pse->var_limit; i++) {
 		if (pse->variables[i] != NULL) {
+			pse_release_cache(pse->variables[i]->point_distribution,
+								&pse->variables[i]->point_cache);
+
 			if (pse->variables[i]->array == PSE_ARRAY) {
 				switch(pse->variables[i]->storage) {
 				case PSE_VAR_INT:
@@ -616,13 +1741,23 @@ pse_error pse_finalize(pse_agent_stub *pse) {
 
 			free(pse->variables[i]);
 		}
-
-		if (pse->dependencies[i] != NULL)
-			free(pse->dependencies[i]);
 	}
 
+	free(pse->variables);
+	free(pse->dependencies);
+	free(pse->conditionals);
+	free(pse->evidence);
+	pse_release_graph(pse);
+	pse->variables = NULL;
+	pse->dependencies = NULL;
+	pse->conditionals = NULL;
+	pse->evidence = NULL;
+
 	pse->var_count = 0;
 	pse->var_limit = 0;
+	pse->var_capacity = 0;
+	pse->cond_count = 0;
+	pse->cond_capacity = 0;
 	pse->state = FINALIZED;
 
 	return PSE_ERROR_OK;
@@ -654,7 +1789,8 @@ pse_varid pse_register(pse_agent_stub *pse, pse_storage_type storage,
 	if (pse->state == FINALIZED)
 		return PSE_ERROR_ALREADY_FINALIZED;
 
-	if (pse->var_count == PSE_MAX_VARIABLES)
+	if (pse->var_limit == pse->var_capacity &&
+		pse_grow_variables(pse) != PSE_ERROR_OK)
 		return PSE_ERROR_TOO_MANY_VARIABLES;
 
 	/*
@@ -668,7 +1804,10 @@ pse_varid pse_register(pse_agent_stub *pse, pse_storage_type storage,
 	if (pse->variables[next_available_varid] != NULL)
 		return PSE_ERROR_VARIABLE_ALREADY_REGISTERED;
 
-	pse->variables[next_available_varid] = (pse_variable *) malloc(sizeof(pse_variable));
+	/*
+	 * Zeroed, so that checkpoints of equal variables are equal
+	 */
+	pse->variables[next_available_varid] = (pse_variable *) calloc(1, sizeof(pse_variable));
 	p_to_var = pse->variables[next_available_varid];
 	p_to_var->storage = storage;
 	p_to_var->model = model;
@@ -678,6 +1817,18 @@ pse_varid pse_register(pse_agent_stub *pse, pse_storage_type storage,
 	p_to_var->size = size;
 
 	memcpy(p_to_var->point_parameters, point_parameters, PSE_MAX_DIST_PARAMS*sizeof(double));
+	memset(&p_to_var->point_cache, 0, sizeof(pse_sampler_cache));
+	pse_refresh_cache(point_distribution, p_to_var->point_parameters, &p_to_var->point_cache);
+
+	if (point_distribution == PSE_DIST_BINOMIAL_SELF)
+		p_to_var->point_cache.binomial_by_n = (binomial_r8_setup *)
+					calloc(PSE_BINOMIAL_CACHE, sizeof(binomial_r8_setup));
+
+	p_to_var->sample_int = pse_resolve_int_sampler(point_distribution);
+	p_to_var->sample_double = pse_resolve_double_sampler(point_distribution,
+												pse->sampler);
+	p_to_var->step = 0;
+	p_to_var->sampler_pending = PSE_FALSE;
 	p_to_var->has_dependencies = PSE_FALSE;
 	p_to_var->read_and_alter = read_and_alter;
 	p_to_var->array_distribution = array_distribution;
@@ -756,9 +1907,45 @@ pse_error pse_deregister(pse_agent_stub *pse, pse_varid varid) {
 	if (pse->var_count == 0)
 		return PSE_ERROR_TOO_MANY_VARIABLES;
 
-	if (pse->variables[varid] == NULL)
+	if (pse_is_registered(pse, varid) == PSE_FALSE)
 		return PSE_ERROR_VARIABLE_UNKNOWN;
 
+	/*
+	 * The storage is checked before anything is released, so that a variable
+	 * either goes entirely or stays as it was
+	 */
+	switch(pse->variables[varid]->storage) {
+	case PSE_VAR_INT:
+	case PSE_VAR_DOUBLE:
+	case PSE_VAR_STRING:
+	case PSE_VAR_TIME:
+		break;
+	default:
+		return PSE_ERROR_TYPE_UNKNOWN;
+	}
+
+	/*
+	 * Its conditionals leave the pool whatever it stores. Variables that
+	 * depend on it keep its identifier, which is never given to another
+	 * variable: their observations fail with PSE_ERROR_VARIABLE_UNKNOWN (see
+	 * pse_condition) and the dependency graph leaves it out.
+	 */
+	if (pse->variables[varid]->has_dependencies == PSE_TRUE)
+		pse_drop_dependencies(pse, varid);
+
+	/*
+	 * Variables clocked by this one go back to the step of their parameters
+	 */
+	for (i = 0; i < pse->var_limit; i++) {
+		if (pse->variables[i] != NULL &&
+			pse->variables[i]->point_distribution == PSE_DIST_FOKKER_PLANCK &&
+			pse->variables[i]->point_cache.sde.step != NULL &&
+			pse->variables[i]->point_cache.sde.clock == varid) {
+			pse->variables[i]->point_cache.sde.clock = PSE_SDE_NO_CLOCK;
+			pse->variables[i]->point_cache.sde.step = NULL;
+		}
+	}
+
 	/*
 	 * Similarly, de-registration involves removing memory assignments
 	 * of array structures.
@@ -777,35 +1964,32 @@ pse_error pse_deregister(pse_agent_stub *pse, pse_varid varid) {
 			free(pse->variables[varid]->content.ctime_a);
 			pse->variables[varid]->content.ctime_a = NULL;
 			break;
-		case PSE_VAR_STRING:
+		default:
 			/*
-			 * Initialize the structure and then all the strings associated to it.
-			 * This allows constructing models that contain a variable number of
-			 * strings of at most length 1000.
+			 * Each string of the array, then the array itself
 			 */
 			for (i = 0; i < pse->variables[varid]->size; i++)
 				free(pse->variables[varid]->content.cstring_a[i]);
-			break;
 
 			free(pse->variables[varid]->content.cstring_a);
 			pse->variables[varid]->content.cstring_a = NULL;
-		default:
-			return PSE_ERROR_TYPE_UNKNOWN;
+			break;
 		}
-	} else {
+	} else if (pse->variables[varid]->storage == PSE_VAR_STRING) {
 		/*
-		 * Strings require initialization
+		 * Scalar numbers live inside the variable; strings do not
 		 */
-		switch(pse->variables[varid]->storage) {
-		case PSE_VAR_STRING:
-			free(pse->variables[varid]->content.cstring);
-			pse->variables[varid]->content.cstring = NULL;
-			break;
-		default:
-			return PSE_ERROR_TYPE_UNKNOWN;
-		}
+		free(pse->variables[varid]->content.cstring);
+		pse->variables[varid]->content.cstring = NULL;
 	}
 
+	/*
+	 * Only once nothing can fail, so a variable that stays registered keeps
+	 * its sampler constants and table
+	 */
+	pse_release_cache(pse->variables[varid]->point_distribution,
+						&pse->variables[varid]->point_cache);
+
 	free(pse->variables[varid]);
 	pse->variables[varid] = NULL;
 	pse->var_count--;
@@ -818,6 +2002,11 @@ pse_error pse_deregister(pse_agent_stub *pse, pse_varid varid) {
  */
 pse_error pse_add_dependencies(pse_agent_stub *pse, pse_varid varid, int *conditionals,
 																unsigned int count) {
+	unsigned int capacity;
+	unsigned int i;
+	pse_depid *pool;
+	unsigned int *evidence;
+
 	if (pse->state == CREATED)
 			return PSE_ERROR_NOT_INITIALIZED;
 
@@ -827,10 +2016,10 @@ pse_error pse_add_dependencies(pse_agent_stub *pse, pse_varid varid, int *condit
 	if (pse->state == FINALIZED)
 		return PSE_ERROR_ALREADY_FINALIZED;
 
-	if (pse->variables[varid] == NULL)
+	if (pse_is_registered(pse, varid) == PSE_FALSE)
 		return PSE_ERROR_VARIABLE_UNKNOWN;
 
-	if (pse->dependencies[varid] != NULL)
+	if (pse->variables[varid]->has_dependencies == PSE_TRUE)
 		return PSE_ERROR_DEPENDENCY_ALREADY_EXISTS;
 
 	/*
@@ -843,10 +2032,51 @@ pse_error pse_add_dependencies(pse_agent_stub *pse, pse_varid varid, int *condit
 	if (pse_is_world_var(pse->variables[varid]) == PSE_FALSE)
 		return PSE_ERROR_DEPENDENCY_NOT_WORLD;
 
-	pse->dependencies[varid] = (pse_dependency *)malloc(sizeof(pse_dependency));
-	pse->dependencies[varid]->count = count;
-	memcpy(pse->dependencies[varid]->conditionals, conditionals, count*sizeof(int));
-	pse->dependencies[varid]->priors = NULL;
+	/*
+	 * Conditional draws are numeric, and so is the evidence they rest on.
+	 */
+	if (pse->variables[varid]->storage == PSE_VAR_STRING)
+		return PSE_ERROR_TYPE_MISMATCH;
+
+	for (i = 0; i < count; i++) {
+		if (pse_is_registered(pse, conditionals[i]) == PSE_FALSE)
+			return PSE_ERROR_VARIABLE_UNKNOWN;
+
+		if (pse->variables[conditionals[i]]->storage == PSE_VAR_STRING)
+			return PSE_ERROR_TYPE_MISMATCH;
+	}
+
+	if (pse->cond_count + count > pse->cond_capacity) {
+		capacity = (pse->cond_capacity == 0) ? PSE_INITIAL_VARIABLES : pse->cond_capacity;
+
+		while (capacity < pse->cond_count + count)
+			capacity *= 2;
+
+		pool = (pse_depid *) realloc(pse->conditionals, sizeof(pse_depid)*capacity);
+
+		if (pool == NULL)
+			return PSE_ERROR_TOO_MANY_VARIABLES;
+
+		pse->conditionals = pool;
+
+		evidence = (unsigned int *) realloc(pse->evidence, sizeof(unsigned int)*capacity);
+
+		if (evidence == NULL)
+			return PSE_ERROR_TOO_MANY_VARIABLES;
+
+		pse->evidence = evidence;
+		pse->cond_capacity = capacity;
+	}
+
+	memcpy(pse->conditionals + pse->cond_count, conditionals, count*sizeof(pse_depid));
+	pse->dependencies[varid].count = count;
+	pse->dependencies[varid].offset = pse->cond_count;
+	pse->dependencies[varid].priors = NULL;
+	pse->dependencies[varid].prior_pending = PSE_FALSE;
+	pse->dependencies[varid].evaluated = PSE_FALSE;
+	pse->dependencies[varid].dirty = PSE_FALSE;
+	pse->dependencies[varid].location = 0;
+	pse->cond_count += count;
 
 	pse->variables[varid]->has_dependencies = PSE_TRUE;
 
@@ -872,15 +2102,13 @@ pse_error pse_rm_dependencies(pse_agent_stub *pse, pse_varid varid) {
 	if (pse->state == FINALIZED)
 		return PSE_ERROR_ALREADY_FINALIZED;
 
-	if (pse->variables[varid] == NULL)
+	if (pse_is_registered(pse, varid) == PSE_FALSE)
 		return PSE_ERROR_VARIABLE_UNKNOWN;
 
-	if (pse->dependencies[varid] == NULL)
+	if (pse->variables[varid]->has_dependencies == PSE_FALSE)
 		return PSE_ERROR_DEPENDENCY_UNKNOWN;
 
-	free(pse->dependencies[varid]);
-
-	pse->variables[varid]->has_dependencies = PSE_FALSE;
+	pse_drop_dependencies(pse, varid);
 
 	return PSE_ERROR_OK;
 }
@@ -901,19 +2129,24 @@ pse_error pse_supply_prior(pse_agent_stub * pse, pse_varid varid,
 	if (pse->state == CREATED)
 		return PSE_ERROR_NOT_INITIALIZED;
 
-	if (pse->state == STARTED)
-		return PSE_ERROR_ALREADY_STARTED;
-
 	if (pse->state == FINALIZED)
 		return PSE_ERROR_ALREADY_FINALIZED;
 
-	if (pse->variables[varid] == NULL)
+	if (pse_is_registered(pse, varid) == PSE_FALSE)
 		return PSE_ERROR_VARIABLE_UNKNOWN;
 
-	if (pse->dependencies[varid] == NULL)
+	if (pse->variables[varid]->has_dependencies == PSE_FALSE)
 		return PSE_ERROR_DEPENDENCY_UNKNOWN;
 
-	pse->dependencies[varid]->priors = priors;
+	/*
+	 * Started stubs only take the priors a restore left pending
+	 */
+	if (pse->state == STARTED && pse->dependencies[varid].prior_pending == PSE_FALSE)
+		return PSE_ERROR_ALREADY_STARTED;
+
+	pse->dependencies[varid].priors = priors;
+	pse->dependencies[varid].prior_pending = PSE_FALSE;
+	pse->dependencies[varid].evaluated = PSE_FALSE;
 
 	return PSE_ERROR_OK;
 }
@@ -933,7 +2166,10 @@ pse_variable * pse_template(pse_variable *ptr_out, pse_variable *var) {
 	ptr_out->array = var->array;
 	ptr_out->size = var->size;
 	memcpy(ptr_out->point_parameters, var->point_parameters, PSE_MAX_DIST_PARAMS*sizeof(double));
+	ptr_out->sample_int = var->sample_int;
+	ptr_out->sample_double = var->sample_double;
 	ptr_out->has_dependencies = var->has_dependencies;
+	ptr_out->step = var->step;
 	ptr_out->read_and_alter = var->read_and_alter;
 	ptr_out->array_distribution = var->array_distribution;
 	memcpy(ptr_out->array_parameters, var->array_parameters, PSE_MAX_DIST_PARAMS*sizeof(double));
@@ -982,7 +2218,36 @@ pse_variable * pse_template(pse_variable *ptr_out, pse_variable *var) {
 	return ptr_out;
 }
 
+/*
+ * Re-bind an existing template to another variable of the same shape (storage,
+ * array type and size). The buffers of the template are reused, so a single
+ * template can serve every observation of a family of variables without any
+ * further allocation.
+ */
+pse_error pse_template_bind(pse_variable *ptr_out, pse_variable *var) {
+	if (ptr_out->storage != var->storage || ptr_out->array != var->array ||
+			(ptr_out->array == PSE_ARRAY && ptr_out->size != var->size))
+		return PSE_ERROR_TYPE_MISMATCH;
+
+	ptr_out->model = var->model;
+	ptr_out->locality = var->locality;
+	ptr_out->point_distribution = var->point_distribution;
+	memcpy(ptr_out->point_parameters, var->point_parameters, PSE_MAX_DIST_PARAMS*sizeof(double));
+	ptr_out->sample_int = var->sample_int;
+	ptr_out->sample_double = var->sample_double;
+	ptr_out->has_dependencies = var->has_dependencies;
+	ptr_out->step = var->step;
+	ptr_out->read_and_alter = var->read_and_alter;
+	ptr_out->array_distribution = var->array_distribution;
+	memcpy(ptr_out->array_parameters, var->array_parameters, PSE_MAX_DIST_PARAMS*sizeof(double));
+	strcpy(ptr_out->name, var->name);
+
+	return PSE_ERROR_OK;
+}
+
 void pse_scratch(pse_variable *ptr_out) {
+	int i;
+
 	if (ptr_out->array == PSE_ARRAY) {
 		switch(ptr_out->storage) {
 		case PSE_VAR_INT:
@@ -992,6 +2257,8 @@ void pse_scratch(pse_variable *ptr_out) {
 			free(ptr_out->content.cdouble_a);
 			break;
 		case PSE_VAR_STRING:
+			for (i = 0; i < ptr_out->size; i++)
+				free(ptr_out->content.cstring_a[i]);
 			free(ptr_out->content.cstring_a);
 			break;
 		case PSE_VAR_TIME:
@@ -1000,6 +2267,8 @@ void pse_scratch(pse_variable *ptr_out) {
 		default:
 			return;
 		}
+	} else if (ptr_out->storage == PSE_VAR_STRING) {
+		free(ptr_out->content.cstring);
 	}
 
 	free(ptr_out);
@@ -1019,6 +2288,9 @@ void pse_scratch(pse_variable *ptr_out) {
 void pse_prepare(pse_agent_stub *pse, pse_varid varid, pse_content content,
 				unsigned int location, pse_storage_type storage, pse_error *error) {
 	pse_variable *p_to_var;
+	pse_sampler_cache *cache;
+	rng_state *previous;
+	double *pars;
 
 	if (pse->state == CREATED) {
 		*error = PSE_ERROR_NOT_INITIALIZED;
@@ -1035,7 +2307,7 @@ void pse_prepare(pse_agent_stub *pse, pse_varid varid, pse_content content,
 		return;
 	}
 
-	if (pse->variables[varid] == NULL){
+	if (pse_is_registered(pse, varid) == PSE_FALSE) {
 		*error = PSE_ERROR_VARIABLE_UNKNOWN;
 		return;
 	}
@@ -1047,6 +2319,8 @@ void pse_prepare(pse_agent_stub *pse, pse_varid varid, pse_content content,
 		return;
 	}
 
+	pse_touch(pse, varid);
+
 	if (p_to_var->array == PSE_SCALAR) {
 		switch(p_to_var->storage) {
 		case PSE_VAR_INT:
@@ -1104,6 +2378,11 @@ void pse_prepare(pse_agent_stub *pse, pse_varid varid, pse_content content,
 	 * If a variable is stochastic, variation must be ensured.
 	 */
 	if (p_to_var->model == PSE_VAR_STOCHASTIC) {
+		if (p_to_var->sampler_pending == PSE_TRUE) {
+			*error = PSE_ERROR_SAMPLER_MISSING;
+			return;
+		}
+
 		/*
 		 * Separate by models that have dependencies.
 		 */
@@ -1112,12 +2391,28 @@ void pse_prepare(pse_agent_stub *pse, pse_varid varid, pse_content content,
 			 * We use a helper function to prepare the state with the desired
 			 * distribution function(s).
 			 */
-			pse_randomize_and_alter(p_to_var, p_to_var, location, error);
+			previous = rng_state_bind(&pse->rng);
+			pse_rng_position(pse, varid);
+			pse_randomize_and_alter(p_to_var, p_to_var, location, pse->sampler, error);
+			rng_state_bind(previous);
 			*error = PSE_ERROR_OK;
 		} else {
 			/*
-			 * TODO: this needs to be implemented as a Bayesian distribution computation.
+			 * The value is drawn again from its distribution conditioned on
+			 * the world (see pse_condition()).
 			 */
+			pars = pse_condition(pse, varid, location, &cache, error);
+
+			if (pars == NULL)
+				return;
+
+			previous = rng_state_bind(&pse->rng);
+			pse_rng_position(pse, varid);
+
+			if (p_to_var->read_and_alter == PSE_TRUE)
+				pse_randomize_conditional(p_to_var, p_to_var, location, pars, cache);
+
+			rng_state_bind(previous);
 			*error = PSE_ERROR_OK;
 		}
 	} else {
@@ -1136,6 +2431,9 @@ void pse_observe(pse_agent_stub *pse, pse_varid varid,
 						unsigned int location, pse_variable *ptr_out, pse_error *error) {
 	int csize;
 	pse_variable *p_to_var;
+	pse_sampler_cache *cache;
+	rng_state *previous;
+	double *pars;
 
 	if (pse->state == CREATED) {
 		*error = PSE_ERROR_NOT_INITIALIZED;
@@ -1152,7 +2450,7 @@ void pse_observe(pse_agent_stub *pse, pse_varid varid,
 		return;
 	}
 
-	if (pse->variables[varid] == NULL){
+	if (pse_is_registered(pse, varid) == PSE_FALSE) {
 		*error = PSE_ERROR_VARIABLE_UNKNOWN;
 		return;
 	}
@@ -1163,7 +2461,11 @@ void pse_observe(pse_agent_stub *pse, pse_varid varid,
 		csize = pse_sizeof(p_to_var);
 
 		if (csize != 0) {
-			memcpy(ptr_out, &(p_to_var->content), csize);
+			pse_copy_content(ptr_out, p_to_var, location);
+
+			if (pse->recorder != NULL)
+				pse_record(pse, varid, location, ptr_out);
+
 			*error = PSE_ERROR_OK;
 		} else {
 			*error = PSE_ERROR_TYPE_UNKNOWN;
@@ -1171,28 +2473,336 @@ void pse_observe(pse_agent_stub *pse, pse_varid varid,
 
 		return;
 	} else if (p_to_var->model == PSE_VAR_STOCHASTIC) {
+		if (p_to_var->sampler_pending == PSE_TRUE) {
+			*error = PSE_ERROR_SAMPLER_MISSING;
+			return;
+		}
+
 		/*
 		 * Separate by models that have dependencies.
 		 */
 		if (p_to_var->has_dependencies == PSE_FALSE) {
-			if (p_to_var->read_and_alter == PSE_TRUE)
-				pse_randomize_and_alter(ptr_out, p_to_var, location, error);
-			else
-				pse_randomize(ptr_out, p_to_var, location);
+			previous = rng_state_bind(&pse->rng);
+			pse_rng_position(pse, varid);
+
+			if (p_to_var->read_and_alter == PSE_TRUE) {
+				pse_randomize_and_alter(ptr_out, p_to_var, location, pse->sampler, error);
+				pse_touch(pse, varid);
+			} else {
+				pse_randomize(ptr_out, p_to_var, location, pse->sampler);
+			}
+
+			rng_state_bind(previous);
+
+			if (pse->recorder != NULL)
+				pse_record(pse, varid, location, ptr_out);
 
 			*error = PSE_ERROR_OK;
 		} else {
-			/*
-			 * TODO: this needs to be implemented as a Bayesian distribution computation.
-			 */
+			pars = pse_condition(pse, varid, location, &cache, error);
+
+			if (pars == NULL)
+				return;
+
+			previous = rng_state_bind(&pse->rng);
+			pse_rng_position(pse, varid);
+			pse_randomize_conditional(ptr_out, p_to_var, location, pars, cache);
+			rng_state_bind(previous);
+
+			if (p_to_var->read_and_alter == PSE_TRUE) {
+				pse_copy_content(p_to_var, ptr_out, location);
+				pse_touch(pse, varid);
+			}
+
+			if (pse->recorder != NULL)
+				pse_record(pse, varid, location, ptr_out);
+
 			*error = PSE_ERROR_OK;
+		}
+	} else {
+		*error = PSE_ERROR_OK;
+		return;
+	}
+}
+
+/*
+ * Common checks of the direct observe functions. Returns the variable to be
+ * observed, or NULL with the error set.
+ */
+pse_variable * pse_observe_target(pse_agent_stub *pse, pse_varid varid,
+						unsigned int location, pse_storage_type storage,
+						pse_error *error) {
+	pse_variable *p_to_var;
+
+	if (pse->state == CREATED || pse->state == INITIALIZED) {
+		*error = PSE_ERROR_NOT_INITIALIZED;
+		return NULL;
+	}
+
+	if (pse->state == FINALIZED) {
+		*error = PSE_ERROR_ALREADY_FINALIZED;
+		return NULL;
+	}
+
+	if (pse_is_registered(pse, varid) == PSE_FALSE) {
+		*error = PSE_ERROR_VARIABLE_UNKNOWN;
+		return NULL;
+	}
+
+	p_to_var = pse->variables[varid];
+
+	if (p_to_var->storage != storage) {
+		*error = PSE_ERROR_TYPE_MISMATCH;
+		return NULL;
+	}
+
+	if (p_to_var->array == PSE_ARRAY && location >= p_to_var->size) {
+		*error = PSE_ERROR_ARRAY_OUTOFBOUNDS;
+		return NULL;
+	}
+
+	return p_to_var;
+}
+
+/*
+ * Typed observe functions
+ *
+ * These return one observation directly, with the same semantics as
+ * pse_observe(), but without a templated variable and without touching the
+ * heap. They are the preferred way to read numeric variables in hot loops.
+ */
+int pse_observe_int(pse_agent_stub *pse, pse_varid varid, unsigned int location,
+						pse_error *error) {
+	return (int) pse_observe_number(pse, varid, location, PSE_VAR_INT, error);
+}
+
+double pse_observe_double(pse_agent_stub *pse, pse_varid varid, unsigned int location,
+						pse_error *error) {
+	return pse_observe_number(pse, varid, location, PSE_VAR_DOUBLE, error);
+}
+
+pse_time pse_observe_time(pse_agent_stub *pse, pse_varid varid, unsigned int location,
+						pse_error *error) {
+	return pse_observe_number(pse, varid, location, PSE_VAR_TIME, error);
+}
+
+/*
+ * Observation of a numeric variable shared by the typed observe functions.
+ * Integers are returned as doubles, which hold them exactly.
+ */
+double pse_observe_number(pse_agent_stub *pse, pse_varid varid, unsigned int location,
+						pse_storage_type storage, pse_error *error) {
+	double value;
+	int *p_to_int = NULL;
+	double *p_to_double = NULL;
+	pse_variable *p_to_var;
+	pse_sampler_cache *cache;
+	rng_state *previous;
+	double *pars;
+
+	p_to_var = pse_observe_target(pse, varid, location, storage, error);
+
+	if (p_to_var == NULL)
+		return 0;
+
+	if (storage == PSE_VAR_INT)
+		p_to_int = (p_to_var->array == PSE_SCALAR) ? &(p_to_var->content.cint) :
+						&(p_to_var->content.cint_a[location]);
+	else if (storage == PSE_VAR_DOUBLE)
+		p_to_double = (p_to_var->array == PSE_SCALAR) ? &(p_to_var->content.cdouble) :
+						&(p_to_var->content.cdouble_a[location]);
+	else
+		p_to_double = (p_to_var->array == PSE_SCALAR) ? &(p_to_var->content.ctime) :
+						&(p_to_var->content.ctime_a[location]);
+
+	*error = PSE_ERROR_OK;
+
+	if (p_to_var->model == PSE_VAR_DETERMINISTIC) {
+		value = (p_to_int != NULL) ? *p_to_int : *p_to_double;
+	} else {
+		if (p_to_var->sampler_pending == PSE_TRUE) {
+			*error = PSE_ERROR_SAMPLER_MISSING;
+			return 0;
+		}
+
+		pars = p_to_var->point_parameters;
+		cache = &(p_to_var->point_cache);
+
+		if (p_to_var->has_dependencies == PSE_TRUE) {
+			pars = pse_condition(pse, varid, location, &cache, error);
+
+			if (pars == NULL)
+				return 0;
+		}
+
+		previous = rng_state_bind(&pse->rng);
+		pse_rng_position(pse, varid);
+
+		if (p_to_int != NULL)
+			value = p_to_var->sample_int(*p_to_int, pars, cache);
+		else
+			value = p_to_var->sample_double(*p_to_double, pars, cache);
+
+		rng_state_bind(previous);
+
+		if (p_to_var->read_and_alter == PSE_TRUE) {
+			if (p_to_int != NULL)
+				*p_to_int = value;
+			else
+				*p_to_double = value;
+
+			pse_touch(pse, varid);
+		}
+	}
+
+	if (pse->recorder != NULL)
+		pse_rec_append(pse->recorder, pse->agent, varid, location, value);
+
+	return value;
+}
+
+/*
+ * Batch observe function
+ *
+ * Fills a caller buffer with count observations of a numeric variable (at the
+ * given location for arrays). The buffer is taken from the content union
+ * member matching the storage type: cint_a, cdouble_a or ctime_a. State and
+ * type checks run once for the whole batch. With read_and_alter, each draw
+ * becomes the stored value before the next one, as with count consecutive
+ * calls to pse_observe().
+ *
+ * Most batches are identical to those count calls. Batches that take the
+ * vector routes of pse_sample_double_batch() only match them in
+ * distribution: uniform doubles, chained or not; normal, exponential and
+ * FOKKER_PLANCK doubles under PSE_SAMPLER_CLASSIC; and CUSTOM variables that
+ * are not read_and_alter.
+ */
+void pse_observe_batch(pse_agent_stub *pse, pse_varid varid, unsigned int location,
+						pse_content out, unsigned int count, pse_storage_type storage,
+						pse_error *error) {
+	unsigned int i;
+	unsigned int chain;
+	int *p_to_int = NULL;
+	double *p_to_double = NULL;
+	pse_variable *p_to_var;
+	pse_sampler_cache *cache;
+	rng_state *previous;
+	double *pars;
+
+	p_to_var = pse_observe_target(pse, varid, location, storage, error);
+
+	if (p_to_var == NULL)
+		return;
+
+	/*
+	 * Locate the stored value the observations are drawn from.
+	 */
+	switch(p_to_var->storage) {
+	case PSE_VAR_INT:
+		p_to_int = (p_to_var->array == PSE_SCALAR) ? &(p_to_var->content.cint) :
+							&(p_to_var->content.cint_a[location]);
+		break;
+	case PSE_VAR_DOUBLE:
+		p_to_double = (p_to_var->array == PSE_SCALAR) ? &(p_to_var->content.cdouble) :
+							&(p_to_var->content.cdouble_a[location]);
+		break;
+	case PSE_VAR_TIME:
+		p_to_double = (p_to_var->array == PSE_SCALAR) ? &(p_to_var->content.ctime) :
+							&(p_to_var->content.ctime_a[location]);
+		break;
+	default:
+		*error = PSE_ERROR_TYPE_UNKNOWN;
+		return;
+	}
+
+	if (p_to_var->model == PSE_VAR_DETERMINISTIC) {
+		if (p_to_var->storage == PSE_VAR_INT) {
+			for (i = 0; i < count; i++)
+				out.cint_a[i] = *p_to_int;
+		} else {
+			for (i = 0; i < count; i++)
+				out.cdouble_a[i] = *p_to_double;
+		}
+
+		if (pse->recorder != NULL)
+			pse_record_batch(pse, varid, location, out, count, p_to_var->storage);
+
+		*error = PSE_ERROR_OK;
+		return;
+	}
+
+	if (p_to_var->sampler_pending == PSE_TRUE) {
+		*error = PSE_ERROR_SAMPLER_MISSING;
+		return;
+	}
+
+	chain = p_to_var->read_and_alter;
 
+	/*
+	 * Conditionals do not change during a batch, so the distribution is
+	 * conditioned once and every draw uses it.
+	 */
+	if (p_to_var->has_dependencies == PSE_TRUE) {
+		pars = pse_condition(pse, varid, location, &cache, error);
+
+		if (pars == NULL)
 			return;
+
+		previous = rng_state_bind(&pse->rng);
+
+		for (i = 0; i < count; i++) {
+			pse_rng_position(pse, varid);
+
+			if (p_to_var->storage == PSE_VAR_INT) {
+				out.cint_a[i] = p_to_var->sample_int(*p_to_int, pars, cache);
+
+				if (chain == PSE_TRUE)
+					*p_to_int = out.cint_a[i];
+			} else {
+				out.cdouble_a[i] = p_to_var->sample_double(*p_to_double, pars, cache);
+
+				if (chain == PSE_TRUE)
+					*p_to_double = out.cdouble_a[i];
+			}
 		}
-	} else {
+
+		rng_state_bind(previous);
+
+		if (chain == PSE_TRUE && count > 0)
+			pse_touch(pse, varid);
+
+		if (pse->recorder != NULL)
+			pse_record_batch(pse, varid, location, out, count, p_to_var->storage);
+
 		*error = PSE_ERROR_OK;
 		return;
 	}
+
+	previous = rng_state_bind(&pse->rng);
+
+	if (p_to_var->storage == PSE_VAR_INT) {
+		pse_sample_int_batch(pse, varid, *p_to_int, p_to_var->point_parameters,
+					chain, out.cint_a, count);
+
+		if (chain == PSE_TRUE && count > 0)
+			*p_to_int = out.cint_a[count - 1];
+	} else {
+		pse_sample_double_batch(pse, varid, *p_to_double, p_to_var->point_parameters,
+					chain, out.cdouble_a, count);
+
+		if (chain == PSE_TRUE && count > 0)
+			*p_to_double = out.cdouble_a[count - 1];
+	}
+
+	rng_state_bind(previous);
+
+	if (chain == PSE_TRUE && count > 0)
+		pse_touch(pse, varid);
+
+	if (pse->recorder != NULL)
+		pse_record_batch(pse, varid, location, out, count, p_to_var->storage);
+
+	*error = PSE_ERROR_OK;
 }
 
 /*
@@ -1254,6 +2864,27 @@ void pse_error_log(pse_error error, char *buffer, char *arg) {
 	case PSE_ERROR_VARIABLE_IS_IMMUTABLE:
 		sprintf(buffer, PSE_ERROR_FMT, "Illegal attempt to change immutable variable", final_arg);
 		break;
+	case PSE_ERROR_IO:
+		sprintf(buffer, PSE_ERROR_FMT, "Input or output operation failed", final_arg);
+		break;
+	case PSE_ERROR_CHECKPOINT_INVALID:
+		sprintf(buffer, PSE_ERROR_FMT, "The checkpoint is damaged or was written by another build", final_arg);
+		break;
+	case PSE_ERROR_DEPENDENCY_CYCLE:
+		sprintf(buffer, PSE_ERROR_FMT, "The dependencies of the PSE form a cycle", final_arg);
+		break;
+	case PSE_ERROR_TABLE_INVALID:
+		sprintf(buffer, PSE_ERROR_FMT, "The table holds no valid distribution", final_arg);
+		break;
+	case PSE_ERROR_PRIOR_MISSING:
+		sprintf(buffer, PSE_ERROR_FMT, "The prior of a restored dependency has not been supplied", final_arg);
+		break;
+	case PSE_ERROR_SAMPLER_MISSING:
+		sprintf(buffer, PSE_ERROR_FMT, "The model or sampler of a restored variable has not been supplied", final_arg);
+		break;
+	case PSE_ERROR_NAME_TOO_LONG:
+		sprintf(buffer, PSE_ERROR_FMT, "The name does not fit in PSE_VARNAME_SIZE", final_arg);
+		break;
 	default:
 		sprintf(buffer, PSE_ERROR_FMT, "Operation successful", final_arg);
 		break;
@@ -0,0 +1,682 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pseckpt.h>
+#include <psetable.h>
+#include "pseint.h"
+
+/*
+ * Position inside a checkpoint image. While an image is measured, base is
+ * NULL and only used advances.
+ */
+typedef struct pse_ckpt_cursor {
+	char *base;
+	size_t used;
+	size_t size;
+} pse_ckpt_cursor;
+
+/*
+ * Declaration of private functions
+ */
+void pse_ckpt_put(pse_ckpt_cursor *, void *, size_t);
+unsigned int pse_ckpt_get(pse_ckpt_cursor *, void *, size_t);
+void pse_ckpt_put_string(pse_ckpt_cursor *, char *);
+char * pse_ckpt_get_string(pse_ckpt_cursor *);
+void pse_ckpt_put_table(pse_ckpt_cursor *, pse_table *);
+pse_table * pse_ckpt_get_table(pse_ckpt_cursor *, pse_distribution_type, pse_error *);
+void pse_ckpt_write_stub(pse_ckpt_cursor *, pse_agent_stub *);
+void pse_ckpt_write_image(pse_ckpt_cursor *, pse_agent_stub *, unsigned int);
+pse_error pse_ckpt_read_variable(pse_ckpt_cursor *, pse_agent_stub *, pse_varid);
+pse_error pse_ckpt_read_stub(pse_ckpt_cursor *, pse_agent_stub *);
+void pse_ckpt_discard(pse_agent_stub *);
+
+/*
+ * Append bytes to an image
+ */
+void pse_ckpt_put(pse_ckpt_cursor *cursor, void *data, size_t bytes) {
+	if (cursor->base != NULL)
+		memcpy(cursor->base + cursor->used, data, bytes);
+
+	cursor->used += bytes;
+}
+
+/*
+ * Consume bytes from an image into dest. Returns PSE_FALSE if the image ends
+ * before. Records are copied out rather than used in place, since they need
+ * not be aligned within the image.
+ */
+unsigned int pse_ckpt_get(pse_ckpt_cursor *cursor, void *dest, size_t bytes) {
+	if (cursor->size - cursor->used < bytes)
+		return PSE_FALSE;
+
+	memcpy(dest, cursor->base + cursor->used, bytes);
+	cursor->used += bytes;
+
+	return PSE_TRUE;
+}
+
+/*
+ * Strings are stored up to their terminator, preceded by their length, rather
+ * than as the whole PSE_MAX_STRLEN buffer.
+ */
+void pse_ckpt_put_string(pse_ckpt_cursor *cursor, char *string) {
+	char *end = (char *) memchr(string, '\0', PSE_MAX_STRLEN);
+	unsigned int length = (end == NULL) ? PSE_MAX_STRLEN : (unsigned int)(end - string);
+
+	pse_ckpt_put(cursor, &length, sizeof(unsigned int));
+	pse_ckpt_put(cursor, string, length);
+}
+
+char * pse_ckpt_get_string(pse_ckpt_cursor *cursor) {
+	unsigned int length;
+	char *string;
+
+	if (pse_ckpt_get(cursor, &length, sizeof(unsigned int)) == PSE_FALSE ||
+		length > PSE_MAX_STRLEN)
+		return NULL;
+
+	string = (char *) malloc(sizeof(char)*PSE_MAX_STRLEN);
+
+	if (string == NULL)
+		return NULL;
+
+	if (pse_ckpt_get(cursor, string, length) == PSE_FALSE) {
+		free(string);
+		return NULL;
+	}
+
+	if (length < PSE_MAX_STRLEN)
+		string[length] = '\0';
+
+	return string;
+}
+
+/*
+ * Tables are stored as the data they were built from, preceded by their
+ * count, and built again (and shared) on restore.
+ */
+void pse_ckpt_put_table(pse_ckpt_cursor *cursor, pse_table *table) {
+	pse_ckpt_put(cursor, &table->count, sizeof(unsigned int));
+	pse_ckpt_put(cursor, table->weights, sizeof(double)*table->count);
+
+	if (table->distribution == PSE_DIST_TABLE_INT)
+		pse_ckpt_put(cursor, table->values, sizeof(int)*table->count);
+	else
+		pse_ckpt_put(cursor, table->edges, sizeof(double)*(table->count + 1));
+}
+
+pse_table * pse_ckpt_get_table(pse_ckpt_cursor *cursor, pse_distribution_type distribution,
+						pse_error *error) {
+	unsigned int count;
+	double *weights;
+	void *source;
+	size_t bytes;
+	pse_table *table = NULL;
+
+	*error = PSE_ERROR_CHECKPOINT_INVALID;
+
+	if (pse_ckpt_get(cursor, &count, sizeof(unsigned int)) == PSE_FALSE || count == 0 ||
+		(cursor->size - cursor->used)/sizeof(double) < count)
+		return NULL;
+
+	bytes = (distribution == PSE_DIST_TABLE_INT) ? sizeof(int)*count :
+												sizeof(double)*(count + 1);
+	weights = (double *) malloc(sizeof(double)*count);
+	source = malloc(bytes);
+
+	if (weights == NULL || source == NULL) {
+		*error = PSE_ERROR_TOO_MANY_VARIABLES;
+	} else if (pse_ckpt_get(cursor, weights, sizeof(double)*count) == PSE_TRUE &&
+				pse_ckpt_get(cursor, source, bytes) == PSE_TRUE) {
+		if (distribution == PSE_DIST_TABLE_INT)
+			table = pse_table_int(weights, (int *) source, count, error);
+		else
+			table = pse_table_double((double *) source, weights, count, error);
+
+		if (*error == PSE_ERROR_TABLE_INVALID)
+			*error = PSE_ERROR_CHECKPOINT_INVALID;
+	}
+
+	free(weights);
+	free(source);
+
+	return table;
+}
+
+/*
+ * Append one stub: its record, then for each variable slot a presence flag
+ * followed by the variable, its dependency and its contents, then the pool of
+ * conditionals.
+ */
+void pse_ckpt_write_stub(pse_ckpt_cursor *cursor, pse_agent_stub *pse) {
+	pse_ckpt_stub record;
+	pse_dependency dependency;
+	pse_variable variable;
+	pse_variable *var;
+	unsigned int present;
+	unsigned int i;
+	unsigned int j;
+
+	memset(&record, 0, sizeof(pse_ckpt_stub));
+	record.state = pse->state;
+	record.sampler = pse->sampler;
+	record.var_count = pse->var_count;
+	record.var_limit = pse->var_limit;
+	record.var_capacity = pse->var_capacity;
+	record.cond_count = pse->cond_count;
+	record.agent = pse->agent;
+	record.block_prior = (pse->block_priors != NULL ||
+							pse->block_prior_pending == PSE_TRUE);
+	record.rng = pse->rng;
+	pse_ckpt_put(cursor, &record, sizeof(pse_ckpt_stub));
+
+	for (i = 0; i < pse->var_limit; i++) {
+		var = pse->variables[i];
+		present = (var != NULL) ? PSE_TRUE : PSE_FALSE;
+		pse_ckpt_put(cursor, &present, sizeof(unsigned int));
+
+		if (var == NULL)
+			continue;
+
+		memcpy(&variable, var, sizeof(pse_variable));
+		variable.sampler_pending = (var->sampler_pending == PSE_TRUE ||
+									(var->point_distribution == PSE_DIST_FOKKER_PLANCK &&
+									var->point_cache.sde.model != NULL) ||
+									(var->point_distribution == PSE_DIST_CUSTOM &&
+									var->point_cache.custom != NULL));
+		pse_ckpt_put(cursor, &variable, sizeof(pse_variable));
+
+		memcpy(&dependency, &pse->dependencies[i], sizeof(pse_dependency));
+		dependency.prior_pending = (dependency.priors != NULL ||
+									dependency.prior_pending == PSE_TRUE);
+		dependency.priors = NULL;
+		pse_ckpt_put(cursor, &dependency, sizeof(pse_dependency));
+
+		if (var->point_distribution == PSE_DIST_BINOMIAL_SELF &&
+			var->point_cache.binomial_by_n != NULL)
+			pse_ckpt_put(cursor, var->point_cache.binomial_by_n,
+						sizeof(binomial_r8_setup)*PSE_BINOMIAL_CACHE);
+
+		if ((var->point_distribution == PSE_DIST_TABLE_INT ||
+			var->point_distribution == PSE_DIST_TABLE_DOUBLE) &&
+			var->point_cache.table != NULL)
+			pse_ckpt_put_table(cursor, var->point_cache.table);
+
+		if (var->array == PSE_ARRAY) {
+			switch(var->storage) {
+			case PSE_VAR_INT:
+				pse_ckpt_put(cursor, var->content.cint_a, pse_sizeof(var));
+				break;
+			case PSE_VAR_DOUBLE:
+				pse_ckpt_put(cursor, var->content.cdouble_a, pse_sizeof(var));
+				break;
+			case PSE_VAR_TIME:
+				pse_ckpt_put(cursor, var->content.ctime_a, pse_sizeof(var));
+				break;
+			case PSE_VAR_STRING:
+				for (j = 0; j < var->size; j++)
+					pse_ckpt_put_string(cursor, var->content.cstring_a[j]);
+				break;
+			default:
+				break;
+			}
+		} else if (var->storage == PSE_VAR_STRING) {
+			pse_ckpt_put_string(cursor, var->content.cstring);
+		}
+	}
+
+	pse_ckpt_put(cursor, pse->conditionals, sizeof(pse_depid)*pse->cond_count);
+}
+
+void pse_ckpt_write_image(pse_ckpt_cursor *cursor, pse_agent_stub *stubs,
+							unsigned int count) {
+	pse_ckpt_header header;
+	unsigned int i;
+
+	memset(&header, 0, sizeof(pse_ckpt_header));
+	strcpy(header.magic, PSE_CKPT_MAGIC);
+	header.version = PSE_CKPT_VERSION;
+	header.stubs = count;
+	header.variable_size = sizeof(pse_variable);
+	header.rng_size = sizeof(rng_state);
+	header.dependency_size = sizeof(pse_dependency);
+	header.bytes = cursor->size;
+	pse_ckpt_put(cursor, &header, sizeof(pse_ckpt_header));
+
+	for (i = 0; i < count; i++)
+		pse_ckpt_write_stub(cursor, &stubs[i]);
+}
+
+/*
+ * Rebuild one variable from an image. The variable is installed in the stub
+ * before its contents are allocated, with every pointer cleared, so that a
+ * failure part way leaves something pse_ckpt_discard() can release.
+ */
+pse_error pse_ckpt_read_variable(pse_ckpt_cursor *cursor, pse_agent_stub *pse,
+									pse_varid varid) {
+	pse_dependency dependency;
+	pse_variable *var;
+	pse_error error;
+	unsigned int cached;
+	unsigned int tabulated;
+	unsigned int i;
+
+	var = (pse_variable *) malloc(sizeof(pse_variable));
+
+	if (var == NULL)
+		return PSE_ERROR_TOO_MANY_VARIABLES;
+
+	if (pse_ckpt_get(cursor, var, sizeof(pse_variable)) == PSE_FALSE ||
+		pse_ckpt_get(cursor, &dependency, sizeof(pse_dependency)) == PSE_FALSE ||
+		var->storage > PSE_VAR_TIME || var->array > PSE_ARRAY ||
+		var->point_distribution > PSE_DIST_TABLE_DOUBLE ||
+		var->sampler_pending > PSE_TRUE) {
+		free(var);
+		return PSE_ERROR_CHECKPOINT_INVALID;
+	}
+
+	cached = (var->point_distribution == PSE_DIST_BINOMIAL_SELF &&
+				var->point_cache.binomial_by_n != NULL);
+
+	if (var->point_distribution == PSE_DIST_BINOMIAL_SELF)
+		var->point_cache.binomial_by_n = NULL;
+
+	/*
+	 * The model is left pending (see pse_variable in pse.h); the clock is
+	 * pointed into the stub once all variables are restored.
+	 */
+	if (var->point_distribution == PSE_DIST_FOKKER_PLANCK)
+		var->point_cache.sde.model = NULL;
+
+	/*
+	 * So is the sampler
+	 */
+	if (var->point_distribution == PSE_DIST_CUSTOM)
+		var->point_cache.custom = NULL;
+
+	tabulated = ((var->point_distribution == PSE_DIST_TABLE_INT ||
+				var->point_distribution == PSE_DIST_TABLE_DOUBLE) &&
+				var->point_cache.table != NULL);
+
+	if (tabulated)
+		var->point_cache.table = NULL;
+
+	if (var->array == PSE_ARRAY || var->storage == PSE_VAR_STRING)
+		memset(&var->content, 0, sizeof(pse_content));
+
+	var->sample_int = pse_resolve_int_sampler(var->point_distribution);
+	var->sample_double = pse_resolve_double_sampler(var->point_distribution,
+												pse->sampler);
+	pse->variables[varid] = var;
+
+	pse->dependencies[varid].count = dependency.count;
+	pse->dependencies[varid].offset = dependency.offset;
+	pse->dependencies[varid].priors = NULL;
+	pse->dependencies[varid].prior_pending = (dependency.prior_pending == PSE_TRUE);
+
+	if (cached) {
+		var->point_cache.binomial_by_n = (binomial_r8_setup *)
+					malloc(sizeof(binomial_r8_setup)*PSE_BINOMIAL_CACHE);
+
+		if (var->point_cache.binomial_by_n == NULL)
+			return PSE_ERROR_TOO_MANY_VARIABLES;
+
+		if (pse_ckpt_get(cursor, var->point_cache.binomial_by_n,
+				sizeof(binomial_r8_setup)*PSE_BINOMIAL_CACHE) == PSE_FALSE)
+			return PSE_ERROR_CHECKPOINT_INVALID;
+	}
+
+	if (tabulated) {
+		var->point_cache.table = pse_ckpt_get_table(cursor, var->point_distribution, &error);
+
+		if (var->point_cache.table == NULL)
+			return error;
+	}
+
+	if (var->array == PSE_ARRAY && var->storage == PSE_VAR_STRING) {
+		var->content.cstring_a = (char **) calloc(var->size, sizeof(char *));
+
+		if (var->content.cstring_a == NULL)
+			return PSE_ERROR_TOO_MANY_VARIABLES;
+
+		for (i = 0; i < var->size; i++) {
+			var->content.cstring_a[i] = pse_ckpt_get_string(cursor);
+
+			if (var->content.cstring_a[i] == NULL)
+				return PSE_ERROR_CHECKPOINT_INVALID;
+		}
+	} else if (var->array == PSE_ARRAY) {
+		/*
+		 * All numeric arrays share one representation in the union
+		 */
+		var->content.cdouble_a = (double *) malloc(pse_sizeof(var));
+
+		if (var->content.cdouble_a == NULL)
+			return PSE_ERROR_TOO_MANY_VARIABLES;
+
+		if (pse_ckpt_get(cursor, var->content.cdouble_a, pse_sizeof(var)) == PSE_FALSE)
+			return PSE_ERROR_CHECKPOINT_INVALID;
+	} else if (var->storage == PSE_VAR_STRING) {
+		var->content.cstring = pse_ckpt_get_string(cursor);
+
+		if (var->content.cstring == NULL)
+			return PSE_ERROR_CHECKPOINT_INVALID;
+	}
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Rebuild one stub from an image
+ */
+pse_error pse_ckpt_read_stub(pse_ckpt_cursor *cursor, pse_agent_stub *pse) {
+	pse_ckpt_stub record;
+	pse_variable *var;
+	unsigned int present;
+	pse_varid clock;
+	pse_error error;
+	unsigned int i;
+
+	pse->var_limit = 0;
+	pse->cond_count = 0;
+	pse->cond_capacity = 0;
+	pse->variables = NULL;
+	pse->dependencies = NULL;
+	pse->conditionals = NULL;
+	pse->evidence = NULL;
+	pse->dependent_offsets = NULL;
+	pse->dependents = NULL;
+	pse->order = NULL;
+	pse->order_count = 0;
+	pse->level_offsets = NULL;
+	pse->level_count = 0;
+	pse->block_priors = NULL;
+	pse->block_prior_pending = PSE_FALSE;
+
+	if (pse_ckpt_get(cursor, &record, sizeof(pse_ckpt_stub)) == PSE_FALSE ||
+		record.var_limit > record.var_capacity ||
+		(record.state != INITIALIZED && record.state != STARTED))
+		return PSE_ERROR_CHECKPOINT_INVALID;
+
+	pse->state = record.state;
+	pse->sampler = record.sampler;
+	pse->rng = record.rng;
+	pse->var_count = record.var_count;
+	pse->var_capacity = record.var_capacity;
+	pse->agent = record.agent;
+	pse->block_prior_pending = (record.block_prior == PSE_TRUE);
+	pse->recorder = NULL;
+	pse->variables = (pse_variable **) calloc(pse->var_capacity, sizeof(pse_variable *));
+	pse->dependencies = (pse_dependency *) calloc(pse->var_capacity, sizeof(pse_dependency));
+
+	if (pse->var_capacity > 0 && (pse->variables == NULL || pse->dependencies == NULL))
+		return PSE_ERROR_TOO_MANY_VARIABLES;
+
+	for (i = 0; i < record.var_limit; i++) {
+		pse->var_limit = i + 1;
+
+		if (pse_ckpt_get(cursor, &present, sizeof(unsigned int)) == PSE_FALSE)
+			return PSE_ERROR_CHECKPOINT_INVALID;
+
+		if (present == PSE_FALSE)
+			continue;
+
+		error = pse_ckpt_read_variable(cursor, pse, i);
+
+		if (error != PSE_ERROR_OK)
+			return error;
+	}
+
+	if (record.cond_count > 0) {
+		pse->conditionals = (pse_depid *) malloc(sizeof(pse_depid)*record.cond_count);
+		pse->evidence = (unsigned int *) calloc(record.cond_count, sizeof(unsigned int));
+
+		if (pse->conditionals == NULL || pse->evidence == NULL)
+			return PSE_ERROR_TOO_MANY_VARIABLES;
+
+		if (pse_ckpt_get(cursor, pse->conditionals,
+							sizeof(pse_depid)*record.cond_count) == PSE_FALSE)
+			return PSE_ERROR_CHECKPOINT_INVALID;
+
+		pse->cond_count = record.cond_count;
+		pse->cond_capacity = record.cond_count;
+	}
+
+	for (i = 0; i < pse->var_limit; i++) {
+		if (pse->variables[i] != NULL &&
+			pse->variables[i]->has_dependencies == PSE_TRUE &&
+			pse->dependencies[i].offset + pse->dependencies[i].count > pse->cond_count)
+			return PSE_ERROR_CHECKPOINT_INVALID;
+	}
+
+	/*
+	 * Clocks of FOKKER_PLANCK variables point into the restored stub
+	 */
+	for (i = 0; i < pse->var_limit; i++) {
+		var = pse->variables[i];
+
+		if (var == NULL || var->point_distribution != PSE_DIST_FOKKER_PLANCK ||
+			var->point_cache.sde.step == NULL)
+			continue;
+
+		clock = var->point_cache.sde.clock;
+
+		if (clock < 0 || (unsigned int)clock >= pse->var_limit ||
+			pse->variables[clock] == NULL ||
+			pse->variables[clock]->storage != PSE_VAR_TIME ||
+			pse->variables[clock]->array != PSE_SCALAR)
+			return PSE_ERROR_CHECKPOINT_INVALID;
+
+		var->point_cache.sde.step = &(pse->variables[clock]->content.ctime);
+	}
+
+	/*
+	 * The dependency graph of a started stub is built again, as pse_start()
+	 * built it.
+	 */
+	if (pse->state == STARTED) {
+		error = pse_build_graph(pse);
+
+		if (error == PSE_ERROR_DEPENDENCY_CYCLE)
+			return PSE_ERROR_CHECKPOINT_INVALID;
+
+		return error;
+	}
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Release a stub whose restore failed and return it to the CREATED state
+ */
+void pse_ckpt_discard(pse_agent_stub *pse) {
+	pse_variable *var;
+	unsigned int i;
+	unsigned int j;
+
+	for (i = 0; i < pse->var_limit; i++) {
+		var = pse->variables[i];
+
+		if (var == NULL)
+			continue;
+
+		if (var->point_distribution == PSE_DIST_BINOMIAL_SELF)
+			free(var->point_cache.binomial_by_n);
+
+		if (var->point_distribution == PSE_DIST_TABLE_INT ||
+			var->point_distribution == PSE_DIST_TABLE_DOUBLE)
+			pse_table_release(var->point_cache.table);
+
+		if (var->array == PSE_ARRAY && var->storage == PSE_VAR_STRING &&
+			var->content.cstring_a != NULL) {
+			for (j = 0; j < var->size; j++)
+				free(var->content.cstring_a[j]);
+		}
+
+		if (var->array == PSE_ARRAY || var->storage == PSE_VAR_STRING)
+			free(var->content.cdouble_a);
+
+		free(var);
+	}
+
+	free(pse->variables);
+	free(pse->dependencies);
+	free(pse->conditionals);
+	free(pse->evidence);
+	pse_release_graph(pse);
+	memset(pse, 0, sizeof(pse_agent_stub));
+	pse->state = CREATED;
+}
+
+/*
+ * Checkpoint
+ *
+ * The image is measured, built in memory and written with a single call. It
+ * goes to a temporary file that replaces the destination only once complete,
+ * so a failure while writing never destroys the previous checkpoint.
+ */
+pse_error pse_checkpoint(pse_agent_stub *stubs, unsigned int count, char *path) {
+	pse_ckpt_cursor cursor;
+	pse_error error = PSE_ERROR_OK;
+	unsigned int i;
+	char *temporary;
+	size_t written;
+	FILE *fp;
+
+	for (i = 0; i < count; i++) {
+		if (stubs[i].state == CREATED)
+			return PSE_ERROR_NOT_INITIALIZED;
+
+		if (stubs[i].state == FINALIZED)
+			return PSE_ERROR_ALREADY_FINALIZED;
+	}
+
+	cursor.base = NULL;
+	cursor.used = 0;
+	cursor.size = 0;
+	pse_ckpt_write_image(&cursor, stubs, count);
+
+	cursor.size = cursor.used;
+	cursor.used = 0;
+	cursor.base = (char *) malloc(cursor.size);
+	temporary = (char *) malloc(strlen(path) + 5);
+
+	if (cursor.base == NULL || temporary == NULL) {
+		free(cursor.base);
+		free(temporary);
+		return PSE_ERROR_TOO_MANY_VARIABLES;
+	}
+
+	pse_ckpt_write_image(&cursor, stubs, count);
+	sprintf(temporary, "%s.tmp", path);
+
+	fp = fopen(temporary, "wb");
+
+	if (fp == NULL) {
+		error = PSE_ERROR_IO;
+	} else {
+		written = fwrite(cursor.base, 1, cursor.size, fp);
+
+		if (fclose(fp) != 0 || written != cursor.size ||
+			rename(temporary, path) != 0) {
+			remove(temporary);
+			error = PSE_ERROR_IO;
+		}
+	}
+
+	free(temporary);
+	free(cursor.base);
+
+	return error;
+}
+
+/*
+ * Restore
+ *
+ * The whole image is read with a single call and checked against the layout
+ * of this build. Stubs must be in the CREATED state, as for pse_init(). If
+ * the image turns out to be damaged, every stub is left in the CREATED state.
+ */
+pse_error pse_restore(pse_agent_stub *stubs, unsigned int count, char *path) {
+	pse_ckpt_cursor cursor;
+	pse_ckpt_header header;
+	pse_error error = PSE_ERROR_OK;
+	unsigned int i;
+	unsigned int j;
+	long size;
+	FILE *fp;
+
+	for (i = 0; i < count; i++) {
+		if (stubs[i].state == INITIALIZED)
+			return PSE_ERROR_ALREADY_INITIALIZED;
+
+		if (stubs[i].state == STARTED)
+			return PSE_ERROR_ALREADY_STARTED;
+
+		if (stubs[i].state == FINALIZED)
+			return PSE_ERROR_ALREADY_FINALIZED;
+	}
+
+	fp = fopen(path, "rb");
+
+	if (fp == NULL)
+		return PSE_ERROR_IO;
+
+	if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 ||
+		fseek(fp, 0, SEEK_SET) != 0) {
+		fclose(fp);
+		return PSE_ERROR_IO;
+	}
+
+	cursor.size = (size_t) size;
+	cursor.used = 0;
+	cursor.base = (char *) malloc(cursor.size);
+
+	if (cursor.base == NULL) {
+		fclose(fp);
+		return PSE_ERROR_TOO_MANY_VARIABLES;
+	}
+
+	if (fread(cursor.base, 1, cursor.size, fp) != cursor.size) {
+		fclose(fp);
+		free(cursor.base);
+		return PSE_ERROR_IO;
+	}
+
+	fclose(fp);
+
+	if (pse_ckpt_get(&cursor, &header, sizeof(pse_ckpt_header)) == PSE_FALSE ||
+		memcmp(header.magic, PSE_CKPT_MAGIC, sizeof(PSE_CKPT_MAGIC)) != 0 ||
+		header.version != PSE_CKPT_VERSION || header.stubs != count ||
+		header.variable_size != sizeof(pse_variable) ||
+		header.rng_size != sizeof(rng_state) ||
+		header.dependency_size != sizeof(pse_dependency) ||
+		header.bytes != cursor.size) {
+		free(cursor.base);
+		return PSE_ERROR_CHECKPOINT_INVALID;
+	}
+
+	for (i = 0; i < count && error == PSE_ERROR_OK; i++)
+		error = pse_ckpt_read_stub(&cursor, &stubs[i]);
+
+	if (error == PSE_ERROR_OK && cursor.used != cursor.size)
+		error = PSE_ERROR_CHECKPOINT_INVALID;
+
+	if (error != PSE_ERROR_OK) {
+		for (j = 0; j < i; j++)
+			pse_ckpt_discard(&stubs[j]);
+	}
+
+	free(cursor.base);
+
+	return error;
+}
@@ -0,0 +1,60 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+#include <psecustom.h>
+#include "pseint.h"
+
+/*
+ * Supply a sampler to a variable of a stub
+ */
+pse_error pse_supply_sampler(pse_agent_stub *pse, pse_varid varid, pse_custom_sampler sampler) {
+	pse_variable *var;
+
+	if (pse->state == CREATED)
+		return PSE_ERROR_NOT_INITIALIZED;
+
+	if (pse->state == FINALIZED)
+		return PSE_ERROR_ALREADY_FINALIZED;
+
+	if (pse_is_registered(pse, varid) == PSE_FALSE)
+		return PSE_ERROR_VARIABLE_UNKNOWN;
+
+	var = pse->variables[varid];
+
+	if (var->point_distribution != PSE_DIST_CUSTOM || var->storage == PSE_VAR_STRING)
+		return PSE_ERROR_TYPE_MISMATCH;
+
+	var->point_cache.custom = sampler;
+	var->sampler_pending = PSE_FALSE;
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Supply a sampler to a column of a population
+ */
+pse_error pse_pop_supply_sampler(pse_population *pop, pse_varid colid,
+						pse_custom_sampler sampler) {
+	if (pop->state == CREATED)
+		return PSE_ERROR_NOT_INITIALIZED;
+
+	if (pop->state == FINALIZED)
+		return PSE_ERROR_ALREADY_FINALIZED;
+
+	if (colid < 0 || (unsigned int)colid >= pop->column_count)
+		return PSE_ERROR_VARIABLE_UNKNOWN;
+
+	if (pop->columns[colid].point_distribution != PSE_DIST_CUSTOM)
+		return PSE_ERROR_TYPE_MISMATCH;
+
+	pop->columns[colid].point_cache.custom = sampler;
+	pop->columns[colid].sampler_pending = PSE_FALSE;
+
+	return PSE_ERROR_OK;
+}
@@ -13,19 +13,135 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+/*
+ * Declaration of private functions
+ */
+int pse_dict_find(pse_dictionary *, char *, unsigned int);
+int pse_dict_rehash(pse_dictionary *, int);
+
+/**
+ * Hash a variable name (FNV-1a, 32 bits)
+ * @param A variable name
+ * @return The hash of the name
+ */
+unsigned int pse_dict_hash(char *variable) {
+	unsigned int hash = 2166136261u;
+
+	while (*variable != '\0') {
+		hash ^= (unsigned char) *variable++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/**
+ * Find the slot holding a name. Probing is linear over a power-of-two table;
+ * names are only compared when their hashes match.
+ * @param A dictionary
+ * @param A variable name
+ * @param The hash of the variable name
+ * @return The slot index, or -1 if the name is not present
+ */
+int pse_dict_find(pse_dictionary *dict, char *variable, unsigned int hash) {
+	unsigned int mask;
+	unsigned int slot;
+	int index;
+	pse_entry *entry;
+
+	if (dict->slots == NULL)
+		return -1;
+
+	mask = (unsigned int) dict->slot_count - 1;
+	slot = hash & mask;
+
+	while ((index = dict->slots[slot]) != PSE_DICT_EMPTY) {
+		if (index != PSE_DICT_DELETED) {
+			entry = &(dict->entries[index]);
+
+			if (entry->hash == hash && strcmp(entry->varname, variable) == 0)
+				return (int) slot;
+		}
+
+		slot = (slot + 1) & mask;
+	}
+
+	return -1;
+}
+
+/**
+ * Rebuild the table with a given number of slots, dropping deleted markers
+ * @param A dictionary
+ * @param The new number of slots (a power of two)
+ * @return 1 if successful, 0 if memory could not be obtained
+ */
+int pse_dict_rehash(pse_dictionary *dict, int slot_count) {
+	int *slots;
+	unsigned int mask = (unsigned int) slot_count - 1;
+	unsigned int slot;
+	int i;
+
+	slots = (int *) malloc(sizeof(int)*slot_count);
+
+	if (slots == NULL)
+		return 0;
+
+	for (i = 0; i < slot_count; i++)
+		slots[i] = PSE_DICT_EMPTY;
+
+	for (i = 0; i < dict->entry_count; i++) {
+		if (!dict->entries[i].live)
+			continue;
+
+		slot = dict->entries[i].hash & mask;
+
+		while (slots[slot] != PSE_DICT_EMPTY)
+			slot = (slot + 1) & mask;
+
+		slots[slot] = i;
+	}
+
+	free(dict->slots);
+	dict->slots = slots;
+	dict->slot_count = slot_count;
+	dict->slot_used = dict->length;
+
+	return 1;
+}
+
 /**
  * Initialize a dictionary
  * @param A dictionary
  * @return true if not previously initialized, false otherwise
  */
 int pse_dict_init(pse_dictionary *dict) {
-	if (dict->head != NULL)
+	int i;
+
+	if (dict->slots != NULL)
+		return 0;
+
+	dict->slots = (int *) malloc(sizeof(int)*PSE_DICT_INITIAL_SLOTS);
+	dict->entries = (pse_entry *) malloc(sizeof(pse_entry)*PSE_DICT_INITIAL_SLOTS);
+
+	if (dict->slots == NULL || dict->entries == NULL) {
+		free(dict->slots);
+		free(dict->entries);
+		dict->slots = NULL;
+		dict->entries = NULL;
 		return 0;
-	else {
-		dict->head = NULL;
-		dict->length = 0;
-		return 1;
 	}
+
+	for (i = 0; i < PSE_DICT_INITIAL_SLOTS; i++)
+		dict->slots[i] = PSE_DICT_EMPTY;
+
+	dict->length = 0;
+	dict->entry_count = 0;
+	dict->entry_limit = PSE_DICT_INITIAL_SLOTS;
+	dict->slot_count = PSE_DICT_INITIAL_SLOTS;
+	dict->slot_used = 0;
+	dict->free_entry = -1;
+
+	return 1;
 }
 
 /**
@@ -33,17 +149,17 @@ int pse_dict_init(pse_dictionary *dict) {
  * @param A dictionary
  */
 void pse_dict_finalize(pse_dictionary *dict) {
-	if (dict->head == NULL)
-		return;
-	else {
-		pse_entry *to_delete = dict->head;
-		pse_entry *next = NULL;
-
-		do {
-			next = to_delete->next;
-			free(to_delete);
-		} while (next != NULL);
-	}
+	free(dict->slots);
+	free(dict->entries);
+
+	dict->slots = NULL;
+	dict->entries = NULL;
+	dict->length = 0;
+	dict->entry_count = 0;
+	dict->entry_limit = 0;
+	dict->slot_count = 0;
+	dict->slot_used = 0;
+	dict->free_entry = -1;
 }
 
 /**
@@ -51,71 +167,102 @@ void pse_dict_finalize(pse_dictionary *dict) {
  * @param A dictionary
  * @param A variable name
  * @param An index from the PSE corresponding to that variable registration
- * @return 1 if the addition was successful, 0 if it already exists
+ * @return 1 if the addition was successful, 0 if it already exists or does
+ * not fit in PSE_VARNAME_SIZE
  */
 int pse_dict_add(pse_dictionary *dict, char *variable, pse_varid pseval) {
-	if (pse_dict_search(dict, variable) != -1)
+	unsigned int hash = pse_dict_hash(variable);
+	unsigned int mask;
+	unsigned int slot;
+	int index;
+	pse_entry *entries;
+	pse_entry *entry;
+
+	/*
+	 * Names are stored whole, so that they are found by the hash of the name
+	 */
+	if (strlen(variable) >= PSE_VARNAME_SIZE)
+		return 0;
+
+	if (dict->slots == NULL || pse_dict_find(dict, variable, hash) != -1)
 		return 0;
-	else if (dict->head == NULL) {
-		dict->head = (pse_entry *) malloc(sizeof(pse_entry));
-		strcpy(dict->head->varname, variable);
-		dict->head->assigned = pseval;
-		dict->head->next = NULL;
-		return 1;
+
+	/*
+	 * Keep the load (including deleted markers) under 3/4. The table doubles
+	 * only when live entries need it; otherwise it is just cleaned.
+	 */
+	if (4*(dict->slot_used + 1) > 3*dict->slot_count) {
+		if (!pse_dict_rehash(dict, (4*(dict->length + 1) > 2*dict->slot_count) ?
+								2*dict->slot_count : dict->slot_count))
+			return 0;
 	}
-	else {
-		pse_entry *iterate = dict->head;
 
-		while (iterate->next != NULL)
-			iterate = iterate->next;
+	/*
+	 * Entries of removed names are taken again before the array grows
+	 */
+	if (dict->free_entry != -1) {
+		index = dict->free_entry;
+		dict->free_entry = dict->entries[index].next_free;
+	} else {
+		if (dict->entry_count == dict->entry_limit) {
+			entries = (pse_entry *) realloc(dict->entries,
+									sizeof(pse_entry)*dict->entry_limit*2);
+
+			if (entries == NULL)
+				return 0;
 
-		// Once found, fill data in
-		iterate->next = (pse_entry *) malloc(sizeof(pse_entry));
-		strcpy(iterate->varname, variable);
-		iterate->next->assigned = pseval;
-		iterate->next->next = NULL;
+			dict->entries = entries;
+			dict->entry_limit *= 2;
+		}
 
-		return 1;
+		index = dict->entry_count++;
+		dict->entries[index].generation = 0;
 	}
+
+	entry = &(dict->entries[index]);
+	strcpy(entry->varname, variable);
+	entry->assigned = pseval;
+	entry->hash = hash;
+	entry->live = 1;
+
+	mask = (unsigned int) dict->slot_count - 1;
+	slot = hash & mask;
+
+	while (dict->slots[slot] >= 0)
+		slot = (slot + 1) & mask;
+
+	if (dict->slots[slot] == PSE_DICT_EMPTY)
+		dict->slot_used++;
+
+	dict->slots[slot] = index;
+	dict->length++;
+
+	return 1;
 }
 
 /**
- *
+ * Remove an entry from the dictionary. Its entry is kept for the next name
+ * added, and its slot marked deleted until the table is cleaned.
  * @param A dictionary
  * @param A variable name to look for and remove
  * @return 1 if remove was successful, 0 otherwise
  */
 int pse_dict_remove(pse_dictionary *dict, char *variable) {
-	if (dict->head == NULL)
+	int slot = pse_dict_find(dict, variable, pse_dict_hash(variable));
+	int index;
+
+	if (slot == -1)
 		return 0;
-	else {
-		pse_entry *prev;
-		pse_entry *curr;
-
-		// Case 1: it is the head value
-		if (strcmp(dict->head->varname, variable) == 0) {
-			curr = dict->head;
-			dict->head = curr->next;
-			free(curr);
-			return 1;
-		} else {
-			prev = dict->head;
-			curr = dict->head->next;
-
-			while (curr != NULL) {
-				if (strcmp(curr->varname, variable) != 0) {
-					prev = curr;
-					curr = curr->next;
-				} else {
-					prev->next = curr->next;
-					free(curr);
-					return 1;
-				}
-			}
 
-			return 0;
-		}
-	}
+	index = dict->slots[slot];
+	dict->entries[index].live = 0;
+	dict->entries[index].generation++;
+	dict->entries[index].next_free = dict->free_entry;
+	dict->free_entry = index;
+	dict->slots[slot] = PSE_DICT_DELETED;
+	dict->length--;
+
+	return 1;
 }
 
 /**
@@ -125,13 +272,62 @@ int pse_dict_remove(pse_dictionary *dict, char *variable) {
  * @return -1 if the variable was not found, a value
  */
 pse_varid pse_dict_search(pse_dictionary *dict, char *variable) {
-	pse_entry *curr = dict->head;
+	return pse_dict_search_hashed(dict, variable, pse_dict_hash(variable));
+}
 
-	while (curr != NULL) {
-		if (strcmp(curr->varname, variable) == 0)
-			return curr->assigned;
-	}
+/**
+ * Search an entry in the dictionary with a precomputed hash
+ * @param A dictionary
+ * @param A variable
+ * @param The value of pse_dict_hash for the variable
+ * @return -1 if the variable was not found, a value
+ */
+pse_varid pse_dict_search_hashed(pse_dictionary *dict, char *variable, unsigned int hash) {
+	int slot = pse_dict_find(dict, variable, hash);
 
-	return -1;
+	if (slot == -1)
+		return -1;
+
+	return dict->entries[dict->slots[slot]].assigned;
+}
+
+/**
+ * Resolve a variable name into a handle
+ * @param A dictionary
+ * @param A variable
+ * @return -1 if the variable was not found, a handle otherwise
+ */
+pse_dict_handle pse_dict_resolve(pse_dictionary *dict, char *variable) {
+	int slot = pse_dict_find(dict, variable, pse_dict_hash(variable));
+	int index;
+
+	if (slot == -1)
+		return -1;
+
+	index = dict->slots[slot];
+
+	return ((pse_dict_handle)(dict->entries[index].generation & PSE_DICT_GENERATION_MASK)
+				<< PSE_DICT_GENERATION_SHIFT) | (pse_dict_handle) index;
 }
 
+/**
+ * Obtain the value designated by a handle
+ * @param A dictionary
+ * @param A handle from pse_dict_resolve
+ * @return -1 if the name was removed, its value otherwise
+ */
+pse_varid pse_dict_get(pse_dictionary *dict, pse_dict_handle handle) {
+	long long index = handle & 0xffffffffLL;
+	unsigned int generation = (unsigned int)(handle >> PSE_DICT_GENERATION_SHIFT);
+	pse_entry *entry;
+
+	if (handle < 0 || index >= dict->entry_count)
+		return -1;
+
+	entry = &(dict->entries[index]);
+
+	if (!entry->live || (entry->generation & PSE_DICT_GENERATION_MASK) != generation)
+		return -1;
+
+	return entry->assigned;
+}
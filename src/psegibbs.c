@@ -0,0 +1,298 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <psegibbs.h>
+#include <pserec.h>
+#include "pseint.h"
+
+/*
+ * Declaration of private functions
+ */
+unsigned int pse_gibbs_locations(pse_variable *);
+pse_error pse_gibbs_allocate(pse_agent_stub *, pse_prior_block *);
+void pse_gibbs_release(pse_prior_block *);
+pse_error pse_gibbs_gather(pse_agent_stub *, unsigned int, pse_prior_block *);
+double pse_gibbs_draw(pse_agent_stub *, pse_varid, unsigned int, double *,
+						pse_sampler_cache *);
+pse_error pse_gibbs_sweep(pse_agent_stub *, pse_prior_block *, pse_sampler_cache *,
+						unsigned int);
+
+/*
+ * Number of locations a sweep draws for a variable (none if it is not
+ * stochastic)
+ */
+unsigned int pse_gibbs_locations(pse_variable *var) {
+	if (var->model != PSE_VAR_STOCHASTIC)
+		return 0;
+
+	return (var->array == PSE_SCALAR) ? 1 : var->size;
+}
+
+/*
+ * Size the block for the largest level, so that sweeps do not allocate
+ */
+pse_error pse_gibbs_allocate(pse_agent_stub *pse, pse_prior_block *block) {
+	unsigned int items = 0;
+	unsigned int evidence = 0;
+	unsigned int level_items;
+	unsigned int level_evidence;
+	unsigned int locations;
+	unsigned int level;
+	unsigned int i;
+	pse_varid varid;
+
+	for (level = 0; level < pse->level_count; level++) {
+		level_items = 0;
+		level_evidence = 0;
+
+		for (i = pse->level_offsets[level]; i < pse->level_offsets[level + 1]; i++) {
+			varid = pse->order[i];
+			locations = pse_gibbs_locations(pse->variables[varid]);
+			level_items += locations;
+			level_evidence += locations*pse->dependencies[varid].count;
+		}
+
+		items = (level_items > items) ? level_items : items;
+		evidence = (level_evidence > evidence) ? level_evidence : evidence;
+	}
+
+	block->varids = (pse_varid *) malloc(sizeof(pse_varid)*(items + 1));
+	block->locations = (unsigned int *) malloc(sizeof(unsigned int)*(items + 1));
+	block->offsets = (unsigned int *) malloc(sizeof(unsigned int)*(items + 1));
+	block->evidence = (unsigned int *) malloc(sizeof(unsigned int)*(evidence + 1));
+	block->priors = (double *) malloc(sizeof(double)*(items + 1));
+
+	if (block->varids == NULL || block->locations == NULL || block->offsets == NULL ||
+		block->evidence == NULL || block->priors == NULL) {
+		pse_gibbs_release(block);
+		return PSE_ERROR_TOO_MANY_VARIABLES;
+	}
+
+	return PSE_ERROR_OK;
+}
+
+void pse_gibbs_release(pse_prior_block *block) {
+	free(block->varids);
+	free(block->locations);
+	free(block->offsets);
+	free(block->evidence);
+	free(block->priors);
+	memset(block, 0, sizeof(pse_prior_block));
+}
+
+/*
+ * Fill the block with the locations of a level and their evidence
+ */
+pse_error pse_gibbs_gather(pse_agent_stub *pse, unsigned int level, pse_prior_block *block) {
+	pse_dependency *dep;
+	pse_depid conditional;
+	pse_varid varid;
+	unsigned int locations;
+	unsigned int location;
+	unsigned int items = 0;
+	unsigned int used = 0;
+	unsigned int i;
+	unsigned int j;
+
+	for (i = pse->level_offsets[level]; i < pse->level_offsets[level + 1]; i++) {
+		varid = pse->order[i];
+		dep = &(pse->dependencies[varid]);
+		locations = pse_gibbs_locations(pse->variables[varid]);
+
+		for (location = 0; location < locations; location++) {
+			block->varids[items] = varid;
+			block->locations[items] = location;
+			block->offsets[items] = used;
+
+			for (j = 0; j < dep->count; j++) {
+				conditional = pse->conditionals[dep->offset + j];
+
+				if (pse_is_registered(pse, conditional) == PSE_FALSE)
+					return PSE_ERROR_DEPENDENCY_UNKNOWN;
+
+				block->evidence[used++] = pse_evidence(pse->variables[conditional], location);
+			}
+
+			items++;
+		}
+	}
+
+	block->offsets[items] = used;
+	block->items = items;
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Draw one location in place. Numeric contents share one representation per
+ * width in the content union, so time is handled as double.
+ */
+double pse_gibbs_draw(pse_agent_stub *pse, pse_varid varid, unsigned int location,
+						double *pars, pse_sampler_cache *cache) {
+	pse_variable *var = pse->variables[varid];
+	int *p_to_int;
+	double *p_to_double;
+
+	pse_rng_position(pse, varid);
+
+	if (var->storage == PSE_VAR_INT) {
+		p_to_int = (var->array == PSE_SCALAR) ? &(var->content.cint) :
+						&(var->content.cint_a[location]);
+		*p_to_int = var->sample_int(*p_to_int, pars, cache);
+
+		return *p_to_int;
+	}
+
+	p_to_double = (var->array == PSE_SCALAR) ? &(var->content.cdouble) :
+					&(var->content.cdouble_a[location]);
+	*p_to_double = var->sample_double(*p_to_double, pars, cache);
+
+	return *p_to_double;
+}
+
+/*
+ * One sweep over all levels. With a block prior, the conditioned parameters
+ * of a level differ from item to item, so their sampler constants go through
+ * a scratch cache that is only set up again when they change.
+ */
+pse_error pse_gibbs_sweep(pse_agent_stub *pse, pse_prior_block *block,
+						pse_sampler_cache *scratch, unsigned int record) {
+	double parameters[PSE_MAX_DIST_PARAMS];
+	pse_sampler_cache *cache;
+	pse_variable *var;
+	pse_varid varid;
+	pse_error error;
+	unsigned int locations;
+	unsigned int location;
+	unsigned int level;
+	unsigned int item;
+	unsigned int i;
+	double *pars;
+	double value;
+
+	for (level = 0; level < pse->level_count; level++) {
+		if (pse->block_priors != NULL) {
+			error = pse_gibbs_gather(pse, level, block);
+
+			if (error != PSE_ERROR_OK)
+				return error;
+
+			pse->block_priors(block);
+		}
+
+		item = 0;
+
+		for (i = pse->level_offsets[level]; i < pse->level_offsets[level + 1]; i++) {
+			varid = pse->order[i];
+			var = pse->variables[varid];
+			locations = pse_gibbs_locations(var);
+
+			for (location = 0; location < locations; location++) {
+				if (pse->block_priors == NULL) {
+					pars = pse_condition(pse, varid, location, &cache, &error);
+
+					if (pars == NULL)
+						return error;
+				} else {
+					memcpy(parameters, var->point_parameters, PSE_MAX_DIST_PARAMS*sizeof(double));
+					parameters[pse_conditioned_parameter(var->point_distribution)] =
+								block->priors[item++];
+					pars = parameters;
+
+					if (pse_is_configured_distribution(var->point_distribution) == PSE_TRUE) {
+						cache = &(var->point_cache);
+					} else {
+						pse_refresh_cache(var->point_distribution, parameters, scratch);
+						cache = scratch;
+					}
+				}
+
+				value = pse_gibbs_draw(pse, varid, location, pars, cache);
+
+				if (record == PSE_TRUE && pse->recorder != NULL)
+					pse_rec_append(pse->recorder, pse->agent, varid, location, value);
+			}
+
+			if (locations > 0)
+				pse_touch(pse, varid);
+		}
+	}
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Supply a block prior (see psegibbs.h). Like priors of single dependencies,
+ * it is part of the configuration of the stub, and started stubs only take
+ * one a restore left pending.
+ */
+pse_error pse_supply_block_prior(pse_agent_stub *pse, void (*priors)(pse_prior_block *)) {
+	if (pse->state == CREATED)
+		return PSE_ERROR_NOT_INITIALIZED;
+
+	if (pse->state == STARTED && pse->block_prior_pending == PSE_FALSE)
+		return PSE_ERROR_ALREADY_STARTED;
+
+	if (pse->state == FINALIZED)
+		return PSE_ERROR_ALREADY_FINALIZED;
+
+	pse->block_priors = priors;
+	pse->block_prior_pending = PSE_FALSE;
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Gibbs sweeps
+ */
+pse_error pse_gibbs(pse_agent_stub *pse, unsigned int sweeps, unsigned int burn_in) {
+	pse_sampler_cache scratch;
+	pse_prior_block block;
+	rng_state *previous;
+	pse_error error = PSE_ERROR_OK;
+	unsigned int sweep;
+	unsigned int i;
+
+	if (pse->state == CREATED || pse->state == INITIALIZED)
+		return PSE_ERROR_NOT_INITIALIZED;
+
+	if (pse->state == FINALIZED)
+		return PSE_ERROR_ALREADY_FINALIZED;
+
+	if (pse->block_prior_pending == PSE_TRUE)
+		return PSE_ERROR_PRIOR_MISSING;
+
+	for (i = 0; i < pse->order_count; i++) {
+		if (pse_gibbs_locations(pse->variables[pse->order[i]]) > 0 &&
+			pse->variables[pse->order[i]]->sampler_pending == PSE_TRUE)
+			return PSE_ERROR_SAMPLER_MISSING;
+	}
+
+	memset(&block, 0, sizeof(pse_prior_block));
+	memset(&scratch, 0, sizeof(pse_sampler_cache));
+
+	if (pse->block_priors != NULL) {
+		error = pse_gibbs_allocate(pse, &block);
+
+		if (error != PSE_ERROR_OK)
+			return error;
+	}
+
+	previous = rng_state_bind(&pse->rng);
+
+	for (sweep = 0; sweep < burn_in + sweeps && error == PSE_ERROR_OK; sweep++)
+		error = pse_gibbs_sweep(pse, &block, &scratch, sweep >= burn_in);
+
+	rng_state_bind(previous);
+	pse_gibbs_release(&block);
+
+	return error;
+}
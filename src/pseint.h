@@ -0,0 +1,54 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+
+#ifndef PSEINT_H
+#define PSEINT_H
+
+#include <pse.h>
+
+/*
+ * Routines of the agent stubs (see pse.c) shared with the other modules of
+ * the library. This header is private: it is not installed and must not be
+ * included by applications.
+ */
+
+/*
+ * Variables and dependencies
+ */
+int pse_sizeof(pse_variable *);
+unsigned int pse_is_registered(pse_agent_stub *, pse_varid);
+pse_error pse_build_graph(pse_agent_stub *);
+void pse_release_graph(pse_agent_stub *);
+
+/*
+ * Samplers and their caches
+ */
+pse_int_sampler pse_resolve_int_sampler(pse_distribution_type);
+pse_double_sampler pse_resolve_double_sampler(pse_distribution_type, pse_sampler_type);
+void pse_refresh_cache(pse_distribution_type, double *, pse_sampler_cache *);
+void pse_release_cache(pse_distribution_type, pse_sampler_cache *);
+void pse_sde_update(unsigned int, double *, double *, pse_sampler_cache *,
+						pse_time *, double *, double *);
+
+/*
+ * Conditioning
+ */
+unsigned int pse_conditioned_parameter(pse_distribution_type);
+unsigned int pse_is_configured_distribution(pse_distribution_type);
+unsigned int pse_evidence(pse_variable *, unsigned int);
+double * pse_condition(pse_agent_stub *, pse_varid, unsigned int,
+						pse_sampler_cache **, pse_error *);
+
+/*
+ * Seeds
+ */
+int pse_fold_seed(int, int);
+
+#endif
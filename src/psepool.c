@@ -0,0 +1,229 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+#include <stdlib.h>
+#include <psepool.h>
+
+/*
+ * Declaration of private functions
+ */
+int pse_pool_take(pse_pool *, unsigned int, unsigned int *);
+int pse_pool_steal(pse_pool *, unsigned int, unsigned int *);
+void pse_pool_work(pse_pool *, unsigned int);
+void * pse_pool_thread(void *);
+
+/*
+ * Take the next task from the front of a worker's own range.
+ */
+int pse_pool_take(pse_pool *pool, unsigned int id, unsigned int *task) {
+	pse_pool_deque *deque = &(pool->deques[id]);
+	int found = 0;
+
+	pthread_mutex_lock(&deque->lock);
+
+	if (deque->head < deque->tail) {
+		*task = deque->head++;
+		found = 1;
+	}
+
+	pthread_mutex_unlock(&deque->lock);
+
+	return found;
+}
+
+/*
+ * Take a task from the back of the range of some other worker. Victims are
+ * visited in order starting after the thief.
+ */
+int pse_pool_steal(pse_pool *pool, unsigned int id, unsigned int *task) {
+	pse_pool_deque *deque;
+	unsigned int k;
+	int found = 0;
+
+	for (k = 1; k < pool->size && !found; k++) {
+		deque = &(pool->deques[(id + k) % pool->size]);
+
+		pthread_mutex_lock(&deque->lock);
+
+		if (deque->head < deque->tail) {
+			*task = --deque->tail;
+			found = 1;
+		}
+
+		pthread_mutex_unlock(&deque->lock);
+	}
+
+	return found;
+}
+
+/*
+ * Run tasks until none is left anywhere.
+ */
+void pse_pool_work(pse_pool *pool, unsigned int id) {
+	unsigned int task;
+
+	while (pse_pool_take(pool, id, &task) || pse_pool_steal(pool, id, &task))
+		pool->task(pool->arg, id, task);
+}
+
+void * pse_pool_thread(void *data) {
+	pse_pool_worker *worker = (pse_pool_worker *) data;
+	pse_pool *pool = worker->pool;
+	unsigned int seen = 0;
+
+	pthread_mutex_lock(&pool->lock);
+
+	for (;;) {
+		while (pool->generation == seen && !pool->shutdown)
+			pthread_cond_wait(&pool->wake, &pool->lock);
+
+		if (pool->shutdown)
+			break;
+
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+
+		pse_pool_work(pool, worker->id);
+
+		pthread_mutex_lock(&pool->lock);
+
+		if (--pool->running == 0)
+			pthread_cond_signal(&pool->done);
+	}
+
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+/*
+ * Create a pool of the given size (at least one worker). Returns NULL if
+ * memory or threads could not be obtained.
+ */
+pse_pool * pse_pool_create(unsigned int size) {
+	pse_pool *pool;
+	unsigned int i;
+
+	if (size == 0)
+		size = 1;
+
+	pool = (pse_pool *) malloc(sizeof(pse_pool));
+
+	if (pool == NULL)
+		return NULL;
+
+	pool->size = size;
+	pool->threads = (pthread_t *) malloc(sizeof(pthread_t)*size);
+	pool->workers = (pse_pool_worker *) malloc(sizeof(pse_pool_worker)*size);
+	pool->deques = (pse_pool_deque *) malloc(sizeof(pse_pool_deque)*size);
+
+	if (pool->threads == NULL || pool->workers == NULL || pool->deques == NULL) {
+		free(pool->threads);
+		free(pool->workers);
+		free(pool->deques);
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	pool->generation = 0;
+	pool->running = 0;
+	pool->shutdown = 0;
+	pool->task = NULL;
+	pool->arg = NULL;
+
+	for (i = 0; i < size; i++) {
+		pthread_mutex_init(&pool->deques[i].lock, NULL);
+		pool->deques[i].head = 0;
+		pool->deques[i].tail = 0;
+		pool->workers[i].pool = pool;
+		pool->workers[i].id = i;
+	}
+
+	for (i = 1; i < size; i++) {
+		if (pthread_create(&pool->threads[i], NULL, pse_pool_thread,
+							&pool->workers[i]) != 0) {
+			pool->size = i;
+			pse_pool_destroy(pool);
+			return NULL;
+		}
+	}
+
+	return pool;
+}
+
+/*
+ * Stop the workers and release the pool.
+ */
+void pse_pool_destroy(pse_pool *pool) {
+	unsigned int i;
+
+	if (pool == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = 1;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 1; i < pool->size; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	for (i = 0; i < pool->size; i++)
+		pthread_mutex_destroy(&pool->deques[i].lock);
+
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->wake);
+	pthread_cond_destroy(&pool->done);
+
+	free(pool->threads);
+	free(pool->workers);
+	free(pool->deques);
+	free(pool);
+}
+
+/*
+ * Run tasks 0..count-1 and return once all of them have completed.
+ */
+void pse_pool_run(pse_pool *pool, pse_pool_task task, void *arg, unsigned int count) {
+	unsigned int i;
+	unsigned int share = count/pool->size;
+	unsigned int extra = count%pool->size;
+	unsigned int next = 0;
+
+	for (i = 0; i < pool->size; i++) {
+		pool->deques[i].head = next;
+		next += share + ((i < extra) ? 1 : 0);
+		pool->deques[i].tail = next;
+	}
+
+	pool->task = task;
+	pool->arg = arg;
+
+	if (pool->size > 1) {
+		pthread_mutex_lock(&pool->lock);
+		pool->running = pool->size - 1;
+		pool->generation++;
+		pthread_cond_broadcast(&pool->wake);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	pse_pool_work(pool, 0);
+
+	if (pool->size > 1) {
+		pthread_mutex_lock(&pool->lock);
+
+		while (pool->running > 0)
+			pthread_cond_wait(&pool->done, &pool->lock);
+
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
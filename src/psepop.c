@@ -0,0 +1,800 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+#include <ranlib.h>
+#include <rnglib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <psepop.h>
+#include <psesimd.h>
+#include <sys/mman.h>
+#include "pseint.h"
+
+/*
+ * Declaration of private functions
+ */
+void pse_pop_position(pse_population *, pse_varid, unsigned int);
+unsigned int pse_pop_observe_simd(pse_population *, pse_column *, pse_varid,
+						unsigned int, unsigned int, double *);
+void pse_pop_observe_sde(pse_population *, pse_column *, pse_varid, unsigned int,
+						unsigned int, double *);
+void pse_pop_observe_custom(pse_population *, pse_column *, pse_varid, unsigned int,
+						unsigned int, pse_content);
+void pse_pop_sample_range(pse_population *, pse_varid, unsigned int, unsigned int,
+						pse_content);
+unsigned int pse_pop_steps(pse_column *);
+unsigned int pse_pop_clocked(pse_column *);
+void pse_pop_step_task(void *, unsigned int, unsigned int);
+
+/*
+ * Arguments shared by the tasks of one step
+ */
+typedef struct pse_pop_step_args {
+	pse_population *pop;
+	unsigned int chunks;
+	unsigned int clocked;
+} pse_pop_step_args;
+
+/*
+ * Position the generator for one agent of a column. With the counter-based
+ * generator each agent is its own key, so results do not depend on the order
+ * in which agents are visited.
+ */
+void pse_pop_position(pse_population *pop, pse_varid colid, unsigned int agent) {
+	pse_column *col = &(pop->columns[colid]);
+
+	if (pop->rng.backend == RNG_BACKEND_PHILOX) {
+		rng_philox_set_key(pop->seed, agent);
+		rng_philox_set_counter((unsigned int)colid, (unsigned int)col->step,
+								(unsigned int)(col->step >> 32));
+	}
+}
+
+/*
+ * Vectorized pass for uniform columns, and for normal and exponential columns
+ * under PSE_SAMPLER_CLASSIC. Each agent still draws its own uniforms from its
+ * own position, so results remain independent of the order of agents. With
+ * the counter-based generator the positions of a block of agents are
+ * computed in vector lanes, as is the transformation of the block. Returns
+ * PSE_FALSE when the column has no vector kernel. Agents [begin, end) are
+ * processed in blocks starting at begin.
+ */
+unsigned int pse_pop_observe_simd(pse_population *pop, pse_column *col,
+						pse_varid colid, unsigned int begin, unsigned int end,
+						double *out) {
+	double u1[PSE_SIMD_BLOCK];
+	double u2[PSE_SIMD_BLOCK];
+	double v[PSE_SIMD_BLOCK];
+	double spare[PSE_SIMD_BLOCK];
+	double *values = col->values.cdouble_a;
+	double *pars = col->point_parameters;
+	unsigned int first;
+	unsigned int n;
+	unsigned int i;
+
+	switch(col->point_distribution) {
+	case PSE_DIST_UNIFORM_DOUBLE_SELF:
+	case PSE_DIST_UNIFORM_DOUBLE_BOUNDED:
+		break;
+	case PSE_DIST_NORMAL:
+	case PSE_DIST_NORMAL_SELF:
+	case PSE_DIST_EXPONENTIAL:
+	case PSE_DIST_EXPONENTIAL_SELF:
+		if (pop->sampler == PSE_SAMPLER_CLASSIC)
+			break;
+		return PSE_FALSE;
+	default:
+		return PSE_FALSE;
+	}
+
+	for (first = begin; first < end; first += n) {
+		n = end - first;
+
+		if (n > PSE_SIMD_BLOCK)
+			n = PSE_SIMD_BLOCK;
+
+		if (pop->rng.backend == RNG_BACKEND_PHILOX) {
+			pse_simd_uniform_pairs(pop->seed, first, (unsigned int)colid,
+							(unsigned int)col->step, (unsigned int)(col->step >> 32),
+							u1, u2, n);
+		} else {
+			for (i = 0; i < n; i++) {
+				pse_pop_position(pop, colid, first + i);
+				u1[i] = r8_uni_01();
+				u2[i] = r8_uni_01();
+			}
+		}
+
+		switch(col->point_distribution) {
+		case PSE_DIST_UNIFORM_DOUBLE_SELF:
+			for (i = 0; i < n; i++)
+				v[i] = u1[i]*values[first + i];
+			break;
+		case PSE_DIST_UNIFORM_DOUBLE_BOUNDED:
+			pse_simd_affine(u1, v, n, pars[0], pars[1] - pars[0]);
+			break;
+		case PSE_DIST_NORMAL:
+			pse_simd_normal_transform(u1, u2, v, spare, n);
+			pse_simd_affine(v, v, n, pars[0], pars[1]);
+			break;
+		case PSE_DIST_NORMAL_SELF:
+			pse_simd_normal_transform(u1, u2, v, spare, n);
+			for (i = 0; i < n; i++)
+				v[i] = values[first + i] + pars[0]*v[i];
+			break;
+		case PSE_DIST_EXPONENTIAL:
+			pse_simd_exponential_transform(u1, v, n);
+			pse_simd_affine(v, v, n, 0, pars[0]);
+			break;
+		default:
+			pse_simd_exponential_transform(u1, v, n);
+			for (i = 0; i < n; i++)
+				v[i] = values[first + i]*v[i];
+			break;
+		}
+
+		if (out != NULL)
+			memcpy(out + first, v, sizeof(double)*n);
+
+		if (col->read_and_alter == PSE_TRUE)
+			memcpy(values + first, v, sizeof(double)*n);
+	}
+
+	return PSE_TRUE;
+}
+
+/*
+ * Population initialization.
+ *
+ * The number of agents is fixed for the lifetime of the population.
+ */
+pse_error pse_pop_init(pse_population *pop, unsigned int agent_count) {
+	if (pop->state == INITIALIZED)
+		return PSE_ERROR_ALREADY_INITIALIZED;
+
+	if (pop->state == STARTED)
+		return PSE_ERROR_ALREADY_STARTED;
+
+	if (pop->state == FINALIZED)
+		return PSE_ERROR_ALREADY_FINALIZED;
+
+	pop->columns = (pse_column *) malloc(sizeof(pse_column)*PSE_POP_INITIAL_COLUMNS);
+
+	if (pop->columns == NULL)
+		return PSE_ERROR_TOO_MANY_VARIABLES;
+
+	memset(&pop->rng, 0, sizeof(rng_state));
+	pop->pool = NULL;
+	pop->worker_rng = NULL;
+	pop->mapping = NULL;
+	pop->mapping_size = 0;
+
+	pop->agent_count = agent_count;
+	pop->column_count = 0;
+	pop->column_limit = PSE_POP_INITIAL_COLUMNS;
+	pop->seed = 0;
+	pop->sampler = PSE_DEFAULT_SAMPLER;
+	pop->state = INITIALIZED;
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Population start
+ *
+ * Seeds follow pse_start_rng(). With PSE_RNG_PHILOX only the first seed is
+ * used; agent indices play the role of agent identifiers.
+ */
+pse_error pse_pop_start(pse_population *pop, pse_rng_type rng, int seed_1, int seed_2) {
+	rng_state *previous;
+
+	if (pop->state == CREATED)
+		return PSE_ERROR_NOT_INITIALIZED;
+
+	if (pop->state == STARTED)
+		return PSE_ERROR_ALREADY_STARTED;
+
+	if (pop->state == FINALIZED)
+		return PSE_ERROR_ALREADY_FINALIZED;
+
+	previous = rng_state_bind(&pop->rng);
+	initialize();
+
+	switch(rng) {
+	case PSE_RNG_LECUYER:
+		set_initial_seed(pse_fold_seed(seed_1, PSE_RNG_M1),
+							pse_fold_seed(seed_2, PSE_RNG_M2));
+		break;
+	case PSE_RNG_PHILOX:
+		pop->seed = (unsigned int)seed_1;
+		rng_philox_set_key(pop->seed, 0);
+		break;
+	default:
+		rng_state_bind(previous);
+		return PSE_ERROR_TYPE_UNKNOWN;
+	}
+
+	rng_state_bind(previous);
+
+	pop->state = STARTED;
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Sampler selection, as pse_set_sampler() for stubs
+ */
+pse_error pse_pop_set_sampler(pse_population *pop, pse_sampler_type sampler) {
+	unsigned int i;
+
+	if (pop->state == CREATED)
+		return PSE_ERROR_NOT_INITIALIZED;
+
+	if (pop->state == STARTED)
+		return PSE_ERROR_ALREADY_STARTED;
+
+	if (pop->state == FINALIZED)
+		return PSE_ERROR_ALREADY_FINALIZED;
+
+	if (sampler != PSE_SAMPLER_ZIGGURAT && sampler != PSE_SAMPLER_CLASSIC)
+		return PSE_ERROR_TYPE_UNKNOWN;
+
+	pop->sampler = sampler;
+
+	for (i = 0; i < pop->column_count; i++)
+		pop->columns[i].sample_double = pse_resolve_double_sampler(
+								pop->columns[i].point_distribution, sampler);
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Population finalization
+ */
+pse_error pse_pop_finalize(pse_population *pop) {
+	unsigned int i;
+	char *values;
+
+	if (pop->state == FINALIZED)
+		return PSE_ERROR_ALREADY_FINALIZED;
+
+	if (pop->state == INITIALIZED)
+		return PSE_ERROR_NOT_STARTED;
+
+	/*
+	 * Values inside the mapping of a snapshot are released with it
+	 */
+	for (i = 0; i < pop->column_count; i++) {
+		pse_release_cache(pop->columns[i].point_distribution, &pop->columns[i].point_cache);
+		values = (char *) pop->columns[i].values.cdouble_a;
+
+		if (pop->mapping == NULL || values < (char *) pop->mapping ||
+			values > (char *) pop->mapping + pop->mapping_size)
+			free(values);
+	}
+
+	free(pop->columns);
+	pop->columns = NULL;
+
+	if (pop->mapping != NULL)
+		munmap(pop->mapping, (size_t) pop->mapping_size);
+
+	pop->mapping = NULL;
+	pop->mapping_size = 0;
+
+	pse_pool_destroy(pop->pool);
+	free(pop->worker_rng);
+	pop->pool = NULL;
+	pop->worker_rng = NULL;
+
+	pop->column_count = 0;
+	pop->column_limit = 0;
+	pop->state = FINALIZED;
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Column registration
+ *
+ * Registers a variable for every agent at once. Values start at zero and are
+ * stored contiguously, one element per agent.
+ */
+pse_varid pse_pop_register(pse_population *pop, pse_storage_type storage,
+						pse_model_type model, pse_distribution_type point_distribution,
+						double *point_parameters, unsigned int read_and_alter,
+						char *name) {
+	pse_column *col;
+	pse_column *grown;
+	size_t element_size;
+
+	if (pop->state == CREATED)
+		return PSE_ERROR_NOT_INITIALIZED;
+
+	if (pop->state == STARTED)
+		return PSE_ERROR_ALREADY_STARTED;
+
+	if (pop->state == FINALIZED)
+		return PSE_ERROR_ALREADY_FINALIZED;
+
+	if (strlen(name) >= PSE_VARNAME_SIZE)
+		return PSE_ERROR_NAME_TOO_LONG;
+
+	switch(storage) {
+	case PSE_VAR_INT:
+		element_size = sizeof(int);
+		break;
+	case PSE_VAR_DOUBLE:
+		element_size = sizeof(double);
+		break;
+	case PSE_VAR_TIME:
+		element_size = sizeof(pse_time);
+		break;
+	default:
+		return PSE_ERROR_TYPE_UNKNOWN;
+	}
+
+	if (pop->column_count == pop->column_limit) {
+		grown = (pse_column *) realloc(pop->columns,
+							sizeof(pse_column)*pop->column_limit*2);
+
+		if (grown == NULL)
+			return PSE_ERROR_TOO_MANY_VARIABLES;
+
+		pop->columns = grown;
+		pop->column_limit *= 2;
+	}
+
+	col = &(pop->columns[pop->column_count]);
+	col->storage = storage;
+	col->model = model;
+	col->point_distribution = point_distribution;
+	memcpy(col->point_parameters, point_parameters, PSE_MAX_DIST_PARAMS*sizeof(double));
+	memset(&col->point_cache, 0, sizeof(pse_sampler_cache));
+	pse_refresh_cache(point_distribution, col->point_parameters, &col->point_cache);
+	col->sample_int = pse_resolve_int_sampler(point_distribution);
+	col->sample_double = pse_resolve_double_sampler(point_distribution, pop->sampler);
+	col->sampler_pending = PSE_FALSE;
+	col->read_and_alter = read_and_alter;
+	strcpy(col->name, name);
+	col->step = 0;
+
+	/*
+	 * All storage types share the same pointer in the union.
+	 */
+	col->values.cdouble_a = (double *) calloc(pop->agent_count, element_size);
+
+	if (col->values.cdouble_a == NULL && pop->agent_count > 0)
+		return PSE_ERROR_TOO_MANY_VARIABLES;
+
+	return pop->column_count++;
+}
+
+/*
+ * Prepare the value of one agent in a column.
+ */
+void pse_pop_prepare(pse_population *pop, pse_varid colid, unsigned int agent,
+						pse_content content, pse_storage_type storage, pse_error *error) {
+	pse_column *col;
+
+	if (pop->state == CREATED || pop->state == INITIALIZED) {
+		*error = PSE_ERROR_NOT_INITIALIZED;
+		return;
+	}
+
+	if (pop->state == FINALIZED) {
+		*error = PSE_ERROR_ALREADY_FINALIZED;
+		return;
+	}
+
+	if (colid < 0 || (unsigned int)colid >= pop->column_count) {
+		*error = PSE_ERROR_VARIABLE_UNKNOWN;
+		return;
+	}
+
+	col = &(pop->columns[colid]);
+
+	if (col->storage != storage) {
+		*error = PSE_ERROR_TYPE_MISMATCH;
+		return;
+	}
+
+	if (agent >= pop->agent_count) {
+		*error = PSE_ERROR_ARRAY_OUTOFBOUNDS;
+		return;
+	}
+
+	switch(col->storage) {
+	case PSE_VAR_INT:
+		col->values.cint_a[agent] = content.cint;
+		break;
+	case PSE_VAR_DOUBLE:
+		col->values.cdouble_a[agent] = content.cdouble;
+		break;
+	case PSE_VAR_TIME:
+		col->values.ctime_a[agent] = content.ctime;
+		break;
+	default:
+		*error = PSE_ERROR_TYPE_UNKNOWN;
+		return;
+	}
+
+	*error = PSE_ERROR_OK;
+}
+
+/*
+ * Euler-Maruyama pass for FOKKER_PLANCK columns (double or time). Each agent
+ * draws its standard normal from its own position with the sampler of the
+ * population, so agents draw exactly what stubs draw; the model is evaluated
+ * for a block of agents at once. With a clock column, each agent steps by its
+ * own value of the clock.
+ */
+void pse_pop_observe_sde(pse_population *pop, pse_column *col, pse_varid colid,
+						unsigned int begin, unsigned int end, double *out) {
+	double z[PSE_SIMD_BLOCK];
+	double v[PSE_SIMD_BLOCK];
+	double *values = col->values.cdouble_a;
+	pse_time *steps = col->point_cache.sde.step;
+	unsigned int first;
+	unsigned int n;
+	unsigned int i;
+
+	for (first = begin; first < end; first += n) {
+		n = end - first;
+
+		if (n > PSE_SIMD_BLOCK)
+			n = PSE_SIMD_BLOCK;
+
+		for (i = 0; i < n; i++) {
+			pse_pop_position(pop, colid, first + i);
+			z[i] = (pop->sampler == PSE_SAMPLER_ZIGGURAT) ? snorm_zig_r8() : snorm_r8();
+		}
+
+		pse_sde_update(n, values + first, col->point_parameters, &col->point_cache,
+						(steps != NULL) ? steps + first : NULL, z, v);
+
+		for (i = 0; i < n; i++) {
+			if (out != NULL)
+				out[first + i] = v[i];
+
+			if (col->read_and_alter == PSE_TRUE)
+				values[first + i] = v[i];
+		}
+	}
+}
+
+/*
+ * Pass for CUSTOM columns. The sampler is called once per block of
+ * PSE_SIMD_BLOCK agents, with the generator positioned at the first agent of
+ * the block. Blocks start at multiples of PSE_SIMD_BLOCK from begin, so they
+ * line up between observations and steps.
+ */
+void pse_pop_observe_custom(pse_population *pop, pse_column *col, pse_varid colid,
+						unsigned int begin, unsigned int end, pse_content out) {
+	double v[PSE_SIMD_BLOCK];
+	pse_custom_sampler sampler = col->point_cache.custom;
+	unsigned int first;
+	unsigned int n;
+	unsigned int i;
+
+	for (first = begin; first < end; first += n) {
+		n = end - first;
+
+		if (n > PSE_SIMD_BLOCK)
+			n = PSE_SIMD_BLOCK;
+
+		for (i = 0; i < n; i++)
+			v[i] = (col->storage == PSE_VAR_INT) ? col->values.cint_a[first + i] :
+						col->values.cdouble_a[first + i];
+
+		if (sampler != NULL) {
+			pse_pop_position(pop, colid, first);
+			sampler(rng_state_get(), col->point_parameters, v, v, n);
+		}
+
+		if (col->storage == PSE_VAR_INT) {
+			for (i = 0; i < n; i++) {
+				if (out.cint_a != NULL)
+					out.cint_a[first + i] = round(v[i]);
+
+				if (col->read_and_alter == PSE_TRUE)
+					col->values.cint_a[first + i] = round(v[i]);
+			}
+		} else {
+			for (i = 0; i < n; i++) {
+				if (out.cdouble_a != NULL)
+					out.cdouble_a[first + i] = v[i];
+
+				if (col->read_and_alter == PSE_TRUE)
+					col->values.cdouble_a[first + i] = v[i];
+			}
+		}
+	}
+}
+
+/*
+ * Sample agents [begin, end) of a column with the generator bound to the
+ * calling thread. The step of the column is not advanced.
+ */
+void pse_pop_sample_range(pse_population *pop, pse_varid colid, unsigned int begin,
+						unsigned int end, pse_content out) {
+	unsigned int i;
+	int ivalue;
+	double dvalue;
+	pse_column *col = &(pop->columns[colid]);
+
+	if (col->storage != PSE_VAR_INT && col->point_distribution == PSE_DIST_FOKKER_PLANCK) {
+		pse_pop_observe_sde(pop, col, colid, begin, end, out.cdouble_a);
+	} else if (col->point_distribution == PSE_DIST_CUSTOM) {
+		pse_pop_observe_custom(pop, col, colid, begin, end, out);
+	} else if (col->storage == PSE_VAR_INT) {
+		for (i = begin; i < end; i++) {
+			pse_pop_position(pop, colid, i);
+			ivalue = col->sample_int(col->values.cint_a[i],
+							col->point_parameters, &col->point_cache);
+
+			if (out.cint_a != NULL)
+				out.cint_a[i] = ivalue;
+
+			if (col->read_and_alter == PSE_TRUE)
+				col->values.cint_a[i] = ivalue;
+		}
+	} else if (col->storage != PSE_VAR_DOUBLE ||
+				pse_pop_observe_simd(pop, col, colid, begin, end, out.cdouble_a) == PSE_FALSE) {
+		for (i = begin; i < end; i++) {
+			pse_pop_position(pop, colid, i);
+			dvalue = col->sample_double(col->values.cdouble_a[i],
+							col->point_parameters, &col->point_cache);
+
+			if (out.cdouble_a != NULL)
+				out.cdouble_a[i] = dvalue;
+
+			if (col->read_and_alter == PSE_TRUE)
+				col->values.cdouble_a[i] = dvalue;
+		}
+	}
+}
+
+/*
+ * Column observe function
+ *
+ * Produces one observation per agent in a single pass over the column. The
+ * observations are written into the matching buffer of out (cint_a, cdouble_a
+ * or ctime_a), which must hold one element per agent. With read_and_alter,
+ * the observations also replace the stored values; in that case the buffer
+ * may be NULL to update the column in place only.
+ */
+void pse_pop_observe(pse_population *pop, pse_varid colid, pse_content out,
+						pse_storage_type storage, pse_error *error) {
+	pse_column *col;
+	rng_state *previous;
+
+	if (pop->state == CREATED || pop->state == INITIALIZED) {
+		*error = PSE_ERROR_NOT_INITIALIZED;
+		return;
+	}
+
+	if (pop->state == FINALIZED) {
+		*error = PSE_ERROR_ALREADY_FINALIZED;
+		return;
+	}
+
+	if (colid < 0 || (unsigned int)colid >= pop->column_count) {
+		*error = PSE_ERROR_VARIABLE_UNKNOWN;
+		return;
+	}
+
+	col = &(pop->columns[colid]);
+
+	if (col->storage != storage) {
+		*error = PSE_ERROR_TYPE_MISMATCH;
+		return;
+	}
+
+	if (out.cdouble_a == NULL && !(col->model == PSE_VAR_STOCHASTIC &&
+							col->read_and_alter == PSE_TRUE)) {
+		*error = PSE_ERROR_VARIABLE_IS_IMMUTABLE;
+		return;
+	}
+
+	if (col->model == PSE_VAR_DETERMINISTIC) {
+		if (col->storage == PSE_VAR_INT)
+			memcpy(out.cint_a, col->values.cint_a, sizeof(int)*pop->agent_count);
+		else
+			memcpy(out.cdouble_a, col->values.cdouble_a, sizeof(double)*pop->agent_count);
+
+		*error = PSE_ERROR_OK;
+		return;
+	}
+
+	if (col->sampler_pending == PSE_TRUE) {
+		*error = PSE_ERROR_SAMPLER_MISSING;
+		return;
+	}
+
+	previous = rng_state_bind(&pop->rng);
+	pse_pop_sample_range(pop, colid, 0, pop->agent_count, out);
+	rng_state_bind(previous);
+
+	col->step++;
+
+	*error = PSE_ERROR_OK;
+}
+
+/*
+ * Whether a column is updated by pse_pop_step()
+ */
+unsigned int pse_pop_steps(pse_column *col) {
+	return (col->model == PSE_VAR_STOCHASTIC && col->read_and_alter == PSE_TRUE) ?
+				PSE_TRUE : PSE_FALSE;
+}
+
+/*
+ * Whether a column is a FOKKER_PLANCK column reading a clock column. Such
+ * columns are stepped after all the others, once their clocks have moved.
+ */
+unsigned int pse_pop_clocked(pse_column *col) {
+	return (col->point_distribution == PSE_DIST_FOKKER_PLANCK &&
+				col->point_cache.sde.step != NULL) ? PSE_TRUE : PSE_FALSE;
+}
+
+/*
+ * One task of a step: one chunk of agents of one column. Chunks start at
+ * multiples of PSE_POP_CHUNK, so vector blocks line up with those of
+ * pse_pop_observe() and results do not depend on which worker runs a chunk.
+ * Only the columns of the current phase (clocked or not) are stepped.
+ */
+void pse_pop_step_task(void *data, unsigned int worker, unsigned int task) {
+	pse_pop_step_args *args = (pse_pop_step_args *) data;
+	pse_population *pop = args->pop;
+	pse_varid colid = (pse_varid)(task/args->chunks);
+	unsigned int begin = (task%args->chunks)*PSE_POP_CHUNK;
+	unsigned int end = begin + PSE_POP_CHUNK;
+	rng_state *previous;
+	pse_content out;
+
+	if (pse_pop_steps(&(pop->columns[colid])) == PSE_FALSE ||
+			pse_pop_clocked(&(pop->columns[colid])) != args->clocked)
+		return;
+
+	if (end > pop->agent_count)
+		end = pop->agent_count;
+
+	out.cdouble_a = NULL;
+
+	previous = rng_state_bind(&(pop->worker_rng[worker]));
+	pse_pop_sample_range(pop, colid, begin, end, out);
+	rng_state_bind(previous);
+}
+
+/*
+ * Population step
+ *
+ * Observes all stochastic read_and_alter columns of all agents on a pool of
+ * nthreads workers (the caller being one of them). Every worker draws from
+ * its own generator: with PSE_RNG_PHILOX the result is the same as calling
+ * pse_pop_observe() on each column, whatever the number of threads; with
+ * PSE_RNG_LECUYER worker w uses generator w of the population, so results
+ * are valid but depend on how chunks were scheduled.
+ *
+ * The step runs in two phases: clocked FOKKER_PLANCK columns are only stepped
+ * once every other column, their clocks included, has been, so that no worker
+ * reads a clock another one is writing.
+ */
+void pse_pop_step(pse_population *pop, unsigned int nthreads, pse_error *error) {
+	pse_pop_step_args args;
+	rng_state *states;
+	unsigned int w;
+	unsigned int i;
+
+	if (pop->state == CREATED || pop->state == INITIALIZED) {
+		*error = PSE_ERROR_NOT_INITIALIZED;
+		return;
+	}
+
+	if (pop->state == FINALIZED) {
+		*error = PSE_ERROR_ALREADY_FINALIZED;
+		return;
+	}
+
+	for (i = 0; i < pop->column_count; i++) {
+		if (pse_pop_steps(&(pop->columns[i])) == PSE_TRUE &&
+				pop->columns[i].sampler_pending == PSE_TRUE) {
+			*error = PSE_ERROR_SAMPLER_MISSING;
+			return;
+		}
+	}
+
+	if (nthreads == 0)
+		nthreads = 1;
+
+	if (nthreads > RNG_G_MAX)
+		nthreads = RNG_G_MAX;
+
+	/*
+	 * The states are sized before the pool is created, so that a pool never
+	 * outlives a failed allocation with more workers than states.
+	 */
+	if (pop->pool == NULL || pop->pool->size != nthreads) {
+		pse_pool_destroy(pop->pool);
+		pop->pool = NULL;
+
+		states = (rng_state *) realloc(pop->worker_rng, sizeof(rng_state)*nthreads);
+
+		if (states == NULL) {
+			*error = PSE_ERROR_TOO_MANY_VARIABLES;
+			return;
+		}
+
+		pop->worker_rng = states;
+		pop->pool = pse_pool_create(nthreads);
+
+		if (pop->pool == NULL) {
+			*error = PSE_ERROR_TOO_MANY_VARIABLES;
+			return;
+		}
+	}
+
+	for (w = 0; w < nthreads; w++) {
+		pop->worker_rng[w] = pop->rng;
+		pop->worker_rng[w].g = (int)w;
+	}
+
+	/*
+	 * Sampler constants are brought up to date here, so that workers only
+	 * ever read them.
+	 */
+	for (i = 0; i < pop->column_count; i++)
+		pse_refresh_cache(pop->columns[i].point_distribution,
+							pop->columns[i].point_parameters,
+							&pop->columns[i].point_cache);
+
+	args.pop = pop;
+	args.chunks = (pop->agent_count + PSE_POP_CHUNK - 1)/PSE_POP_CHUNK;
+	args.clocked = PSE_FALSE;
+
+	pse_pool_run(pop->pool, pse_pop_step_task, &args, args.chunks*pop->column_count);
+
+	for (i = 0; i < pop->column_count; i++) {
+		if (pse_pop_steps(&(pop->columns[i])) == PSE_TRUE &&
+				pse_pop_clocked(&(pop->columns[i])) == PSE_TRUE)
+			break;
+	}
+
+	if (i < pop->column_count) {
+		args.clocked = PSE_TRUE;
+		pse_pool_run(pop->pool, pse_pop_step_task, &args, args.chunks*pop->column_count);
+	}
+
+	/*
+	 * Each worker only advanced its own generator; fold them back.
+	 */
+	if (pop->rng.backend == RNG_BACKEND_LECUYER) {
+		for (w = 0; w < nthreads; w++) {
+			pop->rng.cg1[w] = pop->worker_rng[w].cg1[w];
+			pop->rng.cg2[w] = pop->worker_rng[w].cg2[w];
+		}
+	}
+
+	for (i = 0; i < pop->column_count; i++) {
+		if (pse_pop_steps(&(pop->columns[i])) == PSE_TRUE)
+			pop->columns[i].step++;
+	}
+
+	*error = PSE_ERROR_OK;
+}
+
+/*
+ * Direct access to the values of a column, for instrumentation and for
+ * streaming reads. The content holds the typed array of the column.
+ */
+pse_content pse_pop_column(pse_population *pop, pse_varid colid) {
+	return pop->columns[colid].values;
+}
@@ -0,0 +1,310 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <pserec.h>
+
+/*
+ * Serial numbers tell recorders apart, even one opened where another was
+ * closed. Each thread remembers the ring it used last, and for which
+ * recorder, so that appending does not search for it.
+ */
+static unsigned int pse_rec_serials = 0;
+static __thread pse_recorder *pse_rec_last = NULL;
+static __thread unsigned int pse_rec_last_serial = 0;
+static __thread pse_rec_ring *pse_rec_last_ring = NULL;
+
+/*
+ * Declaration of private functions
+ */
+pse_rec_ring * pse_rec_ring_of(pse_recorder *);
+void pse_rec_drain(pse_recorder *, pse_rec_ring *, unsigned int);
+void * pse_rec_thread(void *);
+
+/*
+ * Ring of the calling thread, claimed on its first entry. Returns NULL once
+ * all rings are taken.
+ */
+pse_rec_ring * pse_rec_ring_of(pse_recorder *rec) {
+	pse_rec_ring *ring = NULL;
+	pthread_t self = pthread_self();
+	unsigned int i;
+
+	if (pse_rec_last == rec && pse_rec_last_serial == rec->serial)
+		return pse_rec_last_ring;
+
+	pthread_mutex_lock(&rec->lock);
+
+	for (i = 0; i < rec->ring_count && ring == NULL; i++) {
+		if (pthread_equal(rec->rings[i]->owner, self))
+			ring = rec->rings[i];
+	}
+
+	if (ring == NULL && rec->ring_count < PSE_REC_RINGS) {
+		ring = (pse_rec_ring *) malloc(sizeof(pse_rec_ring));
+
+		if (ring != NULL) {
+			ring->head = 0;
+			ring->tail = 0;
+			ring->owner = self;
+			ring->stalls = 0;
+			rec->rings[rec->ring_count++] = ring;
+		}
+	}
+
+	pthread_mutex_unlock(&rec->lock);
+
+	if (ring != NULL) {
+		pse_rec_last = rec;
+		pse_rec_last_serial = rec->serial;
+		pse_rec_last_ring = ring;
+	}
+
+	return ring;
+}
+
+/*
+ * Move every entry of a ring to the columns and write them as blocks. Slots
+ * are handed back to the producer before the (slow) write.
+ */
+void pse_rec_drain(pse_recorder *rec, pse_rec_ring *ring, unsigned int index) {
+	unsigned long long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	unsigned long long tail = ring->tail;
+	pse_rec_entry *entry;
+	pse_rec_block block;
+	unsigned int i;
+
+	while (tail != head) {
+		block.count = (unsigned int)(head - tail);
+		block.ring = index;
+
+		for (i = 0; i < block.count; i++) {
+			entry = &(ring->entries[(tail + i) & (PSE_REC_RING - 1)]);
+			rec->ticks[i] = entry->tick;
+			rec->agents[i] = entry->agent;
+			rec->varids[i] = entry->varid;
+			rec->locations[i] = entry->location;
+			rec->values[i] = entry->value;
+		}
+
+		tail += block.count;
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+		if (fwrite(&block, sizeof(pse_rec_block), 1, rec->fp) != 1 ||
+			fwrite(rec->ticks, sizeof(unsigned long long), block.count, rec->fp) != block.count ||
+			fwrite(rec->agents, sizeof(unsigned int), block.count, rec->fp) != block.count ||
+			fwrite(rec->varids, sizeof(pse_varid), block.count, rec->fp) != block.count ||
+			fwrite(rec->locations, sizeof(unsigned int), block.count, rec->fp) != block.count ||
+			fwrite(rec->values, sizeof(double), block.count, rec->fp) != block.count)
+			rec->error = PSE_ERROR_IO;
+
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	}
+}
+
+/*
+ * Writer thread. After shutdown is requested, it drains every ring once more
+ * and exits.
+ */
+void * pse_rec_thread(void *data) {
+	pse_recorder *rec = (pse_recorder *) data;
+	struct timespec deadline;
+	unsigned int count;
+	unsigned int stop;
+	unsigned int i;
+
+	pthread_mutex_lock(&rec->lock);
+
+	for (;;) {
+		if (!rec->shutdown) {
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_nsec += PSE_REC_INTERVAL*1000000L;
+
+			if (deadline.tv_nsec >= 1000000000L) {
+				deadline.tv_sec++;
+				deadline.tv_nsec -= 1000000000L;
+			}
+
+			pthread_cond_timedwait(&rec->wake, &rec->lock, &deadline);
+		}
+
+		count = rec->ring_count;
+		stop = rec->shutdown;
+		pthread_mutex_unlock(&rec->lock);
+
+		for (i = 0; i < count; i++)
+			pse_rec_drain(rec, rec->rings[i], i);
+
+		pthread_mutex_lock(&rec->lock);
+
+		if (stop)
+			break;
+	}
+
+	pthread_mutex_unlock(&rec->lock);
+
+	return NULL;
+}
+
+/*
+ * Recorder opening
+ */
+pse_error pse_rec_open(pse_recorder *rec, char *path) {
+	pse_rec_header header;
+
+	rec->fp = fopen(path, "wb");
+
+	if (rec->fp == NULL)
+		return PSE_ERROR_IO;
+
+	setvbuf(rec->fp, NULL, _IOFBF, 1 << 20);
+
+	rec->ticks = (unsigned long long *) malloc(sizeof(unsigned long long)*PSE_REC_RING);
+	rec->agents = (unsigned int *) malloc(sizeof(unsigned int)*PSE_REC_RING);
+	rec->varids = (pse_varid *) malloc(sizeof(pse_varid)*PSE_REC_RING);
+	rec->locations = (unsigned int *) malloc(sizeof(unsigned int)*PSE_REC_RING);
+	rec->values = (double *) malloc(sizeof(double)*PSE_REC_RING);
+
+	if (rec->ticks == NULL || rec->agents == NULL || rec->varids == NULL ||
+		rec->locations == NULL || rec->values == NULL) {
+		free(rec->ticks);
+		free(rec->agents);
+		free(rec->varids);
+		free(rec->locations);
+		free(rec->values);
+		fclose(rec->fp);
+		return PSE_ERROR_TOO_MANY_VARIABLES;
+	}
+
+	memset(&header, 0, sizeof(pse_rec_header));
+	strcpy(header.magic, PSE_REC_MAGIC);
+	header.version = PSE_REC_VERSION;
+	header.byte_order = PSE_REC_BYTE_ORDER;
+	fwrite(&header, sizeof(pse_rec_header), 1, rec->fp);
+
+	rec->serial = __atomic_add_fetch(&pse_rec_serials, 1, __ATOMIC_RELAXED);
+	rec->ring_count = 0;
+	rec->shutdown = 0;
+	rec->tick = 0;
+	rec->stalls = 0;
+	rec->dropped = 0;
+	rec->error = PSE_ERROR_OK;
+	pthread_mutex_init(&rec->lock, NULL);
+	pthread_cond_init(&rec->wake, NULL);
+
+	if (pthread_create(&rec->writer, NULL, pse_rec_thread, rec) != 0) {
+		pthread_mutex_destroy(&rec->lock);
+		pthread_cond_destroy(&rec->wake);
+		free(rec->ticks);
+		free(rec->agents);
+		free(rec->varids);
+		free(rec->locations);
+		free(rec->values);
+		fclose(rec->fp);
+		return PSE_ERROR_TOO_MANY_VARIABLES;
+	}
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Recorder closing
+ */
+pse_error pse_rec_close(pse_recorder *rec) {
+	unsigned int i;
+
+	pthread_mutex_lock(&rec->lock);
+	rec->shutdown = 1;
+	pthread_cond_signal(&rec->wake);
+	pthread_mutex_unlock(&rec->lock);
+
+	pthread_join(rec->writer, NULL);
+
+	for (i = 0; i < rec->ring_count; i++) {
+		rec->stalls += rec->rings[i]->stalls;
+		free(rec->rings[i]);
+	}
+
+	rec->ring_count = 0;
+	rec->serial = 0;
+
+	if (fclose(rec->fp) != 0)
+		rec->error = PSE_ERROR_IO;
+
+	pthread_mutex_destroy(&rec->lock);
+	pthread_cond_destroy(&rec->wake);
+	free(rec->ticks);
+	free(rec->agents);
+	free(rec->varids);
+	free(rec->locations);
+	free(rec->values);
+
+	return rec->error;
+}
+
+void pse_rec_tick(pse_recorder *rec, unsigned long long tick) {
+	__atomic_store_n(&rec->tick, tick, __ATOMIC_RELAXED);
+}
+
+/*
+ * Recorder attachment
+ */
+pse_error pse_rec_attach(pse_agent_stub *pse, pse_recorder *rec, unsigned int agent) {
+	if (pse->state == CREATED)
+		return PSE_ERROR_NOT_INITIALIZED;
+
+	if (pse->state == FINALIZED)
+		return PSE_ERROR_ALREADY_FINALIZED;
+
+	pse->recorder = rec;
+	pse->agent = agent;
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Append one entry to the ring of the calling thread. A full ring wakes the
+ * writer and waits for it.
+ */
+void pse_rec_append(pse_recorder *rec, unsigned int agent, pse_varid varid,
+						unsigned int location, double value) {
+	pse_rec_ring *ring = pse_rec_ring_of(rec);
+	pse_rec_entry *entry;
+	unsigned long long head;
+
+	if (ring == NULL) {
+		__atomic_add_fetch(&rec->dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	head = ring->head;
+
+	if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == PSE_REC_RING) {
+		ring->stalls++;
+		pthread_cond_signal(&rec->wake);
+
+		while (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == PSE_REC_RING)
+			sched_yield();
+	}
+
+	entry = &(ring->entries[head & (PSE_REC_RING - 1)]);
+	entry->tick = __atomic_load_n(&rec->tick, __ATOMIC_RELAXED);
+	entry->agent = agent;
+	entry->varid = varid;
+	entry->location = location;
+	entry->value = value;
+
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+	if (((head + 1) & (PSE_REC_RING/2 - 1)) == 0)
+		pthread_cond_signal(&rec->wake);
+}
@@ -0,0 +1,250 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+#include <ranlib_r8.h>
+#include <psesde.h>
+#include <psesimd.h>
+#include <pserec.h>
+#include "pseint.h"
+
+/*
+ * Declaration of private functions
+ */
+unsigned int pse_sde_steppable(pse_storage_type, pse_distribution_type);
+pse_error pse_sde_advance_conditioned(pse_agent_stub *, pse_varid, double *,
+						unsigned int);
+void pse_sde_advance_blocks(pse_agent_stub *, pse_varid, double *, unsigned int);
+
+/*
+ * Whether a variable or column is advanced by Euler-Maruyama steps
+ */
+unsigned int pse_sde_steppable(pse_storage_type storage, pse_distribution_type distribution) {
+	return ((storage == PSE_VAR_DOUBLE || storage == PSE_VAR_TIME) &&
+			distribution == PSE_DIST_FOKKER_PLANCK) ? PSE_TRUE : PSE_FALSE;
+}
+
+/*
+ * Supply a model and a clock to a variable of a stub
+ */
+pse_error pse_supply_sde(pse_agent_stub *pse, pse_varid varid, pse_sde_model model,
+						pse_varid clock) {
+	pse_variable *var;
+
+	if (pse->state == CREATED)
+		return PSE_ERROR_NOT_INITIALIZED;
+
+	if (pse->state == FINALIZED)
+		return PSE_ERROR_ALREADY_FINALIZED;
+
+	if (pse_is_registered(pse, varid) == PSE_FALSE)
+		return PSE_ERROR_VARIABLE_UNKNOWN;
+
+	var = pse->variables[varid];
+
+	if (pse_sde_steppable(var->storage, var->point_distribution) == PSE_FALSE)
+		return PSE_ERROR_TYPE_MISMATCH;
+
+	if (clock != PSE_SDE_NO_CLOCK) {
+		if (pse_is_registered(pse, clock) == PSE_FALSE)
+			return PSE_ERROR_VARIABLE_UNKNOWN;
+
+		if (pse->variables[clock]->storage != PSE_VAR_TIME ||
+			pse->variables[clock]->array != PSE_SCALAR)
+			return PSE_ERROR_TYPE_MISMATCH;
+	}
+
+	var->point_cache.sde.model = model;
+	var->point_cache.sde.clock = clock;
+	var->point_cache.sde.step = (clock == PSE_SDE_NO_CLOCK) ? NULL :
+									&(pse->variables[clock]->content.ctime);
+	var->sampler_pending = PSE_FALSE;
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Supply a model and a clock to a column of a population
+ */
+pse_error pse_pop_supply_sde(pse_population *pop, pse_varid colid, pse_sde_model model,
+						pse_varid clock) {
+	pse_column *col;
+	unsigned int i;
+
+	if (pop->state == CREATED)
+		return PSE_ERROR_NOT_INITIALIZED;
+
+	if (pop->state == FINALIZED)
+		return PSE_ERROR_ALREADY_FINALIZED;
+
+	if (colid < 0 || (unsigned int)colid >= pop->column_count)
+		return PSE_ERROR_VARIABLE_UNKNOWN;
+
+	col = &(pop->columns[colid]);
+
+	if (pse_sde_steppable(col->storage, col->point_distribution) == PSE_FALSE)
+		return PSE_ERROR_TYPE_MISMATCH;
+
+	if (clock != PSE_SDE_NO_CLOCK) {
+		if (clock < 0 || (unsigned int)clock >= pop->column_count)
+			return PSE_ERROR_VARIABLE_UNKNOWN;
+
+		if (pop->columns[clock].storage != PSE_VAR_TIME)
+			return PSE_ERROR_TYPE_MISMATCH;
+
+		/*
+		 * Steps advance clocked columns after all the others: a clock may
+		 * not itself be clocked, nor a clock be given a clock.
+		 */
+		if (clock != colid && pop->columns[clock].point_distribution == PSE_DIST_FOKKER_PLANCK &&
+				pop->columns[clock].point_cache.sde.step != NULL)
+			return PSE_ERROR_TYPE_MISMATCH;
+
+		for (i = 0; i < pop->column_count; i++) {
+			if ((pse_varid)i != colid &&
+					pop->columns[i].point_distribution == PSE_DIST_FOKKER_PLANCK &&
+					pop->columns[i].point_cache.sde.step != NULL &&
+					pop->columns[i].point_cache.sde.clock == colid)
+				return PSE_ERROR_TYPE_MISMATCH;
+		}
+	}
+
+	col->point_cache.sde.model = model;
+	col->point_cache.sde.clock = clock;
+	col->point_cache.sde.step = (clock == PSE_SDE_NO_CLOCK) ? NULL :
+									pop->columns[clock].values.ctime_a;
+	col->sampler_pending = PSE_FALSE;
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * With a prior, each location may have its own drift constant. Conditioning
+ * fails at the first location if at all (a pending prior or a deregistered
+ * conditional), so a failure leaves the variable unchanged.
+ */
+pse_error pse_sde_advance_conditioned(pse_agent_stub *pse, pse_varid varid, double *values,
+						unsigned int locations) {
+	pse_variable *var = pse->variables[varid];
+	pse_sampler_cache *cache;
+	pse_error error = PSE_ERROR_OK;
+	unsigned int location;
+	double *pars;
+
+	for (location = 0; location < locations; location++) {
+		pars = pse_condition(pse, varid, location, &cache, &error);
+
+		if (pars == NULL)
+			return error;
+
+		pse_rng_position(pse, varid);
+		values[location] = var->sample_double(values[location], pars, cache);
+	}
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Otherwise locations are stepped a block at a time
+ */
+void pse_sde_advance_blocks(pse_agent_stub *pse, pse_varid varid, double *values,
+						unsigned int locations) {
+	double z[PSE_SIMD_BLOCK];
+	pse_variable *var = pse->variables[varid];
+	unsigned int first;
+	unsigned int n;
+	unsigned int i;
+
+	for (first = 0; first < locations; first += n) {
+		n = locations - first;
+
+		if (n > PSE_SIMD_BLOCK)
+			n = PSE_SIMD_BLOCK;
+
+		for (i = 0; i < n; i++) {
+			pse_rng_position(pse, varid);
+			z[i] = (pse->sampler == PSE_SAMPLER_ZIGGURAT) ? snorm_zig_r8() : snorm_r8();
+		}
+
+		pse_sde_update(n, values + first, var->point_parameters, &var->point_cache,
+						NULL, z, values + first);
+	}
+}
+
+/*
+ * Advance a variable by one step
+ */
+void pse_sde_advance(pse_agent_stub *pse, pse_varid varid, pse_error *error) {
+	pse_variable *var;
+	rng_state *previous;
+	unsigned int locations;
+	unsigned int location;
+	double *values;
+
+	if (pse->state == CREATED || pse->state == INITIALIZED) {
+		*error = PSE_ERROR_NOT_INITIALIZED;
+		return;
+	}
+
+	if (pse->state == FINALIZED) {
+		*error = PSE_ERROR_ALREADY_FINALIZED;
+		return;
+	}
+
+	if (pse_is_registered(pse, varid) == PSE_FALSE) {
+		*error = PSE_ERROR_VARIABLE_UNKNOWN;
+		return;
+	}
+
+	var = pse->variables[varid];
+
+	if (pse_sde_steppable(var->storage, var->point_distribution) == PSE_FALSE) {
+		*error = PSE_ERROR_TYPE_MISMATCH;
+		return;
+	}
+
+	if (var->model != PSE_VAR_STOCHASTIC || var->read_and_alter == PSE_FALSE) {
+		*error = PSE_ERROR_VARIABLE_IS_IMMUTABLE;
+		return;
+	}
+
+	if (var->sampler_pending == PSE_TRUE) {
+		*error = PSE_ERROR_SAMPLER_MISSING;
+		return;
+	}
+
+	/*
+	 * Time shares the representation of double in the content union
+	 */
+	locations = (var->array == PSE_SCALAR) ? 1 : var->size;
+	values = (var->array == PSE_SCALAR) ? &(var->content.cdouble) : var->content.cdouble_a;
+
+	*error = PSE_ERROR_OK;
+	previous = rng_state_bind(&pse->rng);
+
+	/*
+	 * Variables with dependencies go through pse_condition(), which refuses
+	 * them while a restored prior is pending.
+	 */
+	if (var->has_dependencies == PSE_TRUE)
+		*error = pse_sde_advance_conditioned(pse, varid, values, locations);
+	else
+		pse_sde_advance_blocks(pse, varid, values, locations);
+
+	rng_state_bind(previous);
+
+	if (*error != PSE_ERROR_OK)
+		return;
+
+	if (pse->recorder != NULL) {
+		for (location = 0; location < locations; location++)
+			pse_rec_append(pse->recorder, pse->agent, varid, location, values[location]);
+	}
+
+	pse_touch(pse, varid);
+}
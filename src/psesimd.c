@@ -0,0 +1,1075 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+#include <rnglib.h>
+#include <math.h>
+#include <pthread.h>
+#include <psesimd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PSE_SIMD_X86 1
+#endif
+
+/*
+ * Notes:
+ * ------
+ * 1. The logarithm follows the Cephes rational approximation on
+ *    [sqrt(1/2), sqrt(2)) with the exponent split in two parts of ln(2).
+ * 2. Sine and cosine are evaluated on [-pi/4, pi/4] after reducing the angle
+ *    in units of quarter turns. Since the angle of Box-Muller is 2*pi*u, the
+ *    reduction is performed on 4*u, which is exact.
+ * 3. Normal variates are produced in pairs (Box-Muller): the cosine half and
+ *    the sine half are both returned.
+ */
+#define PSE_SIMD_SQRTH		0.70710678118654752440
+#define PSE_SIMD_LN2_HI		0.693359375
+#define PSE_SIMD_LN2_LO		-2.121944400546905827679e-4
+#define PSE_SIMD_PIO2		1.57079632679489661923
+#define PSE_SIMD_ROUND		6755399441055744.0
+#define PSE_SIMD_EXP_MAGIC	4503599627370496.0
+
+/*
+ * 4. Philox-4x32-10 (see philox4x32 in rnglib.c) runs one block per 64-bit
+ *    lane, whose low half holds a 32-bit word. Uniforms are taken from the
+ *    words as i4_uni and r8_uni_01 take them, so they are identical to those
+ *    of the scalar generator.
+ */
+#define PSE_PHILOX_M0		0xD2511F53
+#define PSE_PHILOX_M1		0xCD9E8D57
+#define PSE_PHILOX_W0		0x9E3779B9
+#define PSE_PHILOX_W1		0xBB67AE85
+#define PSE_UNI_M1			2147483563
+#define PSE_UNI_SCALE		4.656613057E-10
+
+static const double pse_log_p[6] = {
+	1.01875663804580931796E-4,
+	4.97494994976747001425E-1,
+	4.70579119878881725854E0,
+	1.44989225341610930846E1,
+	1.79368678507819816313E1,
+	7.70838733755885391666E0
+};
+
+static const double pse_log_q[5] = {
+	1.12873587189167450590E1,
+	4.52279145837532221105E1,
+	8.29875266912776603211E1,
+	7.11544750618563894466E1,
+	2.31251620126765340583E1
+};
+
+static const double pse_sin_c[6] = {
+	1.58962301576546568060E-10,
+	-2.50507477628578072866E-8,
+	2.75573136213857245213E-6,
+	-1.98412698295895385996E-4,
+	8.33333333332211858878E-3,
+	-1.66666666666666307295E-1
+};
+
+static const double pse_cos_c[6] = {
+	-1.13585365213876817300E-11,
+	2.08757008419747316778E-9,
+	-2.75573141792967388112E-7,
+	2.48015872888517045348E-5,
+	-1.38888888888730564116E-3,
+	4.16666666666665929218E-2
+};
+
+/*
+ * The level is detected once, whichever thread samples first (population
+ * steps sample from several workers at once)
+ */
+static pse_simd_level pse_simd_active = PSE_SIMD_NONE;
+static pthread_once_t pse_simd_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Portable scalar versions. They are used on non-x86 targets and for the
+ * elements left over after the last full vector.
+ */
+static double pse_log_scalar(double x) {
+	int e;
+	double m;
+	double z;
+	double p;
+	double q;
+	double y;
+
+	m = frexp(x, &e);
+
+	if (m < PSE_SIMD_SQRTH) {
+		e -= 1;
+		m = m + m - 1.0;
+	} else {
+		m = m - 1.0;
+	}
+
+	z = m*m;
+	p = ((((pse_log_p[0]*m + pse_log_p[1])*m + pse_log_p[2])*m + pse_log_p[3])*m
+			+ pse_log_p[4])*m + pse_log_p[5];
+	q = ((((m + pse_log_q[0])*m + pse_log_q[1])*m + pse_log_q[2])*m
+			+ pse_log_q[3])*m + pse_log_q[4];
+	y = m*(z*p/q);
+	y = y + e*PSE_SIMD_LN2_LO;
+	y = y - 0.5*z;
+
+	return m + y + e*PSE_SIMD_LN2_HI;
+}
+
+static void pse_sincos_scalar(double u, double *s, double *c) {
+	double t;
+	double k;
+	double x;
+	double z;
+	double ps;
+	double pc;
+	int q;
+
+	t = 4.0*u;
+	k = (t + PSE_SIMD_ROUND) - PSE_SIMD_ROUND;
+	q = ((int)k) & 3;
+	x = (t - k)*PSE_SIMD_PIO2;
+	z = x*x;
+
+	ps = x + x*z*(((((pse_sin_c[0]*z + pse_sin_c[1])*z + pse_sin_c[2])*z
+			+ pse_sin_c[3])*z + pse_sin_c[4])*z + pse_sin_c[5]);
+	pc = 1.0 - 0.5*z + z*z*(((((pse_cos_c[0]*z + pse_cos_c[1])*z + pse_cos_c[2])*z
+			+ pse_cos_c[3])*z + pse_cos_c[4])*z + pse_cos_c[5]);
+
+	switch(q) {
+	case 0:
+		*s = ps;
+		*c = pc;
+		break;
+	case 1:
+		*s = pc;
+		*c = -ps;
+		break;
+	case 2:
+		*s = -ps;
+		*c = -pc;
+		break;
+	default:
+		*s = -pc;
+		*c = ps;
+		break;
+	}
+}
+
+static void pse_affine_scalar(const double *u, double *out, unsigned int n,
+						double a, double b) {
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		out[i] = a + b*u[i];
+}
+
+static void pse_exponential_scalar(const double *u, double *out, unsigned int n) {
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		out[i] = -pse_log_scalar(u[i]);
+}
+
+static void pse_normal_scalar(const double *u1, const double *u2, double *c,
+						double *s, unsigned int n) {
+	unsigned int i;
+	double r;
+	double sv;
+	double cv;
+
+	for (i = 0; i < n; i++) {
+		r = sqrt(-2.0*pse_log_scalar(u1[i]));
+		pse_sincos_scalar(u2[i], &sv, &cv);
+		c[i] = r*cv;
+		s[i] = r*sv;
+	}
+}
+
+/*
+ * Block i has counter (c0[i], ctr[1], ctr[2], ctr[3]) and key (k0, k1[i]);
+ * its four words go to words[4*i] onwards
+ */
+static void pse_philox_scalar(const unsigned int *c0, const unsigned int *k1,
+						const unsigned int *ctr, unsigned int k0, unsigned int *words,
+						unsigned int n) {
+	unsigned int c[4];
+	unsigned int key[2];
+	unsigned int i;
+
+	c[1] = ctr[1];
+	c[2] = ctr[2];
+	c[3] = ctr[3];
+	key[0] = k0;
+
+	for (i = 0; i < n; i++) {
+		c[0] = c0[i];
+		key[1] = k1[i];
+		philox4x32(c, key, words + 4*i);
+	}
+}
+
+static inline double pse_philox_uniform(unsigned int word, int antithetic) {
+	int z = (int)(word >> 1);
+
+	if (z >= PSE_UNI_M1 - 1)
+		z -= PSE_UNI_M1 - 1;
+
+	z += 1;
+
+	return (antithetic ? PSE_UNI_M1 - z : z)*PSE_UNI_SCALE;
+}
+
+#ifdef PSE_SIMD_X86
+
+/*
+ * SSE2 kernels (two lanes)
+ */
+static inline __m128d pse_log_sse2(__m128d x) {
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d magic = _mm_set1_pd(PSE_SIMD_EXP_MAGIC);
+	__m128i bits = _mm_castpd_si128(x);
+	__m128i biased = _mm_srli_epi64(bits, 52);
+	__m128d e;
+	__m128d m;
+	__m128d small;
+	__m128d z;
+	__m128d p;
+	__m128d q;
+	__m128d y;
+
+	e = _mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(biased, _mm_castpd_si128(magic))), magic);
+	e = _mm_sub_pd(e, _mm_set1_pd(1022.0));
+	m = _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(bits,
+					_mm_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+					_mm_set1_epi64x(0x3FE0000000000000LL)));
+
+	small = _mm_cmplt_pd(m, _mm_set1_pd(PSE_SIMD_SQRTH));
+	e = _mm_sub_pd(e, _mm_and_pd(small, one));
+	m = _mm_sub_pd(_mm_add_pd(m, _mm_and_pd(small, m)), one);
+
+	z = _mm_mul_pd(m, m);
+	p = _mm_set1_pd(pse_log_p[0]);
+	p = _mm_add_pd(_mm_mul_pd(p, m), _mm_set1_pd(pse_log_p[1]));
+	p = _mm_add_pd(_mm_mul_pd(p, m), _mm_set1_pd(pse_log_p[2]));
+	p = _mm_add_pd(_mm_mul_pd(p, m), _mm_set1_pd(pse_log_p[3]));
+	p = _mm_add_pd(_mm_mul_pd(p, m), _mm_set1_pd(pse_log_p[4]));
+	p = _mm_add_pd(_mm_mul_pd(p, m), _mm_set1_pd(pse_log_p[5]));
+	q = _mm_add_pd(m, _mm_set1_pd(pse_log_q[0]));
+	q = _mm_add_pd(_mm_mul_pd(q, m), _mm_set1_pd(pse_log_q[1]));
+	q = _mm_add_pd(_mm_mul_pd(q, m), _mm_set1_pd(pse_log_q[2]));
+	q = _mm_add_pd(_mm_mul_pd(q, m), _mm_set1_pd(pse_log_q[3]));
+	q = _mm_add_pd(_mm_mul_pd(q, m), _mm_set1_pd(pse_log_q[4]));
+
+	y = _mm_mul_pd(m, _mm_div_pd(_mm_mul_pd(z, p), q));
+	y = _mm_add_pd(y, _mm_mul_pd(e, _mm_set1_pd(PSE_SIMD_LN2_LO)));
+	y = _mm_sub_pd(y, _mm_mul_pd(_mm_set1_pd(0.5), z));
+
+	return _mm_add_pd(_mm_add_pd(m, y), _mm_mul_pd(e, _mm_set1_pd(PSE_SIMD_LN2_HI)));
+}
+
+static inline void pse_sincos_sse2(__m128d u, __m128d *s, __m128d *c) {
+	const __m128d round = _mm_set1_pd(PSE_SIMD_ROUND);
+	__m128d t = _mm_mul_pd(u, _mm_set1_pd(4.0));
+	__m128d shifted = _mm_add_pd(t, round);
+	__m128i k = _mm_castpd_si128(shifted);
+	__m128d x = _mm_mul_pd(_mm_sub_pd(t, _mm_sub_pd(shifted, round)),
+					_mm_set1_pd(PSE_SIMD_PIO2));
+	__m128d z = _mm_mul_pd(x, x);
+	__m128d ps;
+	__m128d pc;
+	__m128d swap;
+	__m128i one_i = _mm_set1_epi64x(1);
+	__m128i two_i = _mm_set1_epi64x(2);
+
+	ps = _mm_set1_pd(pse_sin_c[0]);
+	ps = _mm_add_pd(_mm_mul_pd(ps, z), _mm_set1_pd(pse_sin_c[1]));
+	ps = _mm_add_pd(_mm_mul_pd(ps, z), _mm_set1_pd(pse_sin_c[2]));
+	ps = _mm_add_pd(_mm_mul_pd(ps, z), _mm_set1_pd(pse_sin_c[3]));
+	ps = _mm_add_pd(_mm_mul_pd(ps, z), _mm_set1_pd(pse_sin_c[4]));
+	ps = _mm_add_pd(_mm_mul_pd(ps, z), _mm_set1_pd(pse_sin_c[5]));
+	ps = _mm_add_pd(x, _mm_mul_pd(_mm_mul_pd(x, z), ps));
+
+	pc = _mm_set1_pd(pse_cos_c[0]);
+	pc = _mm_add_pd(_mm_mul_pd(pc, z), _mm_set1_pd(pse_cos_c[1]));
+	pc = _mm_add_pd(_mm_mul_pd(pc, z), _mm_set1_pd(pse_cos_c[2]));
+	pc = _mm_add_pd(_mm_mul_pd(pc, z), _mm_set1_pd(pse_cos_c[3]));
+	pc = _mm_add_pd(_mm_mul_pd(pc, z), _mm_set1_pd(pse_cos_c[4]));
+	pc = _mm_add_pd(_mm_mul_pd(pc, z), _mm_set1_pd(pse_cos_c[5]));
+	pc = _mm_add_pd(_mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(_mm_set1_pd(0.5), z)),
+					_mm_mul_pd(_mm_mul_pd(z, z), pc));
+
+	/*
+	 * Odd quadrants swap sine and cosine; quadrants 2 and 3 negate the sine,
+	 * quadrants 1 and 2 negate the cosine.
+	 */
+	swap = _mm_castsi128_pd(_mm_sub_epi64(_mm_setzero_si128(), _mm_and_si128(k, one_i)));
+	*s = _mm_or_pd(_mm_and_pd(swap, pc), _mm_andnot_pd(swap, ps));
+	*c = _mm_or_pd(_mm_and_pd(swap, ps), _mm_andnot_pd(swap, pc));
+	*s = _mm_xor_pd(*s, _mm_castsi128_pd(_mm_slli_epi64(_mm_and_si128(k, two_i), 62)));
+	*c = _mm_xor_pd(*c, _mm_castsi128_pd(_mm_slli_epi64(
+					_mm_and_si128(_mm_add_epi64(k, one_i), two_i), 62)));
+}
+
+static void pse_affine_sse2(const double *u, double *out, unsigned int n,
+						double a, double b) {
+	unsigned int i;
+	__m128d va = _mm_set1_pd(a);
+	__m128d vb = _mm_set1_pd(b);
+
+	for (i = 0; i + 2 <= n; i += 2)
+		_mm_storeu_pd(out + i, _mm_add_pd(va, _mm_mul_pd(vb, _mm_loadu_pd(u + i))));
+
+	pse_affine_scalar(u + i, out + i, n - i, a, b);
+}
+
+static void pse_exponential_sse2(const double *u, double *out, unsigned int n) {
+	unsigned int i;
+
+	for (i = 0; i + 2 <= n; i += 2)
+		_mm_storeu_pd(out + i, _mm_sub_pd(_mm_setzero_pd(),
+					pse_log_sse2(_mm_loadu_pd(u + i))));
+
+	pse_exponential_scalar(u + i, out + i, n - i);
+}
+
+static void pse_normal_sse2(const double *u1, const double *u2, double *c,
+						double *s, unsigned int n) {
+	unsigned int i;
+	__m128d r;
+	__m128d vs;
+	__m128d vc;
+
+	for (i = 0; i + 2 <= n; i += 2) {
+		r = _mm_sqrt_pd(_mm_mul_pd(_mm_set1_pd(-2.0), pse_log_sse2(_mm_loadu_pd(u1 + i))));
+		pse_sincos_sse2(_mm_loadu_pd(u2 + i), &vs, &vc);
+		_mm_storeu_pd(c + i, _mm_mul_pd(r, vc));
+		_mm_storeu_pd(s + i, _mm_mul_pd(r, vs));
+	}
+
+	pse_normal_scalar(u1 + i, u2 + i, c + i, s + i, n - i);
+}
+
+static void pse_philox_sse2(const unsigned int *c0, const unsigned int *k1,
+						const unsigned int *ctr, unsigned int k0, unsigned int *words,
+						unsigned int n) {
+	const __m128i mask = _mm_set1_epi64x(0xFFFFFFFFLL);
+	const __m128i m0 = _mm_set1_epi64x(PSE_PHILOX_M0);
+	const __m128i m1 = _mm_set1_epi64x(PSE_PHILOX_M1);
+	const __m128i w0 = _mm_set1_epi64x(PSE_PHILOX_W0);
+	const __m128i w1 = _mm_set1_epi64x(PSE_PHILOX_W1);
+	unsigned long long lane[4][2];
+	__m128i c[4];
+	__m128i kv0;
+	__m128i kv1;
+	__m128i p0;
+	__m128i p1;
+	__m128i next;
+	unsigned int i;
+	unsigned int l;
+	int r;
+
+	for (i = 0; i + 2 <= n; i += 2) {
+		c[0] = _mm_unpacklo_epi32(_mm_loadl_epi64((const __m128i *)(c0 + i)),
+								_mm_setzero_si128());
+		c[1] = _mm_set1_epi64x(ctr[1]);
+		c[2] = _mm_set1_epi64x(ctr[2]);
+		c[3] = _mm_set1_epi64x(ctr[3]);
+		kv0 = _mm_set1_epi64x(k0);
+		kv1 = _mm_unpacklo_epi32(_mm_loadl_epi64((const __m128i *)(k1 + i)),
+								_mm_setzero_si128());
+
+		for (r = 0; r < 10; r++) {
+			p0 = _mm_mul_epu32(m0, c[0]);
+			p1 = _mm_mul_epu32(m1, c[2]);
+			next = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi64(p1, 32), c[1]), kv0);
+			c[1] = _mm_and_si128(p1, mask);
+			c[2] = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi64(p0, 32), c[3]), kv1);
+			c[3] = _mm_and_si128(p0, mask);
+			c[0] = next;
+			kv0 = _mm_and_si128(_mm_add_epi64(kv0, w0), mask);
+			kv1 = _mm_and_si128(_mm_add_epi64(kv1, w1), mask);
+		}
+
+		for (r = 0; r < 4; r++)
+			_mm_storeu_si128((__m128i *) lane[r], c[r]);
+
+		for (l = 0; l < 2; l++)
+			for (r = 0; r < 4; r++)
+				words[4*(i + l) + r] = (unsigned int) lane[r][l];
+	}
+
+	pse_philox_scalar(c0 + i, k1 + i, ctr, k0, words + 4*i, n - i);
+}
+
+/*
+ * AVX2 kernels (four lanes, fused multiply-add)
+ */
+__attribute__((target("avx2,fma")))
+static inline __m256d pse_log_avx2(__m256d x) {
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d magic = _mm256_set1_pd(PSE_SIMD_EXP_MAGIC);
+	__m256i bits = _mm256_castpd_si256(x);
+	__m256i biased = _mm256_srli_epi64(bits, 52);
+	__m256d e;
+	__m256d m;
+	__m256d small;
+	__m256d z;
+	__m256d p;
+	__m256d q;
+	__m256d y;
+
+	e = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(biased,
+					_mm256_castpd_si256(magic))), magic);
+	e = _mm256_sub_pd(e, _mm256_set1_pd(1022.0));
+	m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits,
+					_mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+					_mm256_set1_epi64x(0x3FE0000000000000LL)));
+
+	small = _mm256_cmp_pd(m, _mm256_set1_pd(PSE_SIMD_SQRTH), _CMP_LT_OQ);
+	e = _mm256_sub_pd(e, _mm256_and_pd(small, one));
+	m = _mm256_sub_pd(_mm256_add_pd(m, _mm256_and_pd(small, m)), one);
+
+	z = _mm256_mul_pd(m, m);
+	p = _mm256_set1_pd(pse_log_p[0]);
+	p = _mm256_fmadd_pd(p, m, _mm256_set1_pd(pse_log_p[1]));
+	p = _mm256_fmadd_pd(p, m, _mm256_set1_pd(pse_log_p[2]));
+	p = _mm256_fmadd_pd(p, m, _mm256_set1_pd(pse_log_p[3]));
+	p = _mm256_fmadd_pd(p, m, _mm256_set1_pd(pse_log_p[4]));
+	p = _mm256_fmadd_pd(p, m, _mm256_set1_pd(pse_log_p[5]));
+	q = _mm256_add_pd(m, _mm256_set1_pd(pse_log_q[0]));
+	q = _mm256_fmadd_pd(q, m, _mm256_set1_pd(pse_log_q[1]));
+	q = _mm256_fmadd_pd(q, m, _mm256_set1_pd(pse_log_q[2]));
+	q = _mm256_fmadd_pd(q, m, _mm256_set1_pd(pse_log_q[3]));
+	q = _mm256_fmadd_pd(q, m, _mm256_set1_pd(pse_log_q[4]));
+
+	y = _mm256_mul_pd(m, _mm256_div_pd(_mm256_mul_pd(z, p), q));
+	y = _mm256_fmadd_pd(e, _mm256_set1_pd(PSE_SIMD_LN2_LO), y);
+	y = _mm256_fnmadd_pd(_mm256_set1_pd(0.5), z, y);
+
+	return _mm256_fmadd_pd(e, _mm256_set1_pd(PSE_SIMD_LN2_HI), _mm256_add_pd(m, y));
+}
+
+__attribute__((target("avx2,fma")))
+static inline void pse_sincos_avx2(__m256d u, __m256d *s, __m256d *c) {
+	const __m256d round = _mm256_set1_pd(PSE_SIMD_ROUND);
+	__m256d t = _mm256_mul_pd(u, _mm256_set1_pd(4.0));
+	__m256d shifted = _mm256_add_pd(t, round);
+	__m256i k = _mm256_castpd_si256(shifted);
+	__m256d x = _mm256_mul_pd(_mm256_sub_pd(t, _mm256_sub_pd(shifted, round)),
+					_mm256_set1_pd(PSE_SIMD_PIO2));
+	__m256d z = _mm256_mul_pd(x, x);
+	__m256d ps;
+	__m256d pc;
+	__m256d swap;
+	__m256i one_i = _mm256_set1_epi64x(1);
+	__m256i two_i = _mm256_set1_epi64x(2);
+
+	ps = _mm256_set1_pd(pse_sin_c[0]);
+	ps = _mm256_fmadd_pd(ps, z, _mm256_set1_pd(pse_sin_c[1]));
+	ps = _mm256_fmadd_pd(ps, z, _mm256_set1_pd(pse_sin_c[2]));
+	ps = _mm256_fmadd_pd(ps, z, _mm256_set1_pd(pse_sin_c[3]));
+	ps = _mm256_fmadd_pd(ps, z, _mm256_set1_pd(pse_sin_c[4]));
+	ps = _mm256_fmadd_pd(ps, z, _mm256_set1_pd(pse_sin_c[5]));
+	ps = _mm256_fmadd_pd(_mm256_mul_pd(x, z), ps, x);
+
+	pc = _mm256_set1_pd(pse_cos_c[0]);
+	pc = _mm256_fmadd_pd(pc, z, _mm256_set1_pd(pse_cos_c[1]));
+	pc = _mm256_fmadd_pd(pc, z, _mm256_set1_pd(pse_cos_c[2]));
+	pc = _mm256_fmadd_pd(pc, z, _mm256_set1_pd(pse_cos_c[3]));
+	pc = _mm256_fmadd_pd(pc, z, _mm256_set1_pd(pse_cos_c[4]));
+	pc = _mm256_fmadd_pd(pc, z, _mm256_set1_pd(pse_cos_c[5]));
+	pc = _mm256_fmadd_pd(_mm256_mul_pd(z, z), pc,
+					_mm256_fnmadd_pd(_mm256_set1_pd(0.5), z, _mm256_set1_pd(1.0)));
+
+	swap = _mm256_castsi256_pd(_mm256_sub_epi64(_mm256_setzero_si256(),
+					_mm256_and_si256(k, one_i)));
+	*s = _mm256_blendv_pd(ps, pc, swap);
+	*c = _mm256_blendv_pd(pc, ps, swap);
+	*s = _mm256_xor_pd(*s, _mm256_castsi256_pd(_mm256_slli_epi64(
+					_mm256_and_si256(k, two_i), 62)));
+	*c = _mm256_xor_pd(*c, _mm256_castsi256_pd(_mm256_slli_epi64(
+					_mm256_and_si256(_mm256_add_epi64(k, one_i), two_i), 62)));
+}
+
+__attribute__((target("avx2,fma")))
+static void pse_affine_avx2(const double *u, double *out, unsigned int n,
+						double a, double b) {
+	unsigned int i;
+	__m256d va = _mm256_set1_pd(a);
+	__m256d vb = _mm256_set1_pd(b);
+
+	for (i = 0; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(out + i, _mm256_fmadd_pd(vb, _mm256_loadu_pd(u + i), va));
+
+	pse_affine_scalar(u + i, out + i, n - i, a, b);
+}
+
+__attribute__((target("avx2,fma")))
+static void pse_exponential_avx2(const double *u, double *out, unsigned int n) {
+	unsigned int i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(out + i, _mm256_sub_pd(_mm256_setzero_pd(),
+					pse_log_avx2(_mm256_loadu_pd(u + i))));
+
+	pse_exponential_scalar(u + i, out + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+static void pse_normal_avx2(const double *u1, const double *u2, double *c,
+						double *s, unsigned int n) {
+	unsigned int i;
+	__m256d r;
+	__m256d vs;
+	__m256d vc;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		r = _mm256_sqrt_pd(_mm256_mul_pd(_mm256_set1_pd(-2.0),
+					pse_log_avx2(_mm256_loadu_pd(u1 + i))));
+		pse_sincos_avx2(_mm256_loadu_pd(u2 + i), &vs, &vc);
+		_mm256_storeu_pd(c + i, _mm256_mul_pd(r, vc));
+		_mm256_storeu_pd(s + i, _mm256_mul_pd(r, vs));
+	}
+
+	pse_normal_scalar(u1 + i, u2 + i, c + i, s + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+static void pse_philox_avx2(const unsigned int *c0, const unsigned int *k1,
+						const unsigned int *ctr, unsigned int k0, unsigned int *words,
+						unsigned int n) {
+	const __m256i mask = _mm256_set1_epi64x(0xFFFFFFFFLL);
+	const __m256i m0 = _mm256_set1_epi64x(PSE_PHILOX_M0);
+	const __m256i m1 = _mm256_set1_epi64x(PSE_PHILOX_M1);
+	const __m256i w0 = _mm256_set1_epi64x(PSE_PHILOX_W0);
+	const __m256i w1 = _mm256_set1_epi64x(PSE_PHILOX_W1);
+	unsigned long long lane[4][4];
+	__m256i c[4];
+	__m256i kv0;
+	__m256i kv1;
+	__m256i p0;
+	__m256i p1;
+	__m256i next;
+	unsigned int i;
+	unsigned int l;
+	int r;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		c[0] = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)(c0 + i)));
+		c[1] = _mm256_set1_epi64x(ctr[1]);
+		c[2] = _mm256_set1_epi64x(ctr[2]);
+		c[3] = _mm256_set1_epi64x(ctr[3]);
+		kv0 = _mm256_set1_epi64x(k0);
+		kv1 = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)(k1 + i)));
+
+		for (r = 0; r < 10; r++) {
+			p0 = _mm256_mul_epu32(m0, c[0]);
+			p1 = _mm256_mul_epu32(m1, c[2]);
+			next = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p1, 32), c[1]), kv0);
+			c[1] = _mm256_and_si256(p1, mask);
+			c[2] = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p0, 32), c[3]), kv1);
+			c[3] = _mm256_and_si256(p0, mask);
+			c[0] = next;
+			kv0 = _mm256_and_si256(_mm256_add_epi64(kv0, w0), mask);
+			kv1 = _mm256_and_si256(_mm256_add_epi64(kv1, w1), mask);
+		}
+
+		for (r = 0; r < 4; r++)
+			_mm256_storeu_si256((__m256i *) lane[r], c[r]);
+
+		for (l = 0; l < 4; l++)
+			for (r = 0; r < 4; r++)
+				words[4*(i + l) + r] = (unsigned int) lane[r][l];
+	}
+
+	pse_philox_scalar(c0 + i, k1 + i, ctr, k0, words + 4*i, n - i);
+}
+
+/*
+ * AVX-512 kernels (eight lanes, mask registers)
+ */
+__attribute__((target("avx512f")))
+static inline __m512d pse_log_avx512(__m512d x) {
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m512d magic = _mm512_set1_pd(PSE_SIMD_EXP_MAGIC);
+	__m512i bits = _mm512_castpd_si512(x);
+	__m512i biased = _mm512_srli_epi64(bits, 52);
+	__m512d e;
+	__m512d m;
+	__mmask8 small;
+	__m512d z;
+	__m512d p;
+	__m512d q;
+	__m512d y;
+
+	e = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(biased,
+					_mm512_castpd_si512(magic))), magic);
+	e = _mm512_sub_pd(e, _mm512_set1_pd(1022.0));
+	m = _mm512_castsi512_pd(_mm512_or_si512(_mm512_and_si512(bits,
+					_mm512_set1_epi64(0x000FFFFFFFFFFFFFLL)),
+					_mm512_set1_epi64(0x3FE0000000000000LL)));
+
+	small = _mm512_cmp_pd_mask(m, _mm512_set1_pd(PSE_SIMD_SQRTH), _CMP_LT_OQ);
+	e = _mm512_mask_sub_pd(e, small, e, one);
+	m = _mm512_sub_pd(_mm512_mask_add_pd(m, small, m, m), one);
+
+	z = _mm512_mul_pd(m, m);
+	p = _mm512_set1_pd(pse_log_p[0]);
+	p = _mm512_fmadd_pd(p, m, _mm512_set1_pd(pse_log_p[1]));
+	p = _mm512_fmadd_pd(p, m, _mm512_set1_pd(pse_log_p[2]));
+	p = _mm512_fmadd_pd(p, m, _mm512_set1_pd(pse_log_p[3]));
+	p = _mm512_fmadd_pd(p, m, _mm512_set1_pd(pse_log_p[4]));
+	p = _mm512_fmadd_pd(p, m, _mm512_set1_pd(pse_log_p[5]));
+	q = _mm512_add_pd(m, _mm512_set1_pd(pse_log_q[0]));
+	q = _mm512_fmadd_pd(q, m, _mm512_set1_pd(pse_log_q[1]));
+	q = _mm512_fmadd_pd(q, m, _mm512_set1_pd(pse_log_q[2]));
+	q = _mm512_fmadd_pd(q, m, _mm512_set1_pd(pse_log_q[3]));
+	q = _mm512_fmadd_pd(q, m, _mm512_set1_pd(pse_log_q[4]));
+
+	y = _mm512_mul_pd(m, _mm512_div_pd(_mm512_mul_pd(z, p), q));
+	y = _mm512_fmadd_pd(e, _mm512_set1_pd(PSE_SIMD_LN2_LO), y);
+	y = _mm512_fnmadd_pd(_mm512_set1_pd(0.5), z, y);
+
+	return _mm512_fmadd_pd(e, _mm512_set1_pd(PSE_SIMD_LN2_HI), _mm512_add_pd(m, y));
+}
+
+__attribute__((target("avx512f")))
+static inline void pse_sincos_avx512(__m512d u, __m512d *s, __m512d *c) {
+	const __m512d round = _mm512_set1_pd(PSE_SIMD_ROUND);
+	__m512d t = _mm512_mul_pd(u, _mm512_set1_pd(4.0));
+	__m512d shifted = _mm512_add_pd(t, round);
+	__m512i k = _mm512_castpd_si512(shifted);
+	__m512d x = _mm512_mul_pd(_mm512_sub_pd(t, _mm512_sub_pd(shifted, round)),
+					_mm512_set1_pd(PSE_SIMD_PIO2));
+	__m512d z = _mm512_mul_pd(x, x);
+	__m512d ps;
+	__m512d pc;
+	__mmask8 swap;
+	__m512i one_i = _mm512_set1_epi64(1);
+	__m512i two_i = _mm512_set1_epi64(2);
+
+	ps = _mm512_set1_pd(pse_sin_c[0]);
+	ps = _mm512_fmadd_pd(ps, z, _mm512_set1_pd(pse_sin_c[1]));
+	ps = _mm512_fmadd_pd(ps, z, _mm512_set1_pd(pse_sin_c[2]));
+	ps = _mm512_fmadd_pd(ps, z, _mm512_set1_pd(pse_sin_c[3]));
+	ps = _mm512_fmadd_pd(ps, z, _mm512_set1_pd(pse_sin_c[4]));
+	ps = _mm512_fmadd_pd(ps, z, _mm512_set1_pd(pse_sin_c[5]));
+	ps = _mm512_fmadd_pd(_mm512_mul_pd(x, z), ps, x);
+
+	pc = _mm512_set1_pd(pse_cos_c[0]);
+	pc = _mm512_fmadd_pd(pc, z, _mm512_set1_pd(pse_cos_c[1]));
+	pc = _mm512_fmadd_pd(pc, z, _mm512_set1_pd(pse_cos_c[2]));
+	pc = _mm512_fmadd_pd(pc, z, _mm512_set1_pd(pse_cos_c[3]));
+	pc = _mm512_fmadd_pd(pc, z, _mm512_set1_pd(pse_cos_c[4]));
+	pc = _mm512_fmadd_pd(pc, z, _mm512_set1_pd(pse_cos_c[5]));
+	pc = _mm512_fmadd_pd(_mm512_mul_pd(z, z), pc,
+					_mm512_fnmadd_pd(_mm512_set1_pd(0.5), z, _mm512_set1_pd(1.0)));
+
+	swap = _mm512_test_epi64_mask(k, one_i);
+	*s = _mm512_mask_blend_pd(swap, ps, pc);
+	*c = _mm512_mask_blend_pd(swap, pc, ps);
+	*s = _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(*s),
+					_mm512_slli_epi64(_mm512_and_si512(k, two_i), 62)));
+	*c = _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(*c),
+					_mm512_slli_epi64(_mm512_and_si512(_mm512_add_epi64(k, one_i),
+					two_i), 62)));
+}
+
+__attribute__((target("avx512f")))
+static void pse_affine_avx512(const double *u, double *out, unsigned int n,
+						double a, double b) {
+	unsigned int i;
+	__m512d va = _mm512_set1_pd(a);
+	__m512d vb = _mm512_set1_pd(b);
+
+	for (i = 0; i + 8 <= n; i += 8)
+		_mm512_storeu_pd(out + i, _mm512_fmadd_pd(vb, _mm512_loadu_pd(u + i), va));
+
+	pse_affine_scalar(u + i, out + i, n - i, a, b);
+}
+
+__attribute__((target("avx512f")))
+static void pse_exponential_avx512(const double *u, double *out, unsigned int n) {
+	unsigned int i;
+
+	for (i = 0; i + 8 <= n; i += 8)
+		_mm512_storeu_pd(out + i, _mm512_sub_pd(_mm512_setzero_pd(),
+					pse_log_avx512(_mm512_loadu_pd(u + i))));
+
+	pse_exponential_scalar(u + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void pse_normal_avx512(const double *u1, const double *u2, double *c,
+						double *s, unsigned int n) {
+	unsigned int i;
+	__m512d r;
+	__m512d vs;
+	__m512d vc;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		r = _mm512_sqrt_pd(_mm512_mul_pd(_mm512_set1_pd(-2.0),
+					pse_log_avx512(_mm512_loadu_pd(u1 + i))));
+		pse_sincos_avx512(_mm512_loadu_pd(u2 + i), &vs, &vc);
+		_mm512_storeu_pd(c + i, _mm512_mul_pd(r, vc));
+		_mm512_storeu_pd(s + i, _mm512_mul_pd(r, vs));
+	}
+
+	pse_normal_scalar(u1 + i, u2 + i, c + i, s + i, n - i);
+}
+
+
+__attribute__((target("avx512f")))
+static void pse_philox_avx512(const unsigned int *c0, const unsigned int *k1,
+						const unsigned int *ctr, unsigned int k0, unsigned int *words,
+						unsigned int n) {
+	const __m512i mask = _mm512_set1_epi64(0xFFFFFFFFLL);
+	const __m512i m0 = _mm512_set1_epi64(PSE_PHILOX_M0);
+	const __m512i m1 = _mm512_set1_epi64(PSE_PHILOX_M1);
+	const __m512i w0 = _mm512_set1_epi64(PSE_PHILOX_W0);
+	const __m512i w1 = _mm512_set1_epi64(PSE_PHILOX_W1);
+	unsigned long long lane[4][8];
+	__m512i c[4];
+	__m512i kv0;
+	__m512i kv1;
+	__m512i p0;
+	__m512i p1;
+	__m512i next;
+	unsigned int i;
+	unsigned int l;
+	int r;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		c[0] = _mm512_cvtepu32_epi64(_mm256_loadu_si256((const __m256i *)(c0 + i)));
+		c[1] = _mm512_set1_epi64(ctr[1]);
+		c[2] = _mm512_set1_epi64(ctr[2]);
+		c[3] = _mm512_set1_epi64(ctr[3]);
+		kv0 = _mm512_set1_epi64(k0);
+		kv1 = _mm512_cvtepu32_epi64(_mm256_loadu_si256((const __m256i *)(k1 + i)));
+
+		for (r = 0; r < 10; r++) {
+			p0 = _mm512_mul_epu32(m0, c[0]);
+			p1 = _mm512_mul_epu32(m1, c[2]);
+			next = _mm512_xor_si512(_mm512_xor_si512(_mm512_srli_epi64(p1, 32), c[1]), kv0);
+			c[1] = _mm512_and_si512(p1, mask);
+			c[2] = _mm512_xor_si512(_mm512_xor_si512(_mm512_srli_epi64(p0, 32), c[3]), kv1);
+			c[3] = _mm512_and_si512(p0, mask);
+			c[0] = next;
+			kv0 = _mm512_and_si512(_mm512_add_epi64(kv0, w0), mask);
+			kv1 = _mm512_and_si512(_mm512_add_epi64(kv1, w1), mask);
+		}
+
+		for (r = 0; r < 4; r++)
+			_mm512_storeu_si512((void *) lane[r], c[r]);
+
+		for (l = 0; l < 8; l++)
+			for (r = 0; r < 4; r++)
+				words[4*(i + l) + r] = (unsigned int) lane[r][l];
+	}
+
+	pse_philox_scalar(c0 + i, k1 + i, ctr, k0, words + 4*i, n - i);
+}
+
+#endif
+
+/*
+ * Detect the widest instruction set supported by the processor.
+ */
+pse_simd_level pse_simd_detect(void) {
+#ifdef PSE_SIMD_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f"))
+		return PSE_SIMD_AVX512;
+
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return PSE_SIMD_AVX2;
+
+	if (__builtin_cpu_supports("sse2"))
+		return PSE_SIMD_SSE2;
+#endif
+
+	return PSE_SIMD_NONE;
+}
+
+/*
+ * Select the kernels to be used. Requests above what the processor supports
+ * are lowered to the detected level. Returns the level in effect. Selection
+ * is not synchronized with sampling: select before observing or stepping.
+ */
+static void pse_simd_init(void) {
+	pse_simd_active = pse_simd_detect();
+}
+
+pse_simd_level pse_simd_select(pse_simd_level level) {
+	pse_simd_level detected;
+
+	pthread_once(&pse_simd_once, pse_simd_init);
+	detected = pse_simd_detect();
+	pse_simd_active = (level > detected) ? detected : level;
+
+	return pse_simd_active;
+}
+
+static pse_simd_level pse_simd_current(void) {
+	pthread_once(&pse_simd_once, pse_simd_init);
+
+	return pse_simd_active;
+}
+
+/*
+ * out[i] = a + b*u[i]
+ */
+void pse_simd_affine(const double *u, double *out, unsigned int n, double a, double b) {
+	switch(pse_simd_current()) {
+#ifdef PSE_SIMD_X86
+	case PSE_SIMD_AVX512:
+		pse_affine_avx512(u, out, n, a, b);
+		break;
+	case PSE_SIMD_AVX2:
+		pse_affine_avx2(u, out, n, a, b);
+		break;
+	case PSE_SIMD_SSE2:
+		pse_affine_sse2(u, out, n, a, b);
+		break;
+#endif
+	default:
+		pse_affine_scalar(u, out, n, a, b);
+		break;
+	}
+}
+
+/*
+ * out[i] = -log(u[i]), a standard exponential variate.
+ */
+void pse_simd_exponential_transform(const double *u, double *out, unsigned int n) {
+	switch(pse_simd_current()) {
+#ifdef PSE_SIMD_X86
+	case PSE_SIMD_AVX512:
+		pse_exponential_avx512(u, out, n);
+		break;
+	case PSE_SIMD_AVX2:
+		pse_exponential_avx2(u, out, n);
+		break;
+	case PSE_SIMD_SSE2:
+		pse_exponential_sse2(u, out, n);
+		break;
+#endif
+	default:
+		pse_exponential_scalar(u, out, n);
+		break;
+	}
+}
+
+/*
+ * Box-Muller: two independent standard normal variates per pair (u1, u2),
+ * the cosine one into c and the sine one into s.
+ */
+void pse_simd_normal_transform(const double *u1, const double *u2, double *c,
+						double *s, unsigned int n) {
+	switch(pse_simd_current()) {
+#ifdef PSE_SIMD_X86
+	case PSE_SIMD_AVX512:
+		pse_normal_avx512(u1, u2, c, s, n);
+		break;
+	case PSE_SIMD_AVX2:
+		pse_normal_avx2(u1, u2, c, s, n);
+		break;
+	case PSE_SIMD_SSE2:
+		pse_normal_sse2(u1, u2, c, s, n);
+		break;
+#endif
+	default:
+		pse_normal_scalar(u1, u2, c, s, n);
+		break;
+	}
+}
+
+/*
+ * Philox blocks, one per lane (see pse_philox_scalar)
+ */
+static void pse_philox_lanes(const unsigned int *c0, const unsigned int *k1,
+						const unsigned int *ctr, unsigned int k0, unsigned int *words,
+						unsigned int n) {
+	switch(pse_simd_current()) {
+#ifdef PSE_SIMD_X86
+	case PSE_SIMD_AVX512:
+		pse_philox_avx512(c0, k1, ctr, k0, words, n);
+		break;
+	case PSE_SIMD_AVX2:
+		pse_philox_avx2(c0, k1, ctr, k0, words, n);
+		break;
+	case PSE_SIMD_SSE2:
+		pse_philox_sse2(c0, k1, ctr, k0, words, n);
+		break;
+#endif
+	default:
+		pse_philox_scalar(c0, k1, ctr, k0, words, n);
+		break;
+	}
+}
+
+/*
+ * Draw n uniform variates, the same as n calls to r8_uni_01. With the
+ * counter-based generator the whole blocks of the stream are computed in
+ * vector lanes; the L'Ecuyer generators are a sequential recurrence and are
+ * drawn one at a time.
+ */
+void pse_simd_uniform_01(double *u, unsigned int n) {
+	unsigned int words[4*PSE_SIMD_BLOCK];
+	unsigned int c0[PSE_SIMD_BLOCK];
+	unsigned int k1[PSE_SIMD_BLOCK];
+	rng_state *state = rng_state_get();
+	unsigned int blocks;
+	unsigned int i = 0;
+	unsigned int j;
+	int antithetic;
+
+	if (state->backend != RNG_BACKEND_PHILOX || !initialized_get()) {
+		for (i = 0; i < n; i++)
+			u[i] = r8_uni_01();
+
+		return;
+	}
+
+	/*
+	 * The rest of the block in use, then whole blocks, then the start of the
+	 * last one
+	 */
+	while (i < n && state->draw % 4 != 0)
+		u[i++] = r8_uni_01();
+
+	antithetic = state->a[state->g];
+
+	while (n - i >= 4) {
+		blocks = (n - i)/4;
+
+		if (blocks > PSE_SIMD_BLOCK)
+			blocks = PSE_SIMD_BLOCK;
+
+		for (j = 0; j < blocks; j++) {
+			c0[j] = state->draw/4 + j;
+			k1[j] = state->key[1];
+		}
+
+		pse_philox_lanes(c0, k1, state->ctr, state->key[0], words, blocks);
+
+		for (j = 0; j < 4*blocks; j++)
+			u[i + j] = pse_philox_uniform(words[j], antithetic);
+
+		state->draw += 4*blocks;
+		i += 4*blocks;
+	}
+
+	while (i < n)
+		u[i++] = r8_uni_01();
+}
+
+/*
+ * The first two uniforms of n streams of the counter-based generator: stream
+ * i has key (k0, first + i) and counter (0, c1, c2, c3), as positioned by
+ * rng_philox_set_key and rng_philox_set_counter. Used for agents of
+ * populations.
+ */
+void pse_simd_uniform_pairs(unsigned int k0, unsigned int first, unsigned int c1,
+						unsigned int c2, unsigned int c3, double *u1, double *u2,
+						unsigned int n) {
+	unsigned int words[4*PSE_SIMD_BLOCK];
+	unsigned int c0[PSE_SIMD_BLOCK];
+	unsigned int k1[PSE_SIMD_BLOCK];
+	unsigned int ctr[4];
+	rng_state *state = rng_state_get();
+	unsigned int done;
+	unsigned int m;
+	unsigned int j;
+
+	ctr[0] = 0;
+	ctr[1] = c1;
+	ctr[2] = c2;
+	ctr[3] = c3;
+
+	for (done = 0; done < n; done += m) {
+		m = (n - done > PSE_SIMD_BLOCK) ? PSE_SIMD_BLOCK : n - done;
+
+		for (j = 0; j < m; j++) {
+			c0[j] = 0;
+			k1[j] = first + done + j;
+		}
+
+		pse_philox_lanes(c0, k1, ctr, k0, words, m);
+
+		for (j = 0; j < m; j++) {
+			u1[done + j] = pse_philox_uniform(words[4*j], state->a[state->g]);
+			u2[done + j] = pse_philox_uniform(words[4*j + 1], state->a[state->g]);
+		}
+	}
+}
+
+/*
+ * Draw n uniform variates in [low, high).
+ */
+void pse_simd_uniform(double *out, unsigned int n, double low, double high) {
+	pse_simd_uniform_01(out, n);
+	pse_simd_affine(out, out, n, low, high - low);
+}
+
+/*
+ * Draw n normal variates with mean mu and standard deviation sigma. Uniforms
+ * are consumed in blocks; each block of 2m uniforms yields 2m variates.
+ */
+void pse_simd_normal(double *out, unsigned int n, double mu, double sigma) {
+	double u[2*PSE_SIMD_BLOCK];
+	double u1[PSE_SIMD_BLOCK];
+	double u2[PSE_SIMD_BLOCK];
+	double spare[PSE_SIMD_BLOCK];
+	unsigned int done;
+	unsigned int pairs;
+	unsigned int i;
+
+	for (done = 0; done < n; done += 2*pairs) {
+		pairs = (n - done + 1)/2;
+
+		if (pairs > PSE_SIMD_BLOCK)
+			pairs = PSE_SIMD_BLOCK;
+
+		pse_simd_uniform_01(u, 2*pairs);
+
+		for (i = 0; i < pairs; i++) {
+			u1[i] = u[2*i];
+			u2[i] = u[2*i + 1];
+		}
+
+		if (done + 2*pairs <= n) {
+			pse_simd_normal_transform(u1, u2, out + done, out + done + pairs, pairs);
+			pse_simd_affine(out + done, out + done, 2*pairs, mu, sigma);
+		} else {
+			/*
+			 * Odd tail: the last sine variate is discarded.
+			 */
+			pse_simd_normal_transform(u1, u2, out + done, spare, pairs);
+
+			for (i = 0; i + 1 < pairs; i++)
+				out[done + pairs + i] = spare[i];
+
+			pse_simd_affine(out + done, out + done, n - done, mu, sigma);
+			break;
+		}
+	}
+}
+
+/*
+ * Draw n exponential variates with mean mu.
+ */
+void pse_simd_exponential(double *out, unsigned int n, double mu) {
+	pse_simd_uniform_01(out, n);
+	pse_simd_exponential_transform(out, out, n);
+	pse_simd_affine(out, out, n, 0.0, mu);
+}
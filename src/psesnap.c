@@ -0,0 +1,380 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <psesnap.h>
+#include <psesde.h>
+#include "pseint.h"
+
+/*
+ * Declaration of private functions
+ */
+unsigned long long pse_snap_align(unsigned long long);
+size_t pse_snap_element_size(pse_storage_type);
+unsigned int pse_snap_pad(FILE *, unsigned long long *, unsigned long long);
+pse_error pse_snap_write(pse_population *, FILE *);
+unsigned int pse_snap_valid_column(pse_snap_header *, pse_snap_column *,
+									pse_snap_column *, unsigned long long);
+
+unsigned long long pse_snap_align(unsigned long long offset) {
+	return (offset + PSE_SNAP_ALIGN - 1)/PSE_SNAP_ALIGN*PSE_SNAP_ALIGN;
+}
+
+/*
+ * Size of one value of a column, or 0 if columns cannot hold the storage
+ */
+size_t pse_snap_element_size(pse_storage_type storage) {
+	switch(storage) {
+	case PSE_VAR_INT:
+		return sizeof(int);
+	case PSE_VAR_DOUBLE:
+		return sizeof(double);
+	case PSE_VAR_TIME:
+		return sizeof(pse_time);
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Write zeros from position up to offset
+ */
+unsigned int pse_snap_pad(FILE *fp, unsigned long long *position,
+							unsigned long long offset) {
+	static const char zeros[PSE_SNAP_ALIGN];
+	size_t count = (size_t)(offset - *position);
+
+	if (fwrite(zeros, 1, count, fp) != count)
+		return PSE_FALSE;
+
+	*position = offset;
+
+	return PSE_TRUE;
+}
+
+/*
+ * Lay out and write a snapshot. The offsets of every section are computed
+ * first, so the header and the column records are written complete and
+ * values follow in a single sequential pass.
+ */
+pse_error pse_snap_write(pse_population *pop, FILE *fp) {
+	pse_snap_header header;
+	pse_snap_column *records;
+	pse_column *col;
+	unsigned long long position;
+	unsigned long long offset;
+	size_t bytes;
+	unsigned int i;
+
+	records = (pse_snap_column *) calloc(pop->column_count + 1, sizeof(pse_snap_column));
+
+	if (records == NULL)
+		return PSE_ERROR_TOO_MANY_VARIABLES;
+
+	memset(&header, 0, sizeof(pse_snap_header));
+	strcpy(header.magic, PSE_SNAP_MAGIC);
+	header.version = PSE_SNAP_VERSION;
+	header.byte_order = PSE_SNAP_BYTE_ORDER;
+	header.rng_size = sizeof(rng_state);
+	header.state = pop->state;
+	header.sampler = pop->sampler;
+	header.seed = pop->seed;
+	header.agent_count = pop->agent_count;
+	header.column_count = pop->column_count;
+	header.rng = pop->rng;
+	header.names_offset = sizeof(pse_snap_header) +
+							sizeof(pse_snap_column)*pop->column_count;
+
+	for (i = 0; i < pop->column_count; i++) {
+		col = &(pop->columns[i]);
+		records[i].storage = col->storage;
+		records[i].model = col->model;
+		records[i].point_distribution = col->point_distribution;
+		records[i].read_and_alter = col->read_and_alter;
+		records[i].clock = PSE_SDE_NO_CLOCK;
+		records[i].sampler_pending = col->sampler_pending;
+
+		if (col->point_distribution == PSE_DIST_FOKKER_PLANCK) {
+			if (col->point_cache.sde.step != NULL)
+				records[i].clock = col->point_cache.sde.clock;
+
+			if (col->point_cache.sde.model != NULL)
+				records[i].sampler_pending = PSE_TRUE;
+		} else if (col->point_distribution == PSE_DIST_CUSTOM &&
+					col->point_cache.custom != NULL) {
+			records[i].sampler_pending = PSE_TRUE;
+		}
+
+		memcpy(records[i].point_parameters, col->point_parameters,
+				PSE_MAX_DIST_PARAMS*sizeof(double));
+		records[i].step = col->step;
+		records[i].name_offset = header.names_size;
+		header.names_size += strlen(col->name) + 1;
+	}
+
+	offset = pse_snap_align(header.names_offset + header.names_size);
+
+	for (i = 0; i < pop->column_count; i++) {
+		records[i].values_offset = offset;
+		offset = pse_snap_align(offset + (unsigned long long) pop->agent_count*
+							pse_snap_element_size(pop->columns[i].storage));
+	}
+
+	header.bytes = offset;
+
+	if (fwrite(&header, sizeof(pse_snap_header), 1, fp) != 1 ||
+		fwrite(records, sizeof(pse_snap_column), pop->column_count, fp) != pop->column_count) {
+		free(records);
+		return PSE_ERROR_IO;
+	}
+
+	position = header.names_offset;
+
+	for (i = 0; i < pop->column_count; i++) {
+		bytes = strlen(pop->columns[i].name) + 1;
+
+		if (fwrite(pop->columns[i].name, 1, bytes, fp) != bytes) {
+			free(records);
+			return PSE_ERROR_IO;
+		}
+
+		position += bytes;
+	}
+
+	for (i = 0; i < pop->column_count; i++) {
+		bytes = pop->agent_count*pse_snap_element_size(pop->columns[i].storage);
+
+		if (pse_snap_pad(fp, &position, records[i].values_offset) == PSE_FALSE ||
+			fwrite(pop->columns[i].values.cdouble_a, 1, bytes, fp) != bytes) {
+			free(records);
+			return PSE_ERROR_IO;
+		}
+
+		position += bytes;
+	}
+
+	free(records);
+
+	if (pse_snap_pad(fp, &position, header.bytes) == PSE_FALSE)
+		return PSE_ERROR_IO;
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Check that a column record only refers to what lies inside the snapshot,
+ * and that its clock is a time column
+ */
+unsigned int pse_snap_valid_column(pse_snap_header *header, pse_snap_column *records,
+									pse_snap_column *record, unsigned long long size) {
+	size_t element_size = pse_snap_element_size(record->storage);
+	char *names = (char *) header + header->names_offset;
+
+	if (element_size == 0 || record->point_distribution > PSE_DIST_TABLE_DOUBLE ||
+		record->model > PSE_VAR_DETERMINISTIC || record->sampler_pending > PSE_TRUE)
+		return PSE_FALSE;
+
+	if (record->clock != PSE_SDE_NO_CLOCK &&
+		(record->point_distribution != PSE_DIST_FOKKER_PLANCK || record->clock < 0 ||
+		(unsigned int) record->clock >= header->column_count ||
+		records[record->clock].storage != PSE_VAR_TIME))
+		return PSE_FALSE;
+
+	if (record->name_offset >= header->names_size ||
+		memchr(names + record->name_offset, '\0',
+				header->names_size - record->name_offset) == NULL ||
+		strlen(names + record->name_offset) >= PSE_VARNAME_SIZE)
+		return PSE_FALSE;
+
+	if (record->values_offset % PSE_SNAP_ALIGN != 0 || record->values_offset > size ||
+		(size - record->values_offset)/element_size < header->agent_count)
+		return PSE_FALSE;
+
+	return PSE_TRUE;
+}
+
+/*
+ * Population snapshot
+ *
+ * As with checkpoints, the snapshot is written to a temporary file that
+ * replaces the destination only once complete.
+ */
+pse_error pse_pop_snapshot(pse_population *pop, char *path) {
+	pse_error error;
+	char *temporary;
+	FILE *fp;
+
+	if (pop->state == CREATED)
+		return PSE_ERROR_NOT_INITIALIZED;
+
+	if (pop->state == FINALIZED)
+		return PSE_ERROR_ALREADY_FINALIZED;
+
+	temporary = (char *) malloc(strlen(path) + 5);
+
+	if (temporary == NULL)
+		return PSE_ERROR_TOO_MANY_VARIABLES;
+
+	sprintf(temporary, "%s.tmp", path);
+	fp = fopen(temporary, "wb");
+
+	if (fp == NULL) {
+		free(temporary);
+		return PSE_ERROR_IO;
+	}
+
+	error = pse_snap_write(pop, fp);
+
+	if (fclose(fp) != 0 && error == PSE_ERROR_OK)
+		error = PSE_ERROR_IO;
+
+	if (error == PSE_ERROR_OK && rename(temporary, path) != 0)
+		error = PSE_ERROR_IO;
+
+	if (error != PSE_ERROR_OK)
+		remove(temporary);
+
+	free(temporary);
+
+	return error;
+}
+
+/*
+ * Population mapping
+ *
+ * Takes the place of pse_pop_init() for a population that resumes from a
+ * snapshot, so the population must be in the CREATED state. Nothing is read
+ * from the values: columns point into the mapping, which stays in place until
+ * pse_pop_finalize().
+ */
+pse_error pse_pop_map(pse_population *pop, char *path) {
+	pse_snap_header *header;
+	pse_snap_column *records;
+	pse_column *col;
+	struct stat info;
+	unsigned long long size;
+	unsigned int limit;
+	unsigned int i;
+	char *base;
+	int fd;
+
+	if (pop->state == INITIALIZED)
+		return PSE_ERROR_ALREADY_INITIALIZED;
+
+	if (pop->state == STARTED)
+		return PSE_ERROR_ALREADY_STARTED;
+
+	if (pop->state == FINALIZED)
+		return PSE_ERROR_ALREADY_FINALIZED;
+
+	fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return PSE_ERROR_IO;
+
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		return PSE_ERROR_IO;
+	}
+
+	size = (unsigned long long) info.st_size;
+
+	if (size < sizeof(pse_snap_header)) {
+		close(fd);
+		return PSE_ERROR_CHECKPOINT_INVALID;
+	}
+
+	base = (char *) mmap(NULL, (size_t) size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (base == MAP_FAILED)
+		return PSE_ERROR_IO;
+
+	header = (pse_snap_header *) base;
+	records = (pse_snap_column *)(base + sizeof(pse_snap_header));
+
+	if (memcmp(header->magic, PSE_SNAP_MAGIC, sizeof(PSE_SNAP_MAGIC)) != 0 ||
+		header->version != PSE_SNAP_VERSION ||
+		header->byte_order != PSE_SNAP_BYTE_ORDER ||
+		header->rng_size != sizeof(rng_state) || header->bytes != size ||
+		(header->state != INITIALIZED && header->state != STARTED) ||
+		header->names_offset != sizeof(pse_snap_header) +
+							sizeof(pse_snap_column)*(unsigned long long) header->column_count ||
+		header->names_offset + header->names_size > size) {
+		munmap(base, (size_t) size);
+		return PSE_ERROR_CHECKPOINT_INVALID;
+	}
+
+	for (i = 0; i < header->column_count; i++) {
+		if (pse_snap_valid_column(header, records, &records[i], size) == PSE_FALSE) {
+			munmap(base, (size_t) size);
+			return PSE_ERROR_CHECKPOINT_INVALID;
+		}
+	}
+
+	limit = (header->column_count > PSE_POP_INITIAL_COLUMNS) ?
+				header->column_count : PSE_POP_INITIAL_COLUMNS;
+	pop->columns = (pse_column *) malloc(sizeof(pse_column)*limit);
+
+	if (pop->columns == NULL) {
+		munmap(base, (size_t) size);
+		return PSE_ERROR_TOO_MANY_VARIABLES;
+	}
+
+	for (i = 0; i < header->column_count; i++) {
+		col = &(pop->columns[i]);
+		col->storage = records[i].storage;
+		col->model = records[i].model;
+		col->point_distribution = records[i].point_distribution;
+		memcpy(col->point_parameters, records[i].point_parameters,
+				PSE_MAX_DIST_PARAMS*sizeof(double));
+		memset(&col->point_cache, 0, sizeof(pse_sampler_cache));
+		pse_refresh_cache(col->point_distribution, col->point_parameters,
+							&col->point_cache);
+		col->sample_int = pse_resolve_int_sampler(col->point_distribution);
+		col->sample_double = pse_resolve_double_sampler(col->point_distribution,
+													header->sampler);
+		col->sampler_pending = records[i].sampler_pending;
+		col->read_and_alter = records[i].read_and_alter;
+		strcpy(col->name, base + header->names_offset + records[i].name_offset);
+		col->values.cdouble_a = (double *)(base + records[i].values_offset);
+		col->step = records[i].step;
+	}
+
+	/*
+	 * Clocks point into the values of their columns, once all are mapped
+	 */
+	for (i = 0; i < header->column_count; i++) {
+		if (records[i].clock != PSE_SDE_NO_CLOCK) {
+			pop->columns[i].point_cache.sde.clock = records[i].clock;
+			pop->columns[i].point_cache.sde.step =
+							pop->columns[records[i].clock].values.ctime_a;
+		}
+	}
+
+	pop->agent_count = header->agent_count;
+	pop->column_count = header->column_count;
+	pop->column_limit = limit;
+	pop->seed = header->seed;
+	pop->sampler = header->sampler;
+	pop->rng = header->rng;
+	pop->pool = NULL;
+	pop->worker_rng = NULL;
+	pop->mapping = base;
+	pop->mapping_size = size;
+	pop->state = header->state;
+
+	return PSE_ERROR_OK;
+}
@@ -0,0 +1,486 @@
+/*
+ * National Center for Supercomputing Applications
+ * University of Illinois at Urbana-Champaign
+ *
+ * Large-Scale Agent-Based Social Simulation
+ * Les Gasser, NCSA Fellow
+ *
+ * Author: Santiago Nunez-Corrales
+ */
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <rnglib.h>
+#include <psetable.h>
+#include "pseint.h"
+
+/*
+ * Tables in use, shared by all stubs and populations of the process
+ */
+static pse_table *pse_tables = NULL;
+static pthread_mutex_t pse_tables_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Declaration of private functions
+ */
+unsigned long long pse_table_hash(unsigned long long, void *, size_t);
+unsigned int pse_table_valid(double *, double *, unsigned int);
+pse_table * pse_table_find(pse_distribution_type, double *, int *, double *,
+						unsigned int, unsigned long long);
+pse_table * pse_table_allocate(pse_distribution_type, unsigned int);
+void pse_table_free(pse_table *);
+pse_error pse_table_build_alias(pse_table *);
+void pse_table_build_guide(pse_table *);
+pse_table * pse_table_intern(pse_distribution_type, double *, int *, double *,
+						unsigned int, pse_error *);
+void pse_table_acquire(pse_table *);
+unsigned int pse_table_fits(pse_distribution_type, pse_storage_type, pse_table *);
+
+/*
+ * FNV-1a over the source data of a table
+ */
+unsigned long long pse_table_hash(unsigned long long hash, void *data, size_t bytes) {
+	unsigned char *byte = (unsigned char *) data;
+	size_t i;
+
+	for (i = 0; i < bytes; i++) {
+		hash ^= byte[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+/*
+ * Weights must be finite and non-negative with a positive sum; edges, if
+ * any, increasing
+ */
+unsigned int pse_table_valid(double *weights, double *edges, unsigned int count) {
+	double sum = 0;
+	unsigned int i;
+
+	if (count == 0)
+		return PSE_FALSE;
+
+	for (i = 0; i < count; i++) {
+		if (!(weights[i] >= 0) || isinf(weights[i]))
+			return PSE_FALSE;
+
+		sum += weights[i];
+	}
+
+	if (!(sum > 0) || isinf(sum))
+		return PSE_FALSE;
+
+	if (edges != NULL) {
+		for (i = 0; i < count; i++) {
+			if (!(edges[i] < edges[i + 1]) || isinf(edges[i]) || isinf(edges[i + 1]))
+				return PSE_FALSE;
+		}
+	}
+
+	return PSE_TRUE;
+}
+
+/*
+ * Look for a table built from the same data. Called with the lock held.
+ */
+pse_table * pse_table_find(pse_distribution_type distribution, double *weights,
+						int *values, double *edges, unsigned int count,
+						unsigned long long hash) {
+	pse_table *table;
+
+	for (table = pse_tables; table != NULL; table = table->next) {
+		if (table->hash != hash || table->distribution != distribution ||
+			table->count != count ||
+			memcmp(table->weights, weights, sizeof(double)*count) != 0)
+			continue;
+
+		if (distribution == PSE_DIST_TABLE_INT &&
+			memcmp(table->values, values, sizeof(int)*count) == 0)
+			return table;
+
+		if (distribution == PSE_DIST_TABLE_DOUBLE &&
+			memcmp(table->edges, edges, sizeof(double)*(count + 1)) == 0)
+			return table;
+	}
+
+	return NULL;
+}
+
+pse_table * pse_table_allocate(pse_distribution_type distribution, unsigned int count) {
+	pse_table *table = (pse_table *) calloc(1, sizeof(pse_table));
+
+	if (table == NULL)
+		return NULL;
+
+	table->distribution = distribution;
+	table->count = count;
+	table->weights = (double *) malloc(sizeof(double)*count);
+
+	if (distribution == PSE_DIST_TABLE_INT) {
+		table->values = (int *) malloc(sizeof(int)*count);
+		table->probability = (double *) malloc(sizeof(double)*count);
+		table->alias = (unsigned int *) malloc(sizeof(unsigned int)*count);
+
+		if (table->values == NULL || table->probability == NULL || table->alias == NULL)
+			table->count = 0;
+	} else {
+		table->edges = (double *) malloc(sizeof(double)*(count + 1));
+		table->cdf = (double *) malloc(sizeof(double)*(count + 1));
+		table->guide = (unsigned int *) malloc(sizeof(unsigned int)*count);
+
+		if (table->edges == NULL || table->cdf == NULL || table->guide == NULL)
+			table->count = 0;
+	}
+
+	if (table->weights == NULL || table->count == 0) {
+		pse_table_free(table);
+		return NULL;
+	}
+
+	return table;
+}
+
+void pse_table_free(pse_table *table) {
+	free(table->weights);
+	free(table->values);
+	free(table->edges);
+	free(table->probability);
+	free(table->alias);
+	free(table->cdf);
+	free(table->guide);
+	free(table);
+}
+
+/*
+ * Walker alias table, built with Vose's method. Outcome i is accepted with
+ * probability[i] and otherwise replaced by alias[i]. The outcomes still to be
+ * paired are kept in one worklist: those below the average fill it from the
+ * front, the others from the back.
+ */
+pse_error pse_table_build_alias(pse_table *table) {
+	unsigned int count = table->count;
+	unsigned int *work;
+	unsigned int small = 0;
+	unsigned int large = count;
+	double *scaled = table->probability;
+	double sum = 0;
+	unsigned int s;
+	unsigned int l;
+	unsigned int i;
+
+	work = (unsigned int *) malloc(sizeof(unsigned int)*count);
+
+	if (work == NULL)
+		return PSE_ERROR_TOO_MANY_VARIABLES;
+
+	for (i = 0; i < count; i++)
+		sum += table->weights[i];
+
+	for (i = 0; i < count; i++) {
+		scaled[i] = table->weights[i]*count/sum;
+
+		if (scaled[i] < 1)
+			work[small++] = i;
+		else
+			work[--large] = i;
+	}
+
+	while (small > 0 && large < count) {
+		s = work[--small];
+		l = work[large];
+
+		table->alias[s] = l;
+		scaled[l] = (scaled[l] + scaled[s]) - 1;
+
+		if (scaled[l] < 1) {
+			large++;
+			work[small++] = l;
+		}
+	}
+
+	/*
+	 * What remains has probability one up to rounding
+	 */
+	while (large < count) {
+		l = work[large++];
+		scaled[l] = 1;
+		table->alias[l] = l;
+	}
+
+	while (small > 0) {
+		s = work[--small];
+		scaled[s] = 1;
+		table->alias[s] = s;
+	}
+
+	free(work);
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Distribution function at the edges, and a guide table: guide[j] is the
+ * first bin whose distribution function exceeds j/count at its right edge
+ */
+void pse_table_build_guide(pse_table *table) {
+	unsigned int count = table->count;
+	double sum = 0;
+	unsigned int i;
+	unsigned int j;
+
+	for (i = 0; i < count; i++)
+		sum += table->weights[i];
+
+	table->cdf[0] = 0;
+
+	for (i = 0; i < count; i++)
+		table->cdf[i + 1] = table->cdf[i] + table->weights[i]/sum;
+
+	table->cdf[count] = 1;
+
+	for (i = 0, j = 0; j < count; j++) {
+		while (i < count - 1 && table->cdf[i + 1] <= (double) j/count)
+			i++;
+
+		table->guide[j] = i;
+	}
+}
+
+/*
+ * Return the table for the given data, building it if no equal table is in
+ * use. The caller receives one reference.
+ */
+pse_table * pse_table_intern(pse_distribution_type distribution, double *weights,
+						int *values, double *edges, unsigned int count, pse_error *error) {
+	unsigned long long hash = 14695981039346656037ULL;
+	pse_table *table;
+	int *identity = NULL;
+	unsigned int i;
+
+	if (pse_table_valid(weights, edges, count) == PSE_FALSE) {
+		*error = PSE_ERROR_TABLE_INVALID;
+		return NULL;
+	}
+
+	if (distribution == PSE_DIST_TABLE_INT && values == NULL) {
+		identity = (int *) malloc(sizeof(int)*count);
+
+		if (identity == NULL) {
+			*error = PSE_ERROR_TOO_MANY_VARIABLES;
+			return NULL;
+		}
+
+		for (i = 0; i < count; i++)
+			identity[i] = (int) i;
+
+		values = identity;
+	}
+
+	hash = pse_table_hash(hash, weights, sizeof(double)*count);
+
+	if (distribution == PSE_DIST_TABLE_INT)
+		hash = pse_table_hash(hash, values, sizeof(int)*count);
+	else
+		hash = pse_table_hash(hash, edges, sizeof(double)*(count + 1));
+
+	pthread_mutex_lock(&pse_tables_lock);
+
+	table = pse_table_find(distribution, weights, values, edges, count, hash);
+
+	if (table != NULL) {
+		table->references++;
+	} else {
+		table = pse_table_allocate(distribution, count);
+
+		if (table != NULL) {
+			memcpy(table->weights, weights, sizeof(double)*count);
+
+			if (distribution == PSE_DIST_TABLE_INT) {
+				memcpy(table->values, values, sizeof(int)*count);
+
+				if (pse_table_build_alias(table) != PSE_ERROR_OK) {
+					pse_table_free(table);
+					table = NULL;
+				}
+			} else {
+				memcpy(table->edges, edges, sizeof(double)*(count + 1));
+				pse_table_build_guide(table);
+			}
+		}
+
+		if (table != NULL) {
+			table->hash = hash;
+			table->references = 1;
+			table->next = pse_tables;
+			pse_tables = table;
+		}
+	}
+
+	pthread_mutex_unlock(&pse_tables_lock);
+	free(identity);
+
+	*error = (table == NULL) ? PSE_ERROR_TOO_MANY_VARIABLES : PSE_ERROR_OK;
+
+	return table;
+}
+
+/*
+ * Table constructors
+ */
+pse_table * pse_table_int(double *weights, int *values, unsigned int count, pse_error *error) {
+	return pse_table_intern(PSE_DIST_TABLE_INT, weights, values, NULL, count, error);
+}
+
+pse_table * pse_table_double(double *edges, double *weights, unsigned int bins,
+						pse_error *error) {
+	if (edges == NULL) {
+		*error = PSE_ERROR_TABLE_INVALID;
+		return NULL;
+	}
+
+	return pse_table_intern(PSE_DIST_TABLE_DOUBLE, weights, NULL, edges, bins, error);
+}
+
+void pse_table_acquire(pse_table *table) {
+	pthread_mutex_lock(&pse_tables_lock);
+	table->references++;
+	pthread_mutex_unlock(&pse_tables_lock);
+}
+
+/*
+ * Give back one reference. The last one frees the table.
+ */
+void pse_table_release(pse_table *table) {
+	pse_table **link;
+
+	if (table == NULL)
+		return;
+
+	pthread_mutex_lock(&pse_tables_lock);
+
+	if (--table->references > 0) {
+		pthread_mutex_unlock(&pse_tables_lock);
+		return;
+	}
+
+	for (link = &pse_tables; *link != NULL; link = &((*link)->next)) {
+		if (*link == table) {
+			*link = table->next;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&pse_tables_lock);
+	pse_table_free(table);
+}
+
+/*
+ * Integer tables sample integer storage; histograms sample doubles and time
+ */
+unsigned int pse_table_fits(pse_distribution_type distribution, pse_storage_type storage,
+						pse_table *table) {
+	if (table != NULL && table->distribution != distribution)
+		return PSE_FALSE;
+
+	if (distribution == PSE_DIST_TABLE_INT)
+		return (storage == PSE_VAR_INT) ? PSE_TRUE : PSE_FALSE;
+
+	if (distribution == PSE_DIST_TABLE_DOUBLE)
+		return (storage == PSE_VAR_DOUBLE || storage == PSE_VAR_TIME) ? PSE_TRUE : PSE_FALSE;
+
+	return PSE_FALSE;
+}
+
+/*
+ * Supply a table to a variable of a stub. A NULL table removes the current one.
+ */
+pse_error pse_supply_table(pse_agent_stub *pse, pse_varid varid, pse_table *table) {
+	pse_variable *var;
+
+	if (pse->state == CREATED)
+		return PSE_ERROR_NOT_INITIALIZED;
+
+	if (pse->state == FINALIZED)
+		return PSE_ERROR_ALREADY_FINALIZED;
+
+	if (pse_is_registered(pse, varid) == PSE_FALSE)
+		return PSE_ERROR_VARIABLE_UNKNOWN;
+
+	var = pse->variables[varid];
+
+	if (pse_table_fits(var->point_distribution, var->storage, table) == PSE_FALSE)
+		return PSE_ERROR_TYPE_MISMATCH;
+
+	if (table != NULL)
+		pse_table_acquire(table);
+
+	pse_table_release(var->point_cache.table);
+	var->point_cache.table = table;
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Supply a table to a column of a population
+ */
+pse_error pse_pop_supply_table(pse_population *pop, pse_varid colid, pse_table *table) {
+	pse_column *col;
+
+	if (pop->state == CREATED)
+		return PSE_ERROR_NOT_INITIALIZED;
+
+	if (pop->state == FINALIZED)
+		return PSE_ERROR_ALREADY_FINALIZED;
+
+	if (colid < 0 || (unsigned int)colid >= pop->column_count)
+		return PSE_ERROR_VARIABLE_UNKNOWN;
+
+	col = &(pop->columns[colid]);
+
+	if (pse_table_fits(col->point_distribution, col->storage, table) == PSE_FALSE)
+		return PSE_ERROR_TYPE_MISMATCH;
+
+	if (table != NULL)
+		pse_table_acquire(table);
+
+	pse_table_release(col->point_cache.table);
+	col->point_cache.table = table;
+
+	return PSE_ERROR_OK;
+}
+
+/*
+ * Alias draw: the integer part of one uniform picks an outcome, the
+ * fractional part accepts it or its alias
+ */
+int pse_table_draw_int(pse_table *table) {
+	double u = r8_uni_01()*table->count;
+	unsigned int i = (unsigned int) u;
+
+	if (i >= table->count)
+		i = table->count - 1;
+
+	return (u - i < table->probability[i]) ? table->values[i] : table->values[table->alias[i]];
+}
+
+/*
+ * Inverse distribution function: the guide table gives a bin at or before
+ * the one holding u, the distribution function is linear inside it
+ */
+double pse_table_draw_double(pse_table *table) {
+	double u = r8_uni_01();
+	unsigned int j = (unsigned int)(u*table->count);
+	unsigned int i;
+
+	if (j >= table->count)
+		j = table->count - 1;
+
+	for (i = table->guide[j]; i < table->count - 1 && table->cdf[i + 1] <= u; i++)
+		;
+
+	return table->edges[i] + (u - table->cdf[i])/(table->cdf[i + 1] - table->cdf[i])*
+							(table->edges[i + 1] - table->edges[i]);
+}